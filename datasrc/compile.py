@@ -183,6 +183,10 @@ if gen_network_source:
 	lines += ['static const int max_int = 0x7fffffff;']
 	lines += ['']
 
+	lines += ['static inline bool InRange(int Value, int Min, int Max) { return (unsigned)Value-(unsigned)Min <= (unsigned)Max-(unsigned)Min; }']
+	lines += ['static inline bool InFlags(int Value, int Mask) { return (Value&Mask) == Value; }']
+	lines += ['']
+
 	lines += ['bool CNetObjHandler::CheckInt(const char *pErrorMsg, int Value, int Min, int Max)']
 	lines += ['{']
 	lines += ['\tif(Value < Min || Value > Max) { m_pObjFailedOn = pErrorMsg; m_NumObjFailures++; return false; }']
@@ -234,13 +234,30 @@ class NetObject:
 		lines += ["{"]
 		lines += ["\t%s *pObj = (%s *)pData;"%(self.struct_name, self.struct_name)]
 		lines += ["\tif(sizeof(*pObj) != Size) return -1;"]
-		for v in self.variables:
-			lines += ["\t"+line for line in v.emit_validate()]
+		lines += ["\t"+line for line in emit_range_check(self.variables, "pObj->", "return -1;")]
 		lines += ["\treturn 0;"]
 		lines += ["}"]
 		return lines
 
 
+# checks all ranges in one branch free expression and only goes through the
+# checks that name the failing member when it is false
+def emit_range_check(variables, prefix, fail):
+	ranges = []
+	for v in variables:
+		ranges += v.emit_range(prefix)
+	if not ranges:
+		return []
+	lines = ["if(!(" + ranges[0]]
+	lines += ["\t& " + r for r in ranges[1:]]
+	lines[-1] += "))"
+	lines += ["{"]
+	for v in variables:
+		lines += ["\t"+line for line in v.emit_validate(prefix, fail)]
+	lines += ["}"]
+	return lines
+
+
 class NetEvent(NetObject):
 	def __init__(self, name, variables):
 		NetObject.__init__(self, name, variables)
@@ -262,11 +279,12 @@ class NetMessage(NetObject):
 		lines += ["\t(void)pMsg;"]
 		for v in self.variables:
 			lines += ["\t"+line for line in v.emit_unpack()]
-		for v in self.variables:
-			lines += ["\t"+line for line in v.emit_unpack_check()]
+		lines += ["\t"+line for line in emit_range_check(self.variables, "pMsg->", "break;")]
 		lines += ["} break;"]
 		return lines
 	def emit_declaration(self):
+		# the generated header goes into the net version hash, so its
+		# text has to stay the same for old clients and servers to connect
 		extra = []
 		extra += ["\tint MsgID() const { return %s; }" % self.enum_name]
 		extra += ["\t"]
@@ -289,13 +307,13 @@ class NetVariable:
 		self.name = name
 	def emit_declaration(self):
 		return []
-	def emit_validate(self):
+	def emit_validate(self, prefix, fail):
 		return []
 	def emit_pack(self):
 		return []
-	def emit_unpack(self):
+	def emit_range(self, prefix):
 		return []
-	def emit_unpack_check(self):
+	def emit_unpack(self):
 		return []
 
 class NetString(NetVariable):
@@ -327,10 +345,10 @@ class NetIntRange(NetIntAny):
 		NetIntAny.__init__(self,name)
 		self.min = str(min)
 		self.max = str(max)
-	def emit_validate(self):
-		return ["if(!CheckInt(\"%s\", pObj->%s, %s, %s)) return -1;"%(self.name, self.name, self.min, self.max)]
-	def emit_unpack_check(self):
-		return ["if(!CheckInt(\"%s\", pMsg->%s, %s, %s)) break;"%(self.name, self.name, self.min, self.max)]
+	def emit_validate(self, prefix, fail):
+		return ["if(!CheckInt(\"%s\", %s%s, %s, %s)) %s"%(self.name, prefix, self.name, self.min, self.max, fail)]
+	def emit_range(self, prefix):
+		return ["InRange(%s%s, %s, %s)"%(prefix, self.name, self.min, self.max)]
 
 class NetEnum(NetIntRange):
 	def __init__(self, name, enum):
@@ -345,10 +363,10 @@ class NetFlag(NetIntAny):
 				self.mask += "|%s_%s" % (flag.name, i)
 		else:
 			self.mask = "0"
-	def emit_validate(self):
-		return ["if(!CheckFlag(\"%s\", pObj->%s, %s)) return -1;"%(self.name, self.name, self.mask)]
-	def emit_unpack_check(self):
-		return ["if(!CheckFlag(\"%s\", pMsg->%s, %s)) break;"%(self.name, self.name, self.mask)]
+	def emit_validate(self, prefix, fail):
+		return ["if(!CheckFlag(\"%s\", %s%s, %s)) %s"%(self.name, prefix, self.name, self.mask, fail)]
+	def emit_range(self, prefix):
+		return ["InFlags(%s%s, %s)"%(prefix, self.name, self.mask)]
 
 class NetBool(NetIntRange):
 	def __init__(self, name):
@@ -367,27 +385,27 @@ class NetArray(NetVariable):
 	def emit_declaration(self):
 		self.var.name = self.name
 		return self.var.emit_declaration()
-	def emit_validate(self):
+	def emit_validate(self, prefix, fail):
 		lines = []
 		for i in range(self.size):
 			self.var.name = self.base_name + "[%d]"%i
-			lines += self.var.emit_validate()
+			lines += self.var.emit_validate(prefix, fail)
 		return lines
-	def emit_unpack(self):
+	def emit_range(self, prefix):
 		lines = []
 		for i in range(self.size):
 			self.var.name = self.base_name + "[%d]"%i
-			lines += self.var.emit_unpack()
+			lines += self.var.emit_range(prefix)
 		return lines
-	def emit_pack(self):
+	def emit_unpack(self):
 		lines = []
 		for i in range(self.size):
 			self.var.name = self.base_name + "[%d]"%i
-			lines += self.var.emit_pack()
+			lines += self.var.emit_unpack()
 		return lines
-	def emit_unpack_check(self):
+	def emit_pack(self):
 		lines = []
 		for i in range(self.size):
 			self.var.name = self.base_name + "[%d]"%i
-			lines += self.var.emit_unpack_check()
+			lines += self.var.emit_pack()
 		return lines
@@ -0,0 +1,62 @@
+# compares the memory and cpu use of several idle servers hosted in one
+# process (teeworlds_srv --multi) against one process per server. linux only,
+# run it from the directory the servers should run in
+import optparse, os, shutil, signal, subprocess, sys, tempfile, time
+
+arguments = optparse.OptionParser(usage = "usage: %prog [options] <teeworlds_srv>")
+arguments.add_option("-n", "--num", type = "int", default = 32, help = "number of servers")
+arguments.add_option("-t", "--threads", type = "int", default = 4, help = "worker threads of the multi server process")
+arguments.add_option("-s", "--seconds", type = "float", default = 12, help = "how long the servers run")
+arguments.add_option("-m", "--map", default = "dm1", help = "map the servers load")
+arguments.add_option("-p", "--port", type = "int", default = 8400, help = "port of the first server")
+(options, arguments) = arguments.parse_args()
+if len(arguments) != 1:
+	print("usage: multi_server_bench.py [options] <teeworlds_srv>")
+	sys.exit(1)
+server = os.path.abspath(arguments[0])
+
+def usage(pid):
+	# resident memory in kb and the cpu time in seconds of a process
+	rss = 0
+	for line in open("/proc/%d/status" % pid):
+		if line.startswith("VmRSS:"):
+			rss = int(line.split()[1])
+	fields = open("/proc/%d/stat" % pid).read().rsplit(")", 1)[1].split()
+	cpu = (int(fields[11]) + int(fields[12])) / float(os.sysconf("SC_CLK_TCK"))
+	return rss, cpu
+
+def run(commands):
+	processes = [subprocess.Popen(c, stdout = devnull, stderr = devnull) for c in commands]
+	time.sleep(options.seconds)
+	rss, cpu = 0, 0.0
+	for p in processes:
+		if p.poll() is not None:
+			print("a server quit early: %s" % " ".join(commands[processes.index(p)]))
+			continue
+		r, c = usage(p.pid)
+		rss += r
+		cpu += c
+	for p in processes:
+		if p.poll() is None:
+			p.send_signal(signal.SIGINT)
+			p.wait()
+	return rss, cpu
+
+# the server only reads configs through its storage, so they go below the working directory
+configdir = os.path.relpath(tempfile.mkdtemp(dir = "."))
+configs = []
+for i in range(options.num):
+	config = os.path.join(configdir, "server%d.cfg" % i)
+	f = open(config, "w")
+	f.write("sv_map %s\nsv_port %d\nsv_register 0\nec_port 0\n" % (options.map, options.port + i))
+	f.close()
+	configs.append(config)
+
+devnull = open(os.devnull, "w")
+try:
+	rss, cpu = run([[server, "--multi", str(options.threads)] + configs])
+	print("one process, %d threads: %d MB, %.2fs cpu" % (options.threads, rss/1024, cpu))
+	rss, cpu = run([[server, "-f", c] for c in configs])
+	print("%d processes: %d MB, %.2fs cpu" % (options.num, rss/1024, cpu))
+finally:
+	shutil.rmtree(configdir)
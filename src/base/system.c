@@ -16,6 +16,7 @@
 	/* unix net includes */
 	#include <sys/stat.h>
 	#include <sys/types.h>
+	#include <sys/mman.h>
 	#include <sys/socket.h>
 	#include <sys/ioctl.h>
 	#include <errno.h>
@@ -27,6 +28,11 @@
 
 	#include <dirent.h>
 
+	#if defined(CONF_PLATFORM_LINUX)
+		#include <linux/futex.h>
+		#include <sys/syscall.h>
+	#endif
+
 	#if defined(CONF_PLATFORM_MACOSX)
 		#include <Carbon/Carbon.h>
 	#endif
@@ -39,6 +45,7 @@
 	#include <fcntl.h>
 	#include <direct.h>
 	#include <errno.h>
+	#include <io.h>
 	#include <wincrypt.h>
 #else
 	#error NOT IMPLEMENTED
@@ -240,31 +247,104 @@ void dbg_logger_file(const char *filename)
 }
 /* */
 
+#if CONF_MEMSTATS
+/* sits in front of every block, 16 bytes keep the block as aligned as malloc's */
 typedef struct MEMHEADER
 {
-	const char *filename;
-	int line;
-	int size;
-	struct MEMHEADER *prev;
-	struct MEMHEADER *next;
+	unsigned size;
+	int tag;
+	int64 pad;
 } MEMHEADER;
 
-typedef struct MEMTAIL
+static MEMSTATS memory_stats[NUM_MEMTAGS];
+
+static int64 mem_counter_add(volatile int64 *counter, int64 value)
 {
-	int guard;
-} MEMTAIL;
+#if defined(_MSC_VER)
+	return InterlockedExchangeAdd64(counter, value)+value;
+#else
+	return __atomic_add_fetch(counter, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static void mem_counter_max(volatile int64 *counter, int64 value)
+{
+	int64 current = *counter;
+	while(value > current)
+	{
+#if defined(_MSC_VER)
+		int64 prev = InterlockedCompareExchange64(counter, value, current);
+		if(prev == current)
+			break;
+		current = prev;
+#else
+		if(__atomic_compare_exchange_n(counter, &current, value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+#endif
+	}
+}
 
-static struct MEMHEADER *first = 0;
-static const int MEM_GUARD_VAL = 0xbaadc0de;
+void mem_track(int tag, int size)
+{
+	MEMSTATS *stats = &memory_stats[tag];
+	int64 live = mem_counter_add(&stats->live, size);
+	if(size > 0)
+	{
+		mem_counter_add(&stats->allocs, 1);
+		mem_counter_max(&stats->peak, live);
+	}
+	else if(size < 0)
+		mem_counter_add(&stats->frees, 1);
+}
+#endif
 
-void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned alignment)
+void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned alignment, int tag)
 {
+#if CONF_MEMSTATS
+	MEMHEADER *header = (MEMHEADER *)malloc(sizeof(MEMHEADER)+size);
+	if(!header)
+		return 0;
+	header->size = size;
+	header->tag = tag;
+	mem_track(tag, size);
+	return header+1;
+#else
 	return malloc(size);
+#endif
 }
 
 void mem_free(void *p)
 {
+#if CONF_MEMSTATS
+	MEMHEADER *header;
+	if(!p)
+		return;
+	header = (MEMHEADER *)p-1;
+	mem_track(header->tag, -(int)header->size);
+	free(header);
+#else
 	free(p);
+#endif
+}
+
+void mem_stats(int tag, MEMSTATS *stats)
+{
+#if CONF_MEMSTATS
+	stats->live = memory_stats[tag].live;
+	stats->peak = memory_stats[tag].peak;
+	stats->allocs = memory_stats[tag].allocs;
+	stats->frees = memory_stats[tag].frees;
+#else
+	mem_zero(stats, sizeof(*stats));
+#endif
+}
+
+const char *mem_tag_name(int tag)
+{
+	static const char *names[NUM_MEMTAGS] = { "general", "snapshot", "bans", "console", "map", "entities", "heap" };
+	if(tag < 0 || tag >= NUM_MEMTAGS)
+		return "unknown";
+	return names[tag];
 }
 
 void mem_copy(void *dest, const void *source, unsigned size)
@@ -282,23 +362,6 @@ void mem_zero(void *block,unsigned size)
 	memset(block, 0, size);
 }
 
-int mem_check_imp()
-{
-	MEMHEADER *header = first;
-	while(header)
-	{
-		MEMTAIL *tail = (MEMTAIL *)(((char*)(header+1))+header->size);
-		if(tail->guard != MEM_GUARD_VAL)
-		{
-			dbg_msg("mem", "Memory check failed at %s(%d): %d", header->filename, header->line, header->size);
-			return 0;
-		}
-		header = header->next;
-	}
-
-	return 1;
-}
-
 IOHANDLE io_open(const char *filename, int flags)
 {
 	if(flags == IOFLAG_READ)
@@ -402,6 +465,54 @@ int io_flush(IOHANDLE io)
 	return 0;
 }
 
+void *io_map(IOHANDLE io, unsigned *size, int flags)
+{
+	long int length = io_length(io);
+	*size = 0;
+	if(length <= 0)
+		return 0;
+
+#if defined(CONF_FAMILY_WINDOWS)
+	{
+		HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE*)io));
+		HANDLE mapping = CreateFileMapping(file, NULL, flags&IOMAP_COPY ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		void *data;
+		if(!mapping)
+			return 0;
+		/* the view keeps the mapping object alive */
+		data = MapViewOfFile(mapping, flags&IOMAP_COPY ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if(!data)
+			return 0;
+		*size = length;
+		return data;
+	}
+#else
+	{
+		void *data;
+		if(flags&IOMAP_COPY)
+			data = mmap(0, length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno((FILE*)io), 0);
+		else
+			data = mmap(0, length, PROT_READ, MAP_SHARED, fileno((FILE*)io), 0);
+		if(data == MAP_FAILED)
+			return 0;
+		*size = length;
+		return data;
+	}
+#endif
+}
+
+void io_unmap(void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 struct THREAD_RUN
 {
 	void (*threadfunc)(void *);
@@ -502,7 +613,13 @@ void thread_detach(void *thread)
 
 
 
-#if defined(CONF_FAMILY_UNIX)
+#if defined(CONF_PLATFORM_LINUX)
+/* 0 is unlocked, 1 locked and 2 locked with threads that might sleep on it */
+typedef struct
+{
+	volatile int state;
+} LOCKINTERNAL;
+#elif defined(CONF_FAMILY_UNIX)
 typedef pthread_mutex_t LOCKINTERNAL;
 #elif defined(CONF_FAMILY_WINDOWS)
 typedef CRITICAL_SECTION LOCKINTERNAL;
@@ -510,14 +627,53 @@ typedef CRITICAL_SECTION LOCKINTERNAL;
 	#error not implemented on this platform
 #endif
 
+#if defined(CONF_PLATFORM_LINUX)
+static int futex_spin_count = -1;
+
+static void futex_wait(volatile int *addr, int val)
+{
+	/* only sleeps while *addr is still val */
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(volatile int *addr, int num)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, num, NULL, NULL, 0);
+}
+
+static int futex_spins()
+{
+	/* spinning only helps when the other thread runs on another core */
+	if(futex_spin_count < 0)
+		futex_spin_count = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 100 : 0;
+	return futex_spin_count;
+}
+
+static void cpu_relax()
+{
+#if defined(CONF_ARCH_IA32) || defined(CONF_ARCH_AMD64)
+	__asm__ __volatile__("pause");
+#endif
+}
+
+static int futex_cas(volatile int *addr, int expected, int val)
+{
+	return __atomic_compare_exchange_n(addr, &expected, val, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+#endif
+
 LOCK lock_create()
 {
 	LOCKINTERNAL *lock = (LOCKINTERNAL*)mem_alloc(sizeof(LOCKINTERNAL), 4);
 
-#if defined(CONF_FAMILY_UNIX)
+#if defined(CONF_PLATFORM_LINUX)
+	lock->state = 0;
+	futex_spins();
+#elif defined(CONF_FAMILY_UNIX)
 	pthread_mutex_init(lock, 0x0);
 #elif defined(CONF_FAMILY_WINDOWS)
-	InitializeCriticalSection((LPCRITICAL_SECTION)lock);
+	/* the spin count is ignored on single core machines */
+	InitializeCriticalSectionAndSpinCount((LPCRITICAL_SECTION)lock, 1000);
 #else
 	#error not implemented on this platform
 #endif
@@ -526,7 +682,8 @@ LOCK lock_create()
 
 void lock_destroy(LOCK lock)
 {
-#if defined(CONF_FAMILY_UNIX)
+#if defined(CONF_PLATFORM_LINUX)
+#elif defined(CONF_FAMILY_UNIX)
 	pthread_mutex_destroy((LOCKINTERNAL *)lock);
 #elif defined(CONF_FAMILY_WINDOWS)
 	DeleteCriticalSection((LPCRITICAL_SECTION)lock);
@@ -538,7 +695,9 @@ void lock_destroy(LOCK lock)
 
 int lock_trylock(LOCK lock)
 {
-#if defined(CONF_FAMILY_UNIX)
+#if defined(CONF_PLATFORM_LINUX)
+	return !futex_cas(&((LOCKINTERNAL *)lock)->state, 0, 1);
+#elif defined(CONF_FAMILY_UNIX)
 	return pthread_mutex_trylock((LOCKINTERNAL *)lock);
 #elif defined(CONF_FAMILY_WINDOWS)
 	return !TryEnterCriticalSection((LPCRITICAL_SECTION)lock);
@@ -549,7 +708,22 @@ int lock_trylock(LOCK lock)
 
 void lock_wait(LOCK lock)
 {
-#if defined(CONF_FAMILY_UNIX)
+#if defined(CONF_PLATFORM_LINUX)
+	volatile int *state = &((LOCKINTERNAL *)lock)->state;
+	int i;
+	for(i = 0; i < futex_spin_count; i++)
+	{
+		if(*state == 0 && futex_cas(state, 0, 1))
+			return;
+		cpu_relax();
+	}
+	if(futex_cas(state, 0, 1))
+		return;
+
+	/* mark it contended, whoever unlocks has to wake us */
+	while(__atomic_exchange_n(state, 2, __ATOMIC_ACQUIRE) != 0)
+		futex_wait(state, 2);
+#elif defined(CONF_FAMILY_UNIX)
 	pthread_mutex_lock((LOCKINTERNAL *)lock);
 #elif defined(CONF_FAMILY_WINDOWS)
 	EnterCriticalSection((LPCRITICAL_SECTION)lock);
@@ -560,7 +734,11 @@ void lock_wait(LOCK lock)
 
 void lock_unlock(LOCK lock)
 {
-#if defined(CONF_FAMILY_UNIX)
+#if defined(CONF_PLATFORM_LINUX)
+	volatile int *state = &((LOCKINTERNAL *)lock)->state;
+	if(__atomic_exchange_n(state, 0, __ATOMIC_RELEASE) == 2)
+		futex_wake(state, 1);
+#elif defined(CONF_FAMILY_UNIX)
 	pthread_mutex_unlock((LOCKINTERNAL *)lock);
 #elif defined(CONF_FAMILY_WINDOWS)
 	LeaveCriticalSection((LPCRITICAL_SECTION)lock);
@@ -570,7 +748,51 @@ void lock_unlock(LOCK lock)
 }
 
 #if !defined(CONF_PLATFORM_MACOSX)
-	#if defined(CONF_FAMILY_UNIX)
+	#if defined(CONF_PLATFORM_LINUX)
+	void semaphore_init(SEMAPHORE *sem)
+	{
+		sem->count = 0;
+		sem->waiters = 0;
+		futex_spins();
+	}
+
+	void semaphore_wait(SEMAPHORE *sem)
+	{
+		int i, count;
+		for(i = 0; i < futex_spin_count; i++)
+		{
+			count = sem->count;
+			if(count > 0 && futex_cas(&sem->count, count, count-1))
+				return;
+			cpu_relax();
+		}
+
+		/* count us in before looking at the count, so a signal in between
+		   either shows up in the count or knows it has to wake us */
+		__atomic_fetch_add(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+		while(1)
+		{
+			count = __atomic_load_n(&sem->count, __ATOMIC_SEQ_CST);
+			if(count > 0)
+			{
+				if(futex_cas(&sem->count, count, count-1))
+					break;
+			}
+			else
+				futex_wait(&sem->count, 0);
+		}
+		__atomic_fetch_sub(&sem->waiters, 1, __ATOMIC_RELAXED);
+	}
+
+	void semaphore_signal(SEMAPHORE *sem)
+	{
+		__atomic_fetch_add(&sem->count, 1, __ATOMIC_SEQ_CST);
+		if(__atomic_load_n(&sem->waiters, __ATOMIC_SEQ_CST) > 0)
+			futex_wake(&sem->count, 1);
+	}
+
+	void semaphore_destroy(SEMAPHORE *sem) {}
+	#elif defined(CONF_FAMILY_UNIX)
 	void semaphore_init(SEMAPHORE *sem) { sem_init(sem, 0, 0); }
 	void semaphore_wait(SEMAPHORE *sem) { sem_wait(sem); }
 	void semaphore_signal(SEMAPHORE *sem) { sem_post(sem); }
@@ -1670,6 +1892,99 @@ int time_isxmasday()
 	return 0;
 }
 
+int64 perf_time()
+{
+#if defined(CONF_FAMILY_UNIX) && !defined(CONF_PLATFORM_MACOSX)
+	struct timespec val;
+	clock_gettime(CLOCK_MONOTONIC, &val);
+	return (int64)val.tv_sec*(int64)1000000000+(int64)val.tv_nsec;
+#else
+	return time_get();
+#endif
+}
+
+int64 perf_freq()
+{
+#if defined(CONF_FAMILY_UNIX) && !defined(CONF_PLATFORM_MACOSX)
+	return 1000000000;
+#else
+	return time_freq();
+#endif
+}
+
+/* 8 linear buckets, then 4 buckets per power of two */
+static int perf_bucket(int64 duration)
+{
+	int e = 3;
+	int bucket;
+	if(duration < 8)
+		return duration < 0 ? 0 : (int)duration;
+	while((duration >> (e+1)) != 0)
+		e++;
+	bucket = 8 + (e-3)*4 + (int)((duration >> (e-2))&3);
+	return bucket < PERF_NUM_BUCKETS ? bucket : PERF_NUM_BUCKETS-1;
+}
+
+static int64 perf_bucket_top(int bucket)
+{
+	int e;
+	if(bucket < 8)
+		return bucket;
+	e = 3 + (bucket-8)/4;
+	return ((int64)(5+(bucket-8)%4) << (e-2)) - 1;
+}
+
+void perf_zone_init(PERF_ZONE *zone, const char *name)
+{
+	mem_zero(zone, sizeof(*zone));
+	zone->name = name;
+}
+
+void perf_zone_add(PERF_ZONE *zone, int64 duration)
+{
+	if(zone->count == 0 || duration < zone->min)
+		zone->min = duration;
+	if(zone->count == 0 || duration > zone->max)
+		zone->max = duration;
+	zone->count++;
+	zone->total += duration;
+	zone->buckets[perf_bucket(duration)]++;
+}
+
+void perf_zone_next(PERF_ZONE *zone)
+{
+	int64 left;
+	int i;
+
+	zone->last_count = zone->count;
+	zone->last_min = zone->min;
+	zone->last_max = zone->max;
+	zone->last_avg = zone->count ? zone->total/zone->count : 0;
+	zone->last_p99 = 0;
+
+	/* walk down from the top until 1% of the samples are passed */
+	left = zone->count/100;
+	for(i = PERF_NUM_BUCKETS-1; i >= 0 && zone->count; i--)
+	{
+		if(zone->buckets[i] > left)
+		{
+			zone->last_p99 = perf_bucket_top(i);
+			break;
+		}
+		left -= zone->buckets[i];
+	}
+	if(zone->last_p99 > zone->max)
+		zone->last_p99 = zone->max;
+	if(zone->last_p99 < zone->min)
+		zone->last_p99 = zone->min;
+
+	zone->count = 0;
+	zone->total = 0;
+	zone->min = 0;
+	zone->max = 0;
+	mem_zero(zone->buckets, sizeof(zone->buckets));
+}
+
 void str_append(char *dst, const char *src, int dst_size)
 {
 	int s = strlen(dst);
@@ -1984,6 +2299,38 @@ int mem_comp(const void *a, const void *b, int size)
 	return memcmp(a,b,size);
 }
 
+int mem_resident(const void *block, unsigned size)
+{
+#if defined(CONF_FAMILY_UNIX)
+	/* ask for the pages in batches so no allocation is needed */
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned pages = (size+page_size-1)/page_size;
+	unsigned first;
+	int resident = 0;
+#if defined(CONF_PLATFORM_MACOSX)
+	char vec[1024];
+#else
+	unsigned char vec[1024];
+#endif
+	if(!block)
+		return 0;
+
+	for(first = 0; first < pages; first += sizeof(vec))
+	{
+		unsigned num = pages-first < sizeof(vec) ? pages-first : sizeof(vec);
+		unsigned i;
+		if(mincore((char *)block+first*page_size, num*page_size, vec) != 0)
+			return -1;
+		for(i = 0; i < num; i++)
+			if(vec[i]&1)
+				resident += page_size;
+	}
+	return resident < (int)size ? resident : (int)size;
+#else
+	return -1;
+#endif
+}
+
 void net_stats(NETSTATS *stats_inout)
 {
 	*stats_inout = network_stats;
@@ -2247,6 +2594,60 @@ void secure_random_fill(void *bytes, unsigned length)
 #endif
 }
 
+#ifdef __GNUC__
+__extension__ typedef unsigned long long SIPWORD;
+#else
+typedef unsigned long long SIPWORD;
+#endif
+
+#define SIP_ROTL(x, b) (SIPWORD)(((x) << (b)) | ((x) >> (64 - (b))))
+#define SIP_ROUND(v0, v1, v2, v3) \
+	do { \
+		v0 += v1; v1 = SIP_ROTL(v1, 13); v1 ^= v0; v0 = SIP_ROTL(v0, 32); \
+		v2 += v3; v3 = SIP_ROTL(v3, 16); v3 ^= v2; \
+		v0 += v3; v3 = SIP_ROTL(v3, 21); v3 ^= v0; \
+		v2 += v1; v1 = SIP_ROTL(v1, 17); v1 ^= v2; v2 = SIP_ROTL(v2, 32); \
+	} while(0)
+
+int64 siphash24(const void *data, unsigned size, int64 k0, int64 k1)
+{
+	const unsigned char *in = (const unsigned char *)data;
+	SIPWORD v0 = 0x736f6d6570736575ULL ^ (SIPWORD)k0;
+	SIPWORD v1 = 0x646f72616e646f6dULL ^ (SIPWORD)k1;
+	SIPWORD v2 = 0x6c7967656e657261ULL ^ (SIPWORD)k0;
+	SIPWORD v3 = 0x7465646279746573ULL ^ (SIPWORD)k1;
+	SIPWORD m;
+	unsigned i, left = size&7;
+
+	/* whole little endian words */
+	for(; in != (const unsigned char *)data + (size-left); in += 8)
+	{
+		m = 0;
+		for(i = 0; i < 8; i++)
+			m |= (SIPWORD)in[i] << (8*i);
+		v3 ^= m;
+		SIP_ROUND(v0, v1, v2, v3);
+		SIP_ROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+
+	/* the rest and the length in the last word */
+	m = (SIPWORD)(size&0xff) << 56;
+	for(i = 0; i < left; i++)
+		m |= (SIPWORD)in[i] << (8*i);
+	v3 ^= m;
+	SIP_ROUND(v0, v1, v2, v3);
+	SIP_ROUND(v0, v1, v2, v3);
+	v0 ^= m;
+
+	v2 ^= 0xff;
+	SIP_ROUND(v0, v1, v2, v3);
+	SIP_ROUND(v0, v1, v2, v3);
+	SIP_ROUND(v0, v1, v2, v3);
+	SIP_ROUND(v0, v1, v2, v3);
+	return (int64)(v0 ^ v1 ^ v2 ^ v3);
+}
+
 #if defined(__cplusplus)
 }
 #endif
@@ -72,6 +72,28 @@ void dbg_msg(const char *sys, const char *fmt, ...);
 
 /* Group: Memory */
 
+/*
+	Macro: CONF_MEMSTATS
+		Counts live bytes, peak and allocations per <mem_alloc> tag.
+		Build with CONF_MEMSTATS=0 to remove the bookkeeping.
+*/
+#if !defined(CONF_MEMSTATS)
+	#define CONF_MEMSTATS 1
+#endif
+
+/* what the memory is used for, see <mem_stats> */
+enum
+{
+	MEMTAG_GENERAL=0,
+	MEMTAG_SNAPSHOT,
+	MEMTAG_BANS,
+	MEMTAG_CONSOLE,
+	MEMTAG_MAP,
+	MEMTAG_ENTITIES,
+	MEMTAG_HEAP,
+	NUM_MEMTAGS
+};
+
 /*
 	Function: mem_alloc
 		Allocates memory.
@@ -87,12 +109,25 @@ void dbg_msg(const char *sys, const char *fmt, ...);
 	Remarks:
 		- Passing 0 to size will allocated the smallest amount possible
 		and return a unique pointer.
+		- The memory is counted as MEMTAG_GENERAL, <mem_alloc_tag>
+		counts it for another tag.
 
 	See Also:
 		<mem_free>
 */
-void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned alignment);
-#define mem_alloc(s,a) mem_alloc_debug(__FILE__, __LINE__, (s), (a))
+void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned alignment, int tag);
+#define mem_alloc(s,a) mem_alloc_debug(__FILE__, __LINE__, (s), (a), MEMTAG_GENERAL)
+
+/*
+	Function: mem_alloc_tag
+		Allocates memory like <mem_alloc> and counts it for a tag.
+
+	Parameters:
+		size - Size of the needed block.
+		alignment - Alignment for the block.
+		tag - One of the MEMTAG_* values.
+*/
+#define mem_alloc_tag(s,a,t) mem_alloc_debug(__FILE__, __LINE__, (s), (a), (t))
 
 /*
 	Function: mem_free
@@ -170,6 +205,19 @@ void mem_zero(void *block, unsigned size);
 */
 int mem_comp(const void *a, const void *b, int size);
 
+/*
+	Function: mem_resident
+		Counts how much of a mapping is currently held in physical memory.
+
+	Parameters:
+		block - Page aligned pointer returned by <io_map>
+		size - Size of the mapping
+
+	Returns:
+		The number of resident bytes or -1 if this is not supported.
+*/
+int mem_resident(const void *block, unsigned size);
+
 /* Group: File IO */
 enum {
 	IOFLAG_READ = 1,
@@ -178,7 +226,10 @@ enum {
 
 	IOSEEK_START = 0,
 	IOSEEK_CUR = 1,
-	IOSEEK_END = 2
+	IOSEEK_END = 2,
+
+	IOMAP_READONLY = 0,
+	IOMAP_COPY = 1
 };
 
 typedef struct IOINTERNAL *IOHANDLE;
@@ -313,6 +364,37 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps the whole file into memory.
+
+	Parameters:
+		io - Handle to the file.
+		size - Pointer that receives the size of the mapping.
+		flags - IOMAP_READONLY for a shared read-only mapping or
+			IOMAP_COPY for a writable one whose writes are private and
+			never reach the file.
+
+	Returns:
+		Returns a pointer to the mapped data, 0 on failure or if the
+		file is empty.
+
+	Remarks:
+		- The mapping stays valid after the file has been closed.
+		- Unmodified pages of a mapped file are shared between processes.
+*/
+void *io_map(IOHANDLE io, unsigned *size, int flags);
+
+/*
+	Function: io_unmap
+		Releases a mapping created by io_map.
+
+	Parameters:
+		data - Pointer returned by io_map.
+		size - Size returned by io_map.
+*/
+void io_unmap(void *data, unsigned size);
+
 
 /*
 	Function: io_stdin
@@ -390,7 +472,22 @@ void thread_yield();
 */
 void thread_detach(void *thread);
 
-/* Group: Locks */
+/*
+	Macro: THREAD_LOCAL
+		Gives every thread its own copy of a global variable.
+*/
+#if defined(_MSC_VER)
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
+/*
+	Group: Locks
+		On linux locks and semaphores are built on futexes. They spin
+		a little on multi core machines before they put the thread to
+		sleep, which keeps short waits out of the kernel.
+*/
 typedef void* LOCK;
 
 LOCK lock_create();
@@ -404,7 +501,13 @@ void lock_unlock(LOCK lock);
 /* Group: Semaphores */
 
 #if !defined(CONF_PLATFORM_MACOSX)
-	#if defined(CONF_FAMILY_UNIX)
+	#if defined(CONF_PLATFORM_LINUX)
+		typedef struct
+		{
+			volatile int count;
+			volatile int waiters;
+		} SEMAPHORE;
+	#elif defined(CONF_FAMILY_UNIX)
 		#include <semaphore.h>
 		typedef sem_t SEMAPHORE;
 	#elif defined(CONF_FAMILY_WINDOWS)
@@ -477,6 +580,136 @@ int time_houroftheday();
 */
 int time_isxmasday();
 
+/* Group: Profiling */
+enum
+{
+	PERF_NUM_BUCKETS=128
+};
+
+/*
+	Structure: PERF_ZONE
+		Timings of one piece of code. Samples are gathered into a
+		period, finishing it with <perf_zone_next> publishes min, avg,
+		p99 and max of the period in the last_* fields.
+*/
+typedef struct
+{
+	const char *name;
+
+	/* running period */
+	int64 count;
+	int64 total;
+	int64 min;
+	int64 max;
+	unsigned buckets[PERF_NUM_BUCKETS];
+
+	/* last finished period */
+	int64 last_count;
+	int64 last_min;
+	int64 last_avg;
+	int64 last_p99;
+	int64 last_max;
+} PERF_ZONE;
+
+/*
+	Function: perf_time
+		Fetches a sample from a cheap monotonic timer meant for
+		timing short pieces of code.
+
+	Returns:
+		Current value of the timer.
+
+	Remarks:
+		To know how fast the timer is ticking, see <perf_freq>.
+*/
+int64 perf_time();
+
+/*
+	Function: perf_freq
+		Returns the frequency of the profiling timer.
+*/
+int64 perf_freq();
+
+/*
+	Function: perf_zone_init
+		Clears a zone.
+
+	Parameters:
+		zone - Zone to clear.
+		name - Name of the zone, it's not copied.
+*/
+void perf_zone_init(PERF_ZONE *zone, const char *name);
+
+/*
+	Function: perf_zone_add
+		Adds a sample to the running period of a zone.
+
+	Parameters:
+		zone - Zone to add the sample to.
+		duration - Duration in <perf_time> ticks.
+*/
+void perf_zone_add(PERF_ZONE *zone, int64 duration);
+
+/*
+	Function: perf_zone_next
+		Finishes the running period of a zone and starts a new one.
+
+	Remarks:
+		The p99 is taken from a logarithmic histogram and is exact
+		to about 25%.
+*/
+void perf_zone_next(PERF_ZONE *zone);
+
+/* Group: Memory Accounting */
+
+/*
+	Structure: MEMSTATS
+		Counters of one memory tag.
+*/
+typedef struct
+{
+	int64 live;
+	int64 peak;
+	int64 allocs;
+	int64 frees;
+} MEMSTATS;
+
+/*
+	Function: mem_stats
+		Fetches the counters of a tag.
+
+	Parameters:
+		tag - One of the MEMTAG_* values.
+		stats - Receives the counters, all zero when the build has
+			no CONF_MEMSTATS.
+
+	Remarks:
+		The counters are updated without locks, they can be a few
+		allocations apart from each other.
+*/
+void mem_stats(int tag, MEMSTATS *stats);
+
+/*
+	Function: mem_tag_name
+		Returns the name of a tag.
+*/
+const char *mem_tag_name(int tag);
+
+/*
+	Function: mem_track
+		Counts memory that doesn't come from <mem_alloc>, like
+		fixed pools.
+
+	Parameters:
+		tag - One of the MEMTAG_* values.
+		size - Bytes taken into use, negative when they are given back.
+*/
+#if CONF_MEMSTATS
+void mem_track(int tag, int size);
+#else
+#define mem_track(tag, size)
+#endif
+
 /* Group: Network General */
 typedef struct
 {
@@ -1346,6 +1579,22 @@ int secure_random_init();
 */
 void secure_random_fill(void *bytes, unsigned length);
 
+/*
+	Function: siphash24
+		Keyed hash of a buffer, SipHash-2-4. Cheap on short input and
+		not predictable without the key.
+
+	Parameters:
+		data - Pointer to the data.
+		size - Size of the data.
+		k0 - First half of the key.
+		k1 - Second half of the key.
+
+	Returns:
+		The 64 bit hash.
+*/
+int64 siphash24(const void *data, unsigned size, int64 k0, int64 k1);
+
 #ifdef __cplusplus
 }
 #endif
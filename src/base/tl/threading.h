@@ -2,14 +2,37 @@
 #pragma once
 
 #include "../system.h"
+#include "base.h"
 
 /*
 	atomic_inc - should return the value after increment
 	atomic_dec - should return the value after decrement
 	atomic_compswap - should return the value before the eventual swap
+	atomic_load - reads the value with the given memory order
+	atomic_store - writes the value with the given memory order
+	atomic_cas - swaps when the value equals *pExpected, else stores the
+		value it found in *pExpected, returns true on success
+	atomic_fetch_add - adds and returns the value before the addition
 	sync_barrier - creates a full hardware fence
+
+	memory orders:
+	MEMORY_ORDER_RELAXED - only the access itself is atomic
+	MEMORY_ORDER_ACQUIRE - later loads and stores can't move before it
+	MEMORY_ORDER_RELEASE - earlier loads and stores can't move after it
+	MEMORY_ORDER_ACQ_REL - both of the above, for read-modify-write
+	MEMORY_ORDER_SEQ_CST - acq_rel plus one total order of all seq_cst accesses
 */
 
+// same values as the gcc __ATOMIC_* constants
+enum
+{
+	MEMORY_ORDER_RELAXED=0,
+	MEMORY_ORDER_ACQUIRE=2,
+	MEMORY_ORDER_RELEASE=3,
+	MEMORY_ORDER_ACQ_REL=4,
+	MEMORY_ORDER_SEQ_CST=5,
+};
+
 #if defined(__GNUC__)
 
 	inline unsigned atomic_inc(volatile unsigned *pValue)
@@ -27,6 +50,28 @@
 		return __sync_val_compare_and_swap(pValue, comperand, value);
 	}
 
+	inline unsigned atomic_load(const volatile unsigned *pValue, int order)
+	{
+		return __atomic_load_n(pValue, order);
+	}
+
+	inline void atomic_store(volatile unsigned *pValue, unsigned value, int order)
+	{
+		__atomic_store_n(pValue, value, order);
+	}
+
+	inline bool atomic_cas(volatile unsigned *pValue, unsigned *pExpected, unsigned value, int order)
+	{
+		// a failed swap only loads, which can't have release semantics
+		int failorder = order == MEMORY_ORDER_ACQ_REL ? MEMORY_ORDER_ACQUIRE : order == MEMORY_ORDER_RELEASE ? MEMORY_ORDER_RELAXED : order;
+		return __atomic_compare_exchange_n(pValue, pExpected, value, false, order, failorder);
+	}
+
+	inline unsigned atomic_fetch_add(volatile unsigned *pValue, unsigned value, int order)
+	{
+		return __atomic_fetch_add(pValue, value, order);
+	}
+
 	inline void sync_barrier()
 	{
 		__sync_synchronize();
@@ -55,6 +100,71 @@
 		return _InterlockedCompareExchange((volatile long *)pValue, (long)value, (long)comperand);
 	}
 
+#if defined(_M_IX86) || defined(_M_X64)
+	// x86 keeps the order of loads and of stores, only the compiler has to be
+	// stopped. seq_cst stores need the locked exchange
+	inline unsigned atomic_load(const volatile unsigned *pValue, int order)
+	{
+		unsigned value = *pValue;
+		_ReadWriteBarrier();
+		return value;
+	}
+
+	inline void atomic_store(volatile unsigned *pValue, unsigned value, int order)
+	{
+		if(order == MEMORY_ORDER_SEQ_CST)
+			_InterlockedExchange((volatile long *)pValue, (long)value);
+		else
+		{
+			_ReadWriteBarrier();
+			*pValue = value;
+		}
+	}
+#elif defined(_M_ARM) || defined(_M_ARM64)
+	// arm reorders loads and stores, everything but relaxed needs a barrier
+	#if defined(_M_ARM64)
+		#define TL_DMB() __dmb(_ARM64_BARRIER_ISH)
+	#else
+		#define TL_DMB() __dmb(_ARM_BARRIER_ISH)
+	#endif
+
+	inline unsigned atomic_load(const volatile unsigned *pValue, int order)
+	{
+		unsigned value = __iso_volatile_load32((const volatile __int32 *)pValue);
+		if(order != MEMORY_ORDER_RELAXED)
+			TL_DMB();
+		return value;
+	}
+
+	inline void atomic_store(volatile unsigned *pValue, unsigned value, int order)
+	{
+		if(order != MEMORY_ORDER_RELAXED)
+			TL_DMB();
+		__iso_volatile_store32((volatile __int32 *)pValue, (__int32)value);
+		if(order == MEMORY_ORDER_SEQ_CST)
+			TL_DMB();
+	}
+#else
+	#error missing atomic load and store for this architecture
+#endif
+
+	// the interlocked functions are full fences on every architecture, so
+	// they give at least the order that was asked for
+
+	inline bool atomic_cas(volatile unsigned *pValue, unsigned *pExpected, unsigned value, int order)
+	{
+		unsigned prev = _InterlockedCompareExchange((volatile long *)pValue, (long)value, (long)*pExpected);
+		if(prev == *pExpected)
+			return true;
+		*pExpected = prev;
+		return false;
+	}
+
+	inline unsigned atomic_fetch_add(volatile unsigned *pValue, unsigned value, int order)
+	{
+		return _InterlockedExchangeAdd((volatile long *)pValue, (long)value);
+	}
+
 	inline void sync_barrier()
 	{
 		MemoryBarrier();
@@ -115,3 +225,274 @@ public:
 		var->release();
 	}
 };
+
+
+enum
+{
+	CACHE_LINE_SIZE=64
+};
+
+/*
+	Class: queue_waiter
+		Lets the consumer of a lock-free queue sleep while it is empty
+
+	Remarks:
+		- The consumer calls prepare(), checks the queue again and
+		  then either wait() or cancel()
+		- Producers call signal() after pushing, it only costs a
+		  fence when nobody sleeps. Pushes may share one signal(), but
+		  a producer has to signal before it waits for a full queue
+*/
+class queue_waiter
+{
+	volatile unsigned waiting;
+	char pad[CACHE_LINE_SIZE-sizeof(unsigned)];
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore sem;
+#endif
+
+public:
+	queue_waiter() { waiting = 0; }
+
+	void prepare()
+	{
+		// the fence keeps the queue check after it from moving before the store
+		atomic_store(&waiting, 1, MEMORY_ORDER_RELAXED);
+		sync_barrier();
+	}
+
+	// a signal that already took the flag leaves one spurious wake up, pop_wait() retries then
+	void cancel() { atomic_store(&waiting, 0, MEMORY_ORDER_RELAXED); }
+
+	void wait()
+	{
+#if defined(CONF_PLATFORM_MACOSX)
+		// no semaphore in base here
+		while(atomic_load(&waiting, MEMORY_ORDER_ACQUIRE))
+			thread_sleep(1);
+#else
+		sem.wait();
+#endif
+	}
+
+	void signal()
+	{
+		sync_barrier();
+		if(atomic_load(&waiting, MEMORY_ORDER_RELAXED) && atomic_compswap(&waiting, 1, 0) == 1)
+		{
+#if !defined(CONF_PLATFORM_MACOSX)
+			sem.signal();
+#endif
+		}
+	}
+};
+
+/*
+	Class: spsc_ring
+		Lock-free ring buffer for one producer and one consumer thread
+
+	Remarks:
+		- SIZE must be a power of two, push() fails when SIZE items are queued
+		- Head and tail live on their own cache lines, each side keeps a
+		  copy of the other index to touch the shared one less often
+*/
+template<class T, int SIZE>
+class spsc_ring
+{
+	// consumer
+	volatile unsigned head;
+	unsigned cached_tail;
+	char pad0[CACHE_LINE_SIZE-2*sizeof(unsigned)];
+
+	// producer
+	volatile unsigned tail;
+	unsigned cached_head;
+	char pad1[CACHE_LINE_SIZE-2*sizeof(unsigned)];
+
+	T items[SIZE];
+	queue_waiter waiter;
+
+public:
+	spsc_ring()
+	{
+		tl_assert((SIZE&(SIZE-1)) == 0);
+		head = cached_tail = 0;
+		tail = cached_head = 0;
+	}
+
+	/*
+		Function: push
+			Called by the producer, returns false when full
+	*/
+	bool push(const T &item)
+	{
+		unsigned t = tail;
+		if(t-cached_head == (unsigned)SIZE)
+		{
+			cached_head = atomic_load(&head, MEMORY_ORDER_ACQUIRE);
+			if(t-cached_head == (unsigned)SIZE)
+				return false;
+		}
+		items[t&(SIZE-1)] = item;
+		atomic_store(&tail, t+1, MEMORY_ORDER_RELEASE);
+		return true;
+	}
+
+	/*
+		Function: pop
+			Called by the consumer, returns false when empty
+	*/
+	bool pop(T *pItem)
+	{
+		unsigned h = head;
+		if(h == cached_tail)
+		{
+			cached_tail = atomic_load(&tail, MEMORY_ORDER_ACQUIRE);
+			if(h == cached_tail)
+				return false;
+		}
+		*pItem = items[h&(SIZE-1)];
+		atomic_store(&head, h+1, MEMORY_ORDER_RELEASE);
+		return true;
+	}
+
+	/*
+		Function: pop_wait
+			Like pop() but sleeps until there is an item
+	*/
+	void pop_wait(T *pItem)
+	{
+		while(!pop(pItem))
+		{
+			waiter.prepare();
+			if(pop(pItem))
+			{
+				waiter.cancel();
+				return;
+			}
+			waiter.wait();
+		}
+	}
+
+	/*
+		Function: signal
+			Wakes the consumer in pop_wait(), call it after pushing
+	*/
+	void signal() { waiter.signal(); }
+
+	/*
+		Function: size
+			Number of queued items, exact only on the producer or
+			consumer thread while the other side is idle
+	*/
+	int size() const { return (int)(atomic_load(&tail, MEMORY_ORDER_ACQUIRE)-atomic_load(&head, MEMORY_ORDER_ACQUIRE)); }
+};
+
+/*
+	Class: mpsc_queue
+		Lock-free bounded queue for many producer threads and one consumer
+
+	Remarks:
+		- SIZE must be a power of two
+		- Every slot has a sequence number that tells whose turn it is,
+		  producers claim slots with a compare and swap on the tail
+*/
+template<class T, int SIZE>
+class mpsc_queue
+{
+	struct slot
+	{
+		volatile unsigned seq;
+		T item;
+	};
+
+	// producers
+	volatile unsigned tail;
+	char pad0[CACHE_LINE_SIZE-sizeof(unsigned)];
+
+	// consumer
+	unsigned head;
+	char pad1[CACHE_LINE_SIZE-sizeof(unsigned)];
+
+	slot slots[SIZE];
+	queue_waiter waiter;
+
+public:
+	mpsc_queue()
+	{
+		tl_assert((SIZE&(SIZE-1)) == 0);
+		for(int i = 0; i < SIZE; i++)
+			slots[i].seq = i;
+		tail = 0;
+		head = 0;
+	}
+
+	/*
+		Function: push
+			Called by any producer, returns false when full
+	*/
+	bool push(const T &item)
+	{
+		unsigned t = tail;
+		slot *s;
+		while(1)
+		{
+			s = &slots[t&(SIZE-1)];
+			int diff = (int)(atomic_load(&s->seq, MEMORY_ORDER_ACQUIRE)-t);
+			if(diff == 0)
+			{
+				// free slot, try to claim it
+				unsigned prev = atomic_compswap(&tail, t, t+1);
+				if(prev == t)
+					break;
+				t = prev;
+			}
+			else if(diff < 0)
+				return false; // the consumer is a round behind
+			else
+				t = tail; // somebody else took it
+		}
+		s->item = item;
+		atomic_store(&s->seq, t+1, MEMORY_ORDER_RELEASE);
+		return true;
+	}
+
+	/*
+		Function: pop
+			Called by the consumer, returns false when empty
+	*/
+	bool pop(T *pItem)
+	{
+		slot *s = &slots[head&(SIZE-1)];
+		if(atomic_load(&s->seq, MEMORY_ORDER_ACQUIRE) != head+1)
+			return false;
+		*pItem = s->item;
+		atomic_store(&s->seq, head+SIZE, MEMORY_ORDER_RELEASE);
+		head++;
+		return true;
+	}
+
+	/*
+		Function: pop_wait
+			Like pop() but sleeps until there is an item
+	*/
+	void pop_wait(T *pItem)
+	{
+		while(!pop(pItem))
+		{
+			waiter.prepare();
+			if(pop(pItem))
+			{
+				waiter.cancel();
+				return;
+			}
+			waiter.wait();
+		}
+	}
+
+	/*
+		Function: signal
+			Wakes the consumer in pop_wait(), call it after pushing
+	*/
+	void signal() { waiter.signal(); }
+};
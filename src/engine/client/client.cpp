@@ -33,6 +33,7 @@
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
+#include <engine/shared/protocol_ex.h>
 #include <engine/shared/ringbuffer.h>
 #include <engine/shared/snapshot.h>
 
@@ -401,8 +402,7 @@ void CClient::SendInput()
 	m_aInputs[m_CurrentInput].m_Time = Now;
 
 	// pack it
-	for(int i = 0; i < Size/4; i++)
-		Msg.AddInt(m_aInputs[m_CurrentInput].m_aData[i]);
+	Msg.AddInts(m_aInputs[m_CurrentInput].m_aData, Size/4);
 
 	int PingCorrection = 0;
 	int64 TagTime;
@@ -414,6 +414,18 @@ void CClient::SendInput()
 	m_CurrentInput%=200;
 
 	SendMsg(&Msg, MSGFLAG_FLUSH);
+
+	// report lost snapshot parts once a second, the server sizes its parity by it
+	if(Now-m_SnapLossReportTime > time_freq() && m_SnapshotParts.m_PartsExpected)
+	{
+		CMsgPacker Msg(NETMSG_SNAPLOSS, true);
+		Msg.AddInt(m_SnapshotParts.m_PartsExpected);
+		Msg.AddInt(m_SnapshotParts.m_PartsLost);
+		SendMsg(&Msg, 0);
+		m_SnapshotParts.m_PartsExpected = 0;
+		m_SnapshotParts.m_PartsLost = 0;
+		m_SnapLossReportTime = Now;
+	}
 }
 
 const char *CClient::LatestVersion() const
@@ -468,7 +480,11 @@ void CClient::OnEnterGame()
 	m_aSnapshots[SNAP_PREV] = 0;
 	m_SnapshotStorage.PurgeAll();
 	m_RecivedSnapshots = 0;
-	m_SnapshotParts = 0;
+	m_SnapshotParts.Reset(-1, 0, MAX_SNAPSHOT_PACKSIZE);
+	m_SnapshotParts.m_PartsExpected = 0;
+	m_SnapshotParts.m_PartsLost = 0;
+	m_SnapshotParts.m_PartsRecovered = 0;
+	m_SnapLossReportTime = 0;
 	m_PredTick = 0;
 	m_CurrentRecvTick = 0;
 	m_CurGameTick = 0;
@@ -520,6 +536,8 @@ void CClient::Connect(const char *pAddress)
 
 	m_InputtimeMarginGraph.Init(-150.0f, 150.0f);
 	m_GametimeMarginGraph.Init(-150.0f, 150.0f);
+	m_RttGraph.Init(0.0f, 100.0f);
+	m_LossGraph.Init(0.0f, 10.0f);
 }
 
 void CClient::DisconnectWithReason(const char *pReason)
@@ -734,6 +752,10 @@ void CClient::DebugRender()
 		m_GametimeMarginGraph.ScaleMin();
 		m_GametimeMarginGraph.ScaleMax();
 		m_GametimeMarginGraph.Render(Graphics(), m_DebugFont, x, sp*5+h+sp+h+sp, w, h, "Gametime Margin");
+		m_RttGraph.ScaleMax();
+		m_RttGraph.Render(Graphics(), m_DebugFont, x, sp*5+(h+sp)*3, w, h, "RTT (ms)");
+		m_LossGraph.ScaleMax();
+		m_LossGraph.Render(Graphics(), m_DebugFont, x, sp*5+(h+sp)*4, w, h, "Loss (%)");
 	}
 }
 
@@ -1220,10 +1242,12 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 			if(Target)
 				m_PredictedTime.Update(&m_InputtimeMarginGraph, Target, TimeLeft, 1);
 		}
-		else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
+		else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY || Msg == NETMSG_SNAPPARITY)
 		{
 			int NumParts = 1;
 			int Part = 0;
+			int GroupSize = 0;
+			int TotalSize = 0;
 			int GameTick = Unpacker.GetInt();
 			int DeltaTick = GameTick-Unpacker.GetInt();
 			int PartSize = 0;
@@ -1235,12 +1259,18 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 			if(State() < IClient::STATE_LOADING)
 				return;
 
-			if(Msg == NETMSG_SNAP)
+			if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPPARITY)
 			{
 				NumParts = Unpacker.GetInt();
 				Part = Unpacker.GetInt();
 			}
 
+			if(Msg == NETMSG_SNAPPARITY)
+			{
+				GroupSize = Unpacker.GetInt();
+				TotalSize = Unpacker.GetInt();
+			}
+
 			if(Msg != NETMSG_SNAPEMPTY)
 			{
 				Crc = Unpacker.GetInt();
@@ -1254,17 +1284,19 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 
 			if(GameTick >= m_CurrentRecvTick)
 			{
-				if(GameTick != m_CurrentRecvTick)
+				if(GameTick != m_CurrentRecvTick || GameTick != m_SnapshotParts.Tick() || NumParts != m_SnapshotParts.NumParts())
 				{
-					m_SnapshotParts = 0;
+					m_SnapshotParts.Reset(GameTick, NumParts, MAX_SNAPSHOT_PACKSIZE);
 					m_CurrentRecvTick = GameTick;
 				}
 
-				// TODO: clean this up abit
-				mem_copy((char*)m_aSnapshotIncommingData + Part*MAX_SNAPSHOT_PACKSIZE, pData, PartSize);
-				m_SnapshotParts |= 1<<Part;
+				// a parity part can complete the snapshot aswell
+				if(Msg == NETMSG_SNAPPARITY)
+					m_SnapshotParts.AddParity(Part, GroupSize, TotalSize, pData, PartSize);
+				else
+					m_SnapshotParts.AddPart(Part, pData, PartSize);
 
-				if(m_SnapshotParts == (unsigned)((1<<NumParts)-1))
+				if(!m_SnapshotParts.Done() && m_SnapshotParts.Complete())
 				{
 					static CSnapshot Emptysnap;
 					CSnapshot *pDeltaShot = &Emptysnap;
@@ -1276,10 +1308,10 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 					CSnapshot *pTmpBuffer3 = (CSnapshot*)aTmpBuffer3;	// Fix compiler warning for strict-aliasing
 					int SnapSize;
 
-					CompleteSize = (NumParts-1) * MAX_SNAPSHOT_PACKSIZE + PartSize;
+					CompleteSize = m_SnapshotParts.Size();
 
 					// reset snapshoting
-					m_SnapshotParts = 0;
+					m_SnapshotParts.SetDone();
 
 					// find snapshot that we should use as delta
 					Emptysnap.Clear();
@@ -1313,7 +1345,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 
 					if(CompleteSize)
 					{
-						int IntSize = CVariableInt::Decompress(m_aSnapshotIncommingData, CompleteSize, aTmpBuffer2, sizeof(aTmpBuffer2));
+						int IntSize = CVariableInt::Decompress(m_SnapshotParts.Data(), CompleteSize, aTmpBuffer2, sizeof(aTmpBuffer2));
 
 						if(IntSize < 0) // failure during decompression, bail
 							return;
@@ -1406,6 +1438,11 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 						m_GameTime.Update(&m_GametimeMarginGraph, (GameTick-1)*time_freq()/50, TimeLeft, 0);
 					}
 
+					// link quality
+					const CNetConnection *pConn = m_NetClient.Connection();
+					m_RttGraph.Add(pConn->Rtt(), 1,1,1);
+					m_LossGraph.Add(pConn->LossRate()*100.0f, 1,0.5f,0.5f);
+
 					// ack snapshot
 					m_AckGameTick = GameTick;
 				}
@@ -1814,7 +1851,6 @@ bool CClient::LimitFps()
 void CClient::Run()
 {
 	m_LocalStartTime = time_get();
-	m_SnapshotParts = 0;
 
 	// init SDL
 	{
@@ -2023,6 +2059,14 @@ void CClient::Run()
 						DebugRender();
 					}
 					m_pGraphics->Swap();
+
+					if(m_LaunchTime)
+					{
+						char aBuf[64];
+						str_format(aBuf, sizeof(aBuf), "startup took %.2fms", ((time_get()-m_LaunchTime)*1000)/(float)time_freq());
+						m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client", aBuf);
+						m_LaunchTime = 0;
+					}
 				}
 			}
 		}
@@ -2077,6 +2121,8 @@ void CClient::Run()
 	GameClient()->OnShutdown();
 	Disconnect();
 
+	Kernel()->RequestInterface<IEngineTextRender>()->Shutdown();
+
 	m_pGraphics->Shutdown();
 	m_pSound->Shutdown();
 
@@ -2155,6 +2201,59 @@ void CClient::Con_Screenshot(IConsole::IResult *pResult, void *pUserData)
 	pSelf->Graphics()->TakeScreenshot(0);
 }
 
+// times text layouts: the same rows every frame like the server browser,
+// new strings every call and glyphs of many sizes the atlas has to take
+void CClient::Con_TextBench(IConsole::IResult *pResult, void *pUserData)
+{
+	CClient *pSelf = (CClient *)pUserData;
+	ITextRender *pTextRender = pSelf->Kernel()->RequestInterface<ITextRender>();
+	int Num = pResult->NumArguments() ? max(pResult->GetInteger(0), 1) : 1000;
+	char aText[128];
+	char aBuf[256];
+
+	int64 Start = time_get();
+	for(int f = 0; f < 10; f++)
+		for(int i = 0; i < Num; i++)
+		{
+			str_format(aText, sizeof(aText), "Server %d | ctf5 | %d/16", i, i%17);
+			pTextRender->TextWidth(0, 10.0f, aText, -1);
+		}
+	double RowTime = (time_get()-Start)*1000000000.0/time_freq()/(10.0*Num);
+
+	// differs between runs too, so nothing is cached yet
+	static int s_Run = 0;
+	s_Run++;
+	Start = time_get();
+	for(int i = 0; i < 10*Num; i++)
+	{
+		str_format(aText, sizeof(aText), "Player %d scored %d", i, s_Run);
+		pTextRender->TextWidth(0, 10.0f, aText, -1);
+	}
+	double NewTime = (time_get()-Start)*1000000000.0/time_freq()/(10.0*Num);
+
+	// latin and cyrillic letters at 22 sizes, the first pass rasterizes them
+	double aGlyphTime[2];
+	for(int Pass = 0; Pass < 2; Pass++)
+	{
+		Start = time_get();
+		for(int Size = 6; Size < 50; Size += 2)
+			for(int Chr = 0x21; Chr < 0x4ff; Chr += 32)
+			{
+				int Length = 0;
+				for(int c = Chr; c < Chr+32; c++)
+					Length += str_utf8_encode(aText+Length, c < 0x7f || c >= 0xa1 ? c : 'a');
+				aText[Length] = 0;
+				pTextRender->TextWidth(0, (float)Size, aText, -1);
+			}
+		aGlyphTime[Pass] = (time_get()-Start)*1000.0/time_freq();
+	}
+
+	str_format(aBuf, sizeof(aBuf), "%d rows: cached %.0fns per row, new text %.0fns per row", Num, RowTime, NewTime);
+	pSelf->m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "text_bench", aBuf);
+	str_format(aBuf, sizeof(aBuf), "glyphs at 22 sizes: cold %.2fms, warm %.2fms", aGlyphTime[0], aGlyphTime[1]);
+	pSelf->m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "text_bench", aBuf);
+}
+
 void CClient::Con_Rcon(IConsole::IResult *pResult, void *pUserData)
 {
 	CClient *pSelf = (CClient *)pUserData;
@@ -2397,6 +2496,7 @@ void CClient::RegisterCommands()
 	m_pConsole->Register("disconnect", "", CFGFLAG_CLIENT, Con_Disconnect, this, "Disconnect from the server");
 	m_pConsole->Register("ping", "", CFGFLAG_CLIENT, Con_Ping, this, "Ping the current server");
 	m_pConsole->Register("screenshot", "", CFGFLAG_CLIENT, Con_Screenshot, this, "Take a screenshot");
+	m_pConsole->Register("text_bench", "?i", CFGFLAG_CLIENT, Con_TextBench, this, "Measure text layouts and glyph rendering");
 	m_pConsole->Register("rcon", "r", CFGFLAG_CLIENT, Con_Rcon, this, "Send specified command to rcon");
 	m_pConsole->Register("rcon_auth", "s", CFGFLAG_CLIENT, Con_RconAuth, this, "Authenticate to rcon");
 	m_pConsole->Register("play", "r", CFGFLAG_CLIENT|CFGFLAG_STORE, Con_Play, this, "Play the file specified");
@@ -2444,6 +2544,8 @@ extern "C" int SDL_main(int argc, char **argv_) // ignore_convention
 int main(int argc, const char **argv) // ignore_convention
 {
 #endif
+	int64 LaunchTime = time_get();
+
 #if defined(CONF_FAMILY_WINDOWS)
 	#ifdef CONF_RELEASE
 	bool HideConsole = true;
@@ -2479,13 +2581,14 @@ int main(int argc, const char **argv) // ignore_convention
 	}
 
 	CClient *pClient = CreateClient();
+	pClient->SetLaunchTime(LaunchTime);
 	IKernel *pKernel = IKernel::Create();
 	pKernel->RegisterInterface(pClient);
 	pClient->RegisterInterfaces();
 
 	// create the components
 	int FlagMask = CFGFLAG_CLIENT;
-	IEngine *pEngine = CreateEngine("Teeworlds");
+	IEngine *pEngine = CreateEngine("Teeworlds", 4);
 	IConsole *pConsole = CreateConsole(FlagMask);
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_CLIENT, argc, argv); // ignore_convention
 	IConfig *pConfig = CreateConfig();
@@ -80,8 +80,10 @@ class CClient : public IClient, public CDemoPlayer::IListner
 
 	char m_aServerAddressStr[256];
 
-	unsigned m_SnapshotParts;
+	CSnapshotParts m_SnapshotParts;
+	int64 m_SnapLossReportTime;
 	int64 m_LocalStartTime;
+	int64 m_LaunchTime; // reset once the first frame is rendered
 
 	IGraphics::CTextureHandle m_DebugFont;
 
@@ -149,13 +151,14 @@ class CClient : public IClient, public CDemoPlayer::IListner
 	CGraph m_InputtimeMarginGraph;
 	CGraph m_GametimeMarginGraph;
 	CGraph m_FpsGraph;
+	CGraph m_RttGraph;
+	CGraph m_LossGraph;
 
 	// the game snapshots are modifiable by the game
 	class CSnapshotStorage m_SnapshotStorage;
 	CSnapshotStorage::CHolder *m_aSnapshots[NUM_SNAPSHOT_TYPES];
 
 	int m_RecivedSnapshots;
-	char m_aSnapshotIncommingData[CSnapshot::MAX_SIZE];
 
 	class CSnapshotStorage::CHolder m_aDemorecSnapshotHolders[NUM_SNAPSHOT_TYPES];
 	char *m_aDemorecSnapshotData[NUM_SNAPSHOT_TYPES][2][CSnapshot::MAX_SIZE];
@@ -194,6 +197,9 @@ public:
 
 	CClient();
 
+	// taken at the top of main, the time until the first frame is printed as startup time
+	void SetLaunchTime(int64 Time) { m_LaunchTime = Time; }
+
 	// ----- send functions -----
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags);
 
@@ -285,6 +291,7 @@ public:
 	static void Con_Minimize(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Ping(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Screenshot(IConsole::IResult *pResult, void *pUserData);
+	static void Con_TextBench(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Rcon(IConsole::IResult *pResult, void *pUserData);
 	static void Con_RconAuth(IConsole::IResult *pResult, void *pUserData);
 	static void Con_AddFavorite(IConsole::IResult *pResult, void *pUserData);
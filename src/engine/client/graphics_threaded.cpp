@@ -336,8 +336,28 @@ IGraphics::CTextureHandle CGraphics_Threaded::LoadTextureRaw(int Width, int Heig
 	m_FirstFreeTexture = m_aTextureIndices[Tex];
 	m_aTextureIndices[Tex] = -1;
 
+	CreateTexture(Tex, Width, Height, Format, pData, StoreFormat, Flags);
+	return CreateTextureHandle(Tex);
+}
+
+int CGraphics_Threaded::ReloadTextureRaw(CTextureHandle TextureID, int Width, int Height, int Format, const void *pData, int StoreFormat, int Flags)
+{
+	if(TextureID.Id() == m_InvalidTexture.Id() || !TextureID.IsValid())
+		return 0;
+
+	// recreate the texture in the same slot, so the handle stays valid
+	CCommandBuffer::SCommand_Texture_Destroy Cmd;
+	Cmd.m_Slot = TextureID.Id();
+	m_pCommandBuffer->AddCommand(Cmd);
+
+	CreateTexture(TextureID.Id(), Width, Height, Format, pData, StoreFormat, Flags);
+	return 0;
+}
+
+void CGraphics_Threaded::CreateTexture(int Slot, int Width, int Height, int Format, const void *pData, int StoreFormat, int Flags)
+{
 	CCommandBuffer::SCommand_Texture_Create Cmd;
-	Cmd.m_Slot = Tex;
+	Cmd.m_Slot = Slot;
 	Cmd.m_Width = Width;
 	Cmd.m_Height = Height;
 	Cmd.m_PixelSize = ImageFormatToPixelSize(Format);
@@ -373,8 +393,6 @@ IGraphics::CTextureHandle CGraphics_Threaded::LoadTextureRaw(int Width, int Heig
 
 	//
 	m_pCommandBuffer->AddCommand(Cmd);
-
-	return CreateTextureHandle(Tex);
 }
 
 // simple uncompressed RGBA loaders
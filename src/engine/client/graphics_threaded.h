@@ -384,6 +384,7 @@ class CGraphics_Threaded : public IEngineGraphics
 	void Rotate4(const CCommandBuffer::SPoint &rCenter, CCommandBuffer::SVertex *pPoints);
 
 	void KickCommandBuffer();
+	void CreateTexture(int Slot, int Width, int Height, int Format, const void *pData, int StoreFormat, int Flags);
 
 	int IssueInit();
 	int InitWindow();
@@ -413,6 +414,7 @@ public:
 	virtual int UnloadTexture(IGraphics::CTextureHandle *Index);
 	virtual IGraphics::CTextureHandle LoadTextureRaw(int Width, int Height, int Format, const void *pData, int StoreFormat, int Flags);
 	virtual int LoadTextureRawSub(IGraphics::CTextureHandle TextureID, int x, int y, int Width, int Height, int Format, const void *pData);
+	virtual int ReloadTextureRaw(IGraphics::CTextureHandle TextureID, int Width, int Height, int Format, const void *pData, int StoreFormat, int Flags);
 
 	// simple uncompressed RGBA loaders
 	virtual IGraphics::CTextureHandle LoadTexture(const char *pFilename, int StorageType, int StoreFormat, int Flags);
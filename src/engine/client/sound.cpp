@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/graphics.h>
 #include <engine/storage.h>
@@ -11,6 +12,7 @@
 #include "SDL.h"
 
 #include "sound.h"
+#include "soundmix.h"
 
 extern "C" { // wavpack
 	#include <engine/external/wavpack/wavpack.h>
@@ -22,6 +24,9 @@ enum
 	NUM_SAMPLES = 512,
 	NUM_VOICES = 64,
 	NUM_CHANNELS = 16,
+
+	NUM_COMMANDS = 256,
+	PAN_TABLE_SIZE = 256,
 };
 
 struct CSample
@@ -40,20 +45,52 @@ struct CChannel
 	int m_Vol; // 0 - 255
 };
 
+// owned by the mixer
 struct CVoice
 {
 	CSample *m_pSample;
 	CChannel *m_pChannel;
+	unsigned m_Serial;
 	int m_Tick;
 	int m_Vol; // 0 - 255
 	int m_Flags;
 	int m_X, m_Y;
 };
 
+// voice changes are passed from the game thread to the mixer through a
+// single producer, single consumer queue, so the mixer never has to lock
+struct CVoiceCommand
+{
+	enum
+	{
+		CMD_PLAY=0,
+		CMD_STOP,
+		CMD_STOP_ALL,
+	};
+
+	int m_Cmd;
+	int m_Voice;
+	unsigned m_Serial;
+	int m_Sample;
+	int m_Channel;
+	int m_Flags;
+	int m_X, m_Y;
+};
+
 static CSample m_aSamples[NUM_SAMPLES] = { {0} };
 static CVoice m_aVoices[NUM_VOICES] = { {0} };
 static CChannel m_aChannels[NUM_CHANNELS] = { {255} };
 
+static CVoiceCommand m_aCommands[NUM_COMMANDS];
+static volatile unsigned m_CommandWrite = 0;
+static volatile unsigned m_CommandRead = 0;
+
+// voice state as seen by the game thread. a voice is in use as long as its
+// serial is set, the mixer clears it when the voice runs out
+static volatile unsigned m_aVoiceSerials[NUM_VOICES] = {0};
+static int m_aVoiceSamples[NUM_VOICES] = {0};
+static unsigned m_NextSerial = 0;
+
 static LOCK m_SoundLock = 0;
 
 static int m_CenterX = 0;
@@ -61,6 +98,9 @@ static int m_CenterY = 0;
 
 static float m_MaxDistance = 1500.0f;
 
+// square roots of the pan factors, to preserve sound power after panning
+static float m_aPanTable[PAN_TABLE_SIZE+1];
+
 static int m_MixingRate = 48000;
 static volatile int m_SoundVolume = 100;
 
@@ -68,14 +108,83 @@ static int m_NextVoice = 0;
 static int *m_pMixBuffer = 0;	// buffer only used by the thread callback function
 static unsigned m_MaxFrames = 0;
 
-// TODO: there should be a faster way todo this
-static short Int2Short(int i)
+// null device, mixes into a buffer that is thrown away
+static short *m_pNullBuffer = 0;
+static int64 m_NullLastMix = 0;
+
+static bool PushCommand(const CVoiceCommand *pCommand)
 {
-	if(i > 0x7fff)
-		return 0x7fff;
-	else if(i < -0x7fff)
-		return -0x7fff;
-	return i;
+	unsigned Write = m_CommandWrite;
+	if(Write - m_CommandRead >= NUM_COMMANDS)
+		return false;
+
+	m_aCommands[Write%NUM_COMMANDS] = *pCommand;
+	sync_barrier(); // publish the command before the index
+	m_CommandWrite = Write+1;
+	return true;
+}
+
+static void StopVoice(CVoice *pVoice)
+{
+	if(pVoice->m_Flags & ISound::FLAG_LOOP)
+		pVoice->m_pSample->m_PausedAt = pVoice->m_Tick;
+	else
+		pVoice->m_pSample->m_PausedAt = 0;
+	pVoice->m_pSample = 0;
+}
+
+static void FreeVoice(CVoice *pVoice)
+{
+	// the game thread might already have reused the voice
+	atomic_compswap(&m_aVoiceSerials[pVoice-m_aVoices], pVoice->m_Serial, 0);
+	pVoice->m_pSample = 0;
+}
+
+static void ProcessCommands()
+{
+	unsigned Write = m_CommandWrite;
+	sync_barrier(); // read the index before the commands
+
+	for(unsigned Read = m_CommandRead; Read != Write; Read++)
+	{
+		const CVoiceCommand *pCommand = &m_aCommands[Read%NUM_COMMANDS];
+		if(pCommand->m_Cmd == CVoiceCommand::CMD_PLAY)
+		{
+			CVoice *pVoice = &m_aVoices[pCommand->m_Voice];
+			CSample *pSample = &m_aSamples[pCommand->m_Sample];
+			pVoice->m_pSample = pSample;
+			pVoice->m_pChannel = &m_aChannels[pCommand->m_Channel];
+			pVoice->m_Serial = pCommand->m_Serial;
+			if(pCommand->m_Flags & ISound::FLAG_LOOP)
+				pVoice->m_Tick = pSample->m_PausedAt;
+			else
+				pVoice->m_Tick = 0;
+			pVoice->m_Vol = 255;
+			pVoice->m_Flags = pCommand->m_Flags;
+			pVoice->m_X = pCommand->m_X;
+			pVoice->m_Y = pCommand->m_Y;
+		}
+		else if(pCommand->m_Cmd == CVoiceCommand::CMD_STOP)
+		{
+			CSample *pSample = &m_aSamples[pCommand->m_Sample];
+			for(int i = 0; i < NUM_VOICES; i++)
+			{
+				if(m_aVoices[i].m_pSample == pSample)
+					StopVoice(&m_aVoices[i]);
+			}
+		}
+		else if(pCommand->m_Cmd == CVoiceCommand::CMD_STOP_ALL)
+		{
+			for(int i = 0; i < NUM_VOICES; i++)
+			{
+				if(m_aVoices[i].m_pSample)
+					StopVoice(&m_aVoices[i]);
+			}
+		}
+	}
+
+	sync_barrier(); // finish reading before the slots can be reused
+	m_CommandRead = Write;
 }
 
 static void Mix(short *pFinalOut, unsigned Frames)
@@ -84,8 +193,8 @@ static void Mix(short *pFinalOut, unsigned Frames)
 	mem_zero(m_pMixBuffer, m_MaxFrames*2*sizeof(int));
 	Frames = min(Frames, m_MaxFrames);
 
-	// aquire lock while we are mixing
-	lock_wait(m_SoundLock);
+	// take over the changes from the game thread
+	ProcessCommands();
 
 	MasterVol = m_SoundVolume;
 
@@ -95,11 +204,6 @@ static void Mix(short *pFinalOut, unsigned Frames)
 		{
 			// mix voice
 			CVoice *v = &m_aVoices[i];
-			int *pOut = m_pMixBuffer;
-
-			int Step = v->m_pSample->m_Channels; // setup input sources
-			short *pInL = &v->m_pSample->m_pData[v->m_Tick*Step];
-			short *pInR = &v->m_pSample->m_pData[v->m_Tick*Step+1];
 
 			unsigned End = v->m_pSample->m_NumFrames-v->m_Tick;
 
@@ -110,10 +214,6 @@ static void Mix(short *pFinalOut, unsigned Frames)
 			if(Frames < End)
 				End = Frames;
 
-			// check if we have a mono sound
-			if(v->m_pSample->m_Channels == 1)
-				pInR = pInL;
-
 			// volume calculation
 			if(v->m_Flags&ISound::FLAG_POS)
 			{
@@ -130,15 +230,11 @@ static void Mix(short *pFinalOut, unsigned Frames)
 
 					// distribute volume to the channels depending on x difference
 					float Lpan = 0.5f - dx/m_MaxDistance/2.0f;
-					float Rpan = 1.0f - Lpan;
-
-					// apply square root to preserve sound power after panning
-					float LampFactor = sqrt(Lpan);
-					float RampFactor = sqrt(Rpan);
+					int PanIndex = clamp(round_to_int(Lpan*PAN_TABLE_SIZE), 0, (int)PAN_TABLE_SIZE);
 
 					// volume of the channels
-					Lvol = FalloffAmp*LampFactor;
-					Rvol = FalloffAmp*RampFactor;
+					Lvol = FalloffAmp*m_aPanTable[PanIndex];
+					Rvol = FalloffAmp*m_aPanTable[PAN_TABLE_SIZE-PanIndex];
 				}
 				else
 				{
@@ -147,15 +243,10 @@ static void Mix(short *pFinalOut, unsigned Frames)
 				}
 			}
 
-			// process all frames
-			for(unsigned s = 0; s < End; s++)
-			{
-				*pOut++ += (*pInL)*Lvol;
-				*pOut++ += (*pInR)*Rvol;
-				pInL += Step;
-				pInR += Step;
-				v->m_Tick++;
-			}
+			// process all frames, inaudible voices only advance
+			if(Lvol || Rvol)
+				SoundMixVoice(m_pMixBuffer, &v->m_pSample->m_pData[v->m_Tick*v->m_pSample->m_Channels], v->m_pSample->m_Channels, End, Lvol, Rvol);
+			v->m_Tick += End;
 
 			// free voice if not used any more
 			if(v->m_Tick == v->m_pSample->m_NumFrames)
@@ -163,27 +254,14 @@ static void Mix(short *pFinalOut, unsigned Frames)
 				if(v->m_Flags&ISound::FLAG_LOOP)
 					v->m_Tick = 0;
 				else
-					v->m_pSample = 0;
+					FreeVoice(v);
 			}
 		}
 	}
 
-
-	// release the lock
-	lock_unlock(m_SoundLock);
-
 	{
 		// clamp accumulated values
-		// TODO: this seams slow
-		for(unsigned i = 0; i < Frames; i++)
-		{
-			int j = i<<1;
-			int vl = ((m_pMixBuffer[j]*MasterVol)/101)>>8;
-			int vr = ((m_pMixBuffer[j+1]*MasterVol)/101)>>8;
-
-			pFinalOut[j] = Int2Short(vl);
-			pFinalOut[j+1] = Int2Short(vr);
-		}
+		SoundMixClamp(pFinalOut, m_pMixBuffer, Frames*2, MasterVol);
 	}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -208,38 +286,51 @@ int CSound::Init()
 
 	m_SoundLock = lock_create();
 
+	for(int i = 0; i <= PAN_TABLE_SIZE; i++)
+		m_aPanTable[i] = sqrtf(i/(float)PAN_TABLE_SIZE);
+
 	if(!g_Config.m_SndInit)
 		return 0;
 
-	if(SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
-	{
-		dbg_msg("gfx", "unable to init SDL audio: %s", SDL_GetError());
-		return -1;
-	}
-
 	m_MixingRate = g_Config.m_SndRate;
+	m_MaxFrames = g_Config.m_SndBufferSize*2;
 
-	// Set 16-bit stereo audio at 22Khz
-	Format.freq = g_Config.m_SndRate; // ignore_convention
-	Format.format = AUDIO_S16; // ignore_convention
-	Format.channels = 2; // ignore_convention
-	Format.samples = g_Config.m_SndBufferSize; // ignore_convention
-	Format.callback = SdlCallback; // ignore_convention
-	Format.userdata = NULL; // ignore_convention
-
-	// Open the audio device and start playing sound!
-	if(SDL_OpenAudio(&Format, NULL) < 0)
+	if(g_Config.m_SndNullDevice)
 	{
-		dbg_msg("client/sound", "unable to open audio: %s", SDL_GetError());
-		return -1;
+		m_pNullBuffer = (short *)mem_alloc(m_MaxFrames*2*sizeof(short), 1);
+		m_NullLastMix = time_get();
+		dbg_msg("client/sound", "using null device");
 	}
 	else
-		dbg_msg("client/sound", "sound init successful");
+	{
+		if(SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+		{
+			dbg_msg("gfx", "unable to init SDL audio: %s", SDL_GetError());
+			return -1;
+		}
+
+		// Set 16-bit stereo audio at 22Khz
+		Format.freq = g_Config.m_SndRate; // ignore_convention
+		Format.format = AUDIO_S16; // ignore_convention
+		Format.channels = 2; // ignore_convention
+		Format.samples = g_Config.m_SndBufferSize; // ignore_convention
+		Format.callback = SdlCallback; // ignore_convention
+		Format.userdata = NULL; // ignore_convention
+
+		// Open the audio device and start playing sound!
+		if(SDL_OpenAudio(&Format, NULL) < 0)
+		{
+			dbg_msg("client/sound", "unable to open audio: %s", SDL_GetError());
+			return -1;
+		}
+		else
+			dbg_msg("client/sound", "sound init successful");
+	}
 
-	m_MaxFrames = g_Config.m_SndBufferSize*2;
 	m_pMixBuffer = (int *)mem_alloc(m_MaxFrames*2*sizeof(int), 1);
 
-	SDL_PauseAudio(0);
+	if(!m_pNullBuffer)
+		SDL_PauseAudio(0);
 
 	m_SoundEnabled = 1;
 	Update(); // update the volume
@@ -255,10 +346,27 @@ int CSound::Update()
 		WantedVolume = 0;
 
 	if(WantedVolume != m_SoundVolume)
-	{
-		lock_wait(m_SoundLock);
 		m_SoundVolume = WantedVolume;
-		lock_unlock(m_SoundLock);
+
+	// the null device mixes the time that passed since the last update
+	if(m_pNullBuffer)
+	{
+		int64 Now = time_get();
+		int64 Frames = (Now-m_NullLastMix)*m_MixingRate/time_freq();
+		if(Frames > m_MixingRate)
+		{
+			// don't try to catch up after a long stall
+			Frames = m_MixingRate;
+			m_NullLastMix = Now;
+		}
+		else
+			m_NullLastMix += Frames*time_freq()/m_MixingRate;
+		while(Frames > 0)
+		{
+			unsigned Num = min((unsigned)Frames, m_MaxFrames);
+			Mix(m_pNullBuffer, Num);
+			Frames -= Num;
+		}
 	}
 
 	return 0;
@@ -266,8 +374,16 @@ int CSound::Update()
 
 int CSound::Shutdown()
 {
-	SDL_CloseAudio();
-	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	if(m_pNullBuffer)
+	{
+		mem_free(m_pNullBuffer);
+		m_pNullBuffer = 0;
+	}
+	else
+	{
+		SDL_CloseAudio();
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	}
 	lock_destroy(m_SoundLock);
 	if(m_pMixBuffer)
 	{
@@ -303,23 +419,7 @@ void CSound::RateConvert(int SampleID)
 	NumFrames = (int)((pSample->m_NumFrames/(float)pSample->m_Rate)*m_MixingRate);
 	pNewData = (short *)mem_alloc(NumFrames*pSample->m_Channels*sizeof(short), 1);
 
-	for(int i = 0; i < NumFrames; i++)
-	{
-		// resample TODO: this should be done better, like linear atleast
-		float a = i/(float)NumFrames;
-		int f = (int)(a*pSample->m_NumFrames);
-		if(f >= pSample->m_NumFrames)
-			f = pSample->m_NumFrames-1;
-
-		// set new data
-		if(pSample->m_Channels == 1)
-			pNewData[i] = pSample->m_pData[f];
-		else if(pSample->m_Channels == 2)
-		{
-			pNewData[i*2] = pSample->m_pData[f*2];
-			pNewData[i*2+1] = pSample->m_pData[f*2+1];
-		}
-	}
+	SoundResample(pNewData, NumFrames, pSample->m_pData, pSample->m_NumFrames, pSample->m_Channels);
 
 	// free old data and apply new
 	mem_free(pSample->m_pData);
@@ -466,13 +566,11 @@ int CSound::Play(int ChannelID, CSampleHandle SampleID, int Flags, float x, floa
 	int VoiceID = -1;
 	int i;
 
-	lock_wait(m_SoundLock);
-
 	// search for voice
 	for(i = 0; i < NUM_VOICES; i++)
 	{
 		int id = (m_NextVoice + i) % NUM_VOICES;
-		if(!m_aVoices[id].m_pSample)
+		if(!m_aVoiceSerials[id])
 		{
 			VoiceID = id;
 			m_NextVoice = id+1;
@@ -483,19 +581,28 @@ int CSound::Play(int ChannelID, CSampleHandle SampleID, int Flags, float x, floa
 	// voice found, use it
 	if(VoiceID != -1)
 	{
-		m_aVoices[VoiceID].m_pSample = &m_aSamples[SampleID.Id()];
-		m_aVoices[VoiceID].m_pChannel = &m_aChannels[ChannelID];
-		if(Flags & FLAG_LOOP)
-			m_aVoices[VoiceID].m_Tick = m_aSamples[SampleID.Id()].m_PausedAt;
-		else
-			m_aVoices[VoiceID].m_Tick = 0;
-		m_aVoices[VoiceID].m_Vol = 255;
-		m_aVoices[VoiceID].m_Flags = Flags;
-		m_aVoices[VoiceID].m_X = (int)x;
-		m_aVoices[VoiceID].m_Y = (int)y;
+		if(++m_NextSerial == 0)
+			m_NextSerial = 1;
+
+		CVoiceCommand Cmd;
+		Cmd.m_Cmd = CVoiceCommand::CMD_PLAY;
+		Cmd.m_Voice = VoiceID;
+		Cmd.m_Serial = m_NextSerial;
+		Cmd.m_Sample = SampleID.Id();
+		Cmd.m_Channel = ChannelID;
+		Cmd.m_Flags = Flags;
+		Cmd.m_X = (int)x;
+		Cmd.m_Y = (int)y;
+
+		m_aVoiceSerials[VoiceID] = m_NextSerial;
+		m_aVoiceSamples[VoiceID] = SampleID.Id();
+		if(!PushCommand(&Cmd))
+		{
+			m_aVoiceSerials[VoiceID] = 0;
+			VoiceID = -1;
+		}
 	}
 
-	lock_unlock(m_SoundLock);
 	return VoiceID;
 }
 
@@ -512,54 +619,39 @@ int CSound::Play(int ChannelID, CSampleHandle SampleID, int Flags)
 void CSound::Stop(CSampleHandle SampleID)
 {
 	// TODO: a nice fade out
-	lock_wait(m_SoundLock);
-	CSample *pSample = &m_aSamples[SampleID.Id()];
+	CVoiceCommand Cmd;
+	Cmd.m_Cmd = CVoiceCommand::CMD_STOP;
+	Cmd.m_Sample = SampleID.Id();
+	if(!PushCommand(&Cmd))
+		return;
+
 	for(int i = 0; i < NUM_VOICES; i++)
 	{
-		if(m_aVoices[i].m_pSample == pSample)
-		{
-			if(m_aVoices[i].m_Flags & FLAG_LOOP)
-				m_aVoices[i].m_pSample->m_PausedAt = m_aVoices[i].m_Tick;
-			else
-				m_aVoices[i].m_pSample->m_PausedAt = 0;
-			m_aVoices[i].m_pSample = 0;
-		}
+		if(m_aVoiceSerials[i] && m_aVoiceSamples[i] == SampleID.Id())
+			m_aVoiceSerials[i] = 0;
 	}
-	lock_unlock(m_SoundLock);
 }
 
 void CSound::StopAll()
 {
 	// TODO: a nice fade out
-	lock_wait(m_SoundLock);
+	CVoiceCommand Cmd;
+	Cmd.m_Cmd = CVoiceCommand::CMD_STOP_ALL;
+	if(!PushCommand(&Cmd))
+		return;
+
 	for(int i = 0; i < NUM_VOICES; i++)
-	{
-		if(m_aVoices[i].m_pSample)
-		{
-			if(m_aVoices[i].m_Flags & FLAG_LOOP)
-				m_aVoices[i].m_pSample->m_PausedAt = m_aVoices[i].m_Tick;
-			else
-				m_aVoices[i].m_pSample->m_PausedAt = 0;
-		}
-		m_aVoices[i].m_pSample = 0;
-	}
-	lock_unlock(m_SoundLock);
+		m_aVoiceSerials[i] = 0;
 }
 
 bool CSound::IsPlaying(CSampleHandle SampleID)
 {
-	bool Ret = false;
-	lock_wait(m_SoundLock);
-	CSample *pSample = &m_aSamples[SampleID.Id()];
 	for(int i = 0; i < NUM_VOICES; i++)
 	{
-		if(m_aVoices[i].m_pSample == pSample)
-		{
-			Ret = true;
-		}
+		if(m_aVoiceSerials[i] && m_aVoiceSamples[i] == SampleID.Id())
+			return true;
 	}
-	lock_unlock(m_SoundLock);
-	return Ret;
+	return false;
 }
 
 IOHANDLE CSound::ms_File = 0;
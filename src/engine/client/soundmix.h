@@ -0,0 +1,66 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_CLIENT_SOUNDMIX_H
+#define ENGINE_CLIENT_SOUNDMIX_H
+
+#include <base/math.h>
+#include <base/system.h>
+
+// the mixing kernels of the sound system, free of any device so they can
+// be run offline. the loops are kept free of branches so the compiler can
+// vectorize them
+
+// adds Frames frames of a voice to the interleaved stereo output
+inline void SoundMixVoice(int *pOut, const short *pIn, int Channels, unsigned Frames, int Lvol, int Rvol)
+{
+	if(Channels == 1)
+	{
+		for(unsigned s = 0; s < Frames; s++)
+		{
+			pOut[s*2] += pIn[s]*Lvol;
+			pOut[s*2+1] += pIn[s]*Rvol;
+		}
+	}
+	else
+	{
+		for(unsigned s = 0; s < Frames; s++)
+		{
+			pOut[s*2] += pIn[s*2]*Lvol;
+			pOut[s*2+1] += pIn[s*2+1]*Rvol;
+		}
+	}
+}
+
+// applies the master volume (0 - 100) and clamps the mixed values to 16 bit.
+// loud voices add up to more than 32 bits with the volume applied
+inline void SoundMixClamp(short *pOut, const int *pIn, unsigned Num, int MasterVol)
+{
+	for(unsigned i = 0; i < Num; i++)
+	{
+		int v = (int)((((int64)pIn[i]*MasterVol)/101)>>8);
+		pOut[i] = clamp(v, -0x7fff, 0x7fff);
+	}
+}
+
+// resamples with linear interpolation, the position is 16.16 fixed point.
+// the difference of two samples times the fraction takes more than 32 bits
+inline void SoundResample(short *pOut, int NumOutFrames, const short *pIn, int NumInFrames, int Channels)
+{
+	int64 Step = ((int64)NumInFrames<<16)/max(NumOutFrames, 1);
+	for(int i = 0; i < NumOutFrames; i++)
+	{
+		int64 Pos = i*Step;
+		int f = (int)(Pos>>16);
+		int64 Frac = Pos&0xffff;
+		int Next = min(f+1, NumInFrames-1);
+
+		for(int c = 0; c < Channels; c++)
+		{
+			int a = pIn[f*Channels+c];
+			int b = pIn[Next*Channels+c];
+			pOut[i*Channels+c] = a + (int)(((b-a)*Frac)>>16);
+		}
+	}
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <base/system.h>
 #include <base/math.h>
 #include <engine/graphics.h>
+#include <engine/storage.h>
 #include <engine/textrender.h>
 
 #ifdef CONF_FAMILY_WINDOWS
@@ -13,10 +14,27 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include <zlib.h>
+
 // TODO: Refactor: clean this up
 enum
 {
-	MAX_CHARACTERS = 64,
+	ATLAS_WIDTH = 1024,
+	ATLAS_MIN_HEIGHT = 256,
+	ATLAS_MAX_HEIGHT = 2048,
+
+	MAX_SHELVES = 512,
+	MAX_CHARACTERS = 1024*8,
+	CHARACTER_HASH_SIZE = 1024*4,
+	KERNING_CACHE_SIZE = 512,
+
+	MAX_LAYOUTS = 1024,
+	LAYOUT_HASH_SIZE = 1024,
+	MAX_LAYOUT_LENGTH = 512,
+
+	MAX_GLYPH_SIZE = 256,
+
+	ATLAS_CACHE_VERSION = 1,
 };
 
 
@@ -26,6 +44,7 @@ static int aFontSizes[] = {8,9,10,11,12,13,14,15,16,17,18,19,20,36,64};
 struct CFontChar
 {
 	int m_ID;
+	int m_SizeIndex;
 
 	// these values are scaled to the pFont size
 	// width * font_size == real_size
@@ -36,35 +55,79 @@ struct CFontChar
 	float m_AdvanceX;
 
 	float m_aUvs[4];
+
+	// placement in the atlas, in pixels
+	int m_AtlasX;
+	int m_AtlasY;
+	int m_AtlasWidth;
+	int m_AtlasHeight;
+	int m_Shelf;
+
+	int m_NextInHash;
+	int m_NextInShelf;
+};
+
+// glyphs are packed left to right into horizontal shelves of the atlas.
+// a shelf is the unit of eviction, the least recently used one goes first.
+struct CAtlasShelf
+{
+	int m_Y;
+	int m_Height;
+	int m_CurrentX;
+	int m_FirstChar;
 	int64 m_TouchTime;
 };
 
+struct CKerningEntry
+{
+	int m_Left;
+	int m_Right;
+	int m_Kerning;
+};
+
 struct CFontSizeData
 {
 	int m_FontSize;
-	FT_Face *m_pFace;
-
-	IGraphics::CTextureHandle m_aTextures[2];
-	int m_TextureWidth;
-	int m_TextureHeight;
-
-	int m_NumXChars;
-	int m_NumYChars;
-
-	int m_CharMaxWidth;
-	int m_CharMaxHeight;
-
-	CFontChar m_aCharacters[MAX_CHARACTERS*MAX_CHARACTERS];
-
-	int m_CurrentCharacter;
+	CKerningEntry m_aKerning[KERNING_CACHE_SIZE];
 };
 
 class CFont
 {
 public:
 	char m_aFilename[512];
+	unsigned m_FileCrc;
+	unsigned m_FileSize;
 	FT_Face m_FtFace;
+	int m_FtPixelSize;
 	CFontSizeData m_aSizes[NUM_FONT_SIZES];
+
+	// atlas shared by all sizes, the second page holds the outlines
+	IGraphics::CTextureHandle m_aTextures[2];
+	unsigned char *m_apAtlasData[2];
+	int m_AtlasHeight;
+	int m_AtlasGeneration;
+	bool m_AtlasChanged;
+
+	CAtlasShelf m_aShelves[MAX_SHELVES];
+	int m_NumShelves;
+
+	CFontChar m_aCharacters[MAX_CHARACTERS];
+	int m_FirstFreeCharacter;
+	int m_aCharacterHash[CHARACTER_HASH_SIZE];
+};
+
+// header of an atlas cache file in the user storage
+struct CAtlasCacheHeader
+{
+	char m_aID[4];
+	int m_Version;
+	unsigned m_FontCrc;
+	unsigned m_FontSize;
+	int m_AtlasHeight;
+	int m_UsedHeight;
+	int m_NumShelves;
+	int m_NumCharacters;
+	int m_aPageSizes[2];
 };
 
 struct CQuadChar
@@ -76,7 +139,9 @@ struct CQuadChar
 class CTextRender : public IEngineTextRender
 {
 	IGraphics *m_pGraphics;
+	IStorage *m_pStorage;
 	IGraphics *Graphics() { return m_pGraphics; }
+	IStorage *Storage() { return m_pStorage; }
 
 	int WordLength(const char *pText)
 	{
@@ -108,6 +173,9 @@ class CTextRender : public IEngineTextRender
 
 	FT_Library m_FTLibrary;
 
+	// time used to touch atlas shelves, sampled once per text call
+	int64 m_TouchTime;
+
 	int GetFontSizeIndex(int Pixelsize)
 	{
 		for(unsigned i = 0; i < NUM_FONT_SIZES; i++)
@@ -145,194 +213,321 @@ class CTextRender : public IEngineTextRender
 			}
 	}
 
-	void InitTexture(CFontSizeData *pSizeData, int CharWidth, int CharHeight, int Xchars, int Ychars)
+	int AdjustOutlineThicknessToFontSize(int OutlineThickness, int FontSize)
 	{
-		static int FontMemoryUsage = 0;
-		int Width = CharWidth*Xchars;
-		int Height = CharHeight*Ychars;
-		void *pMem = mem_alloc(Width*Height, 1);
-		mem_zero(pMem, Width*Height);
+		if(FontSize > 36)
+			OutlineThickness *= 4;
+		else if(FontSize >= 18)
+			OutlineThickness *= 2;
+		return OutlineThickness;
+	}
 
+	void UploadAtlas(CFont *pFont)
+	{
+		static int FontMemoryUsage = 0;
 		for(int i = 0; i < 2; i++)
 		{
-			if(pSizeData->m_aTextures[i].IsValid())
+			if(pFont->m_aTextures[i].IsValid())
 			{
-				Graphics()->UnloadTexture(&(pSizeData->m_aTextures[i]));
-				FontMemoryUsage -= pSizeData->m_TextureWidth*pSizeData->m_TextureHeight;
+				Graphics()->UnloadTexture(&(pFont->m_aTextures[i]));
+				FontMemoryUsage -= ATLAS_WIDTH*pFont->m_AtlasHeight;
 			}
 
-			pSizeData->m_aTextures[i] = Graphics()->LoadTextureRaw(Width, Height, CImageInfo::FORMAT_ALPHA, pMem, CImageInfo::FORMAT_ALPHA, IGraphics::TEXLOAD_NOMIPMAPS);
-			FontMemoryUsage += Width*Height;
+			pFont->m_aTextures[i] = Graphics()->LoadTextureRaw(ATLAS_WIDTH, pFont->m_AtlasHeight, CImageInfo::FORMAT_ALPHA, pFont->m_apAtlasData[i], CImageInfo::FORMAT_ALPHA, IGraphics::TEXLOAD_NOMIPMAPS);
+			FontMemoryUsage += ATLAS_WIDTH*pFont->m_AtlasHeight;
 		}
 
-		pSizeData->m_NumXChars = Xchars;
-		pSizeData->m_NumYChars = Ychars;
-		pSizeData->m_TextureWidth = Width;
-		pSizeData->m_TextureHeight = Height;
-		pSizeData->m_CurrentCharacter = 0;
-
-		dbg_msg("", "pFont memory usage: %d", FontMemoryUsage);
+		dbg_msg("textrender", "font memory usage: %d", FontMemoryUsage);
+	}
 
-		mem_free(pMem);
+	void UpdateUvs(CFont *pFont, CFontChar *pFontchr)
+	{
+		float Uscale = 1.0f/ATLAS_WIDTH;
+		float Vscale = 1.0f/pFont->m_AtlasHeight;
+		pFontchr->m_aUvs[0] = pFontchr->m_AtlasX * Uscale;
+		pFontchr->m_aUvs[1] = pFontchr->m_AtlasY * Vscale;
+		pFontchr->m_aUvs[2] = (pFontchr->m_AtlasX + pFontchr->m_AtlasWidth) * Uscale;
+		pFontchr->m_aUvs[3] = (pFontchr->m_AtlasY + pFontchr->m_AtlasHeight) * Vscale;
 	}
 
-	int AdjustOutlineThicknessToFontSize(int OutlineThickness, int FontSize)
+	int CharacterHash(int SizeIndex, int Chr)
 	{
-		if(FontSize > 36)
-			OutlineThickness *= 4;
-		else if(FontSize >= 18)
-			OutlineThickness *= 2;
-		return OutlineThickness;
+		return (Chr*(int)NUM_FONT_SIZES + SizeIndex)&(CHARACTER_HASH_SIZE-1);
 	}
 
-	void IncreaseTextureSize(CFontSizeData *pSizeData)
+	void ResetAtlas(CFont *pFont, int Height)
 	{
-		if(pSizeData->m_TextureWidth < pSizeData->m_TextureHeight)
-			pSizeData->m_NumXChars <<= 1;
-		else
-			pSizeData->m_NumYChars <<= 1;
-		InitTexture(pSizeData, pSizeData->m_CharMaxWidth, pSizeData->m_CharMaxHeight, pSizeData->m_NumXChars, pSizeData->m_NumYChars);
+		for(int i = 0; i < 2; i++)
+		{
+			if(pFont->m_apAtlasData[i])
+				mem_free(pFont->m_apAtlasData[i]);
+			pFont->m_apAtlasData[i] = (unsigned char *)mem_alloc(ATLAS_WIDTH*Height, 1);
+			mem_zero(pFont->m_apAtlasData[i], ATLAS_WIDTH*Height);
+		}
+		pFont->m_AtlasHeight = Height;
+		pFont->m_AtlasGeneration++;
+		pFont->m_NumShelves = 0;
+
+		for(int i = 0; i < MAX_CHARACTERS; i++)
+			pFont->m_aCharacters[i].m_NextInHash = i+1;
+		pFont->m_aCharacters[MAX_CHARACTERS-1].m_NextInHash = -1;
+		pFont->m_FirstFreeCharacter = 0;
+
+		for(int i = 0; i < CHARACTER_HASH_SIZE; i++)
+			pFont->m_aCharacterHash[i] = -1;
 	}
 
+	// doubles the atlas height up to the maximum, keeping all glyphs where they are
+	bool GrowAtlas(CFont *pFont)
+	{
+		if(pFont->m_AtlasHeight >= ATLAS_MAX_HEIGHT)
+			return false;
 
-	// TODO: Refactor: move this into a pFont class
-	void InitIndex(CFont *pFont, int Index)
+		int OldSize = ATLAS_WIDTH*pFont->m_AtlasHeight;
+		int NewHeight = min(pFont->m_AtlasHeight*2, (int)ATLAS_MAX_HEIGHT);
+		int NewSize = ATLAS_WIDTH*NewHeight;
+		for(int i = 0; i < 2; i++)
+		{
+			unsigned char *pData = (unsigned char *)mem_alloc(NewSize, 1);
+			mem_copy(pData, pFont->m_apAtlasData[i], OldSize);
+			mem_zero(pData+OldSize, NewSize-OldSize);
+			mem_free(pFont->m_apAtlasData[i]);
+			pFont->m_apAtlasData[i] = pData;
+		}
+		pFont->m_AtlasHeight = NewHeight;
+		pFont->m_AtlasGeneration++;
+
+		for(int s = 0; s < pFont->m_NumShelves; s++)
+			for(int c = pFont->m_aShelves[s].m_FirstChar; c != -1; c = pFont->m_aCharacters[c].m_NextInShelf)
+				UpdateUvs(pFont, &pFont->m_aCharacters[c]);
+
+		UploadAtlas(pFont);
+		return true;
+	}
+
+	void EvictShelf(CFont *pFont, int ShelfIndex)
 	{
-		CFontSizeData *pSizeData = &pFont->m_aSizes[Index];
+		CAtlasShelf *pShelf = &pFont->m_aShelves[ShelfIndex];
+		int c = pShelf->m_FirstChar;
+		while(c != -1)
+		{
+			CFontChar *pFontchr = &pFont->m_aCharacters[c];
+			int Next = pFontchr->m_NextInShelf;
 
-		pSizeData->m_FontSize = aFontSizes[Index];
-		FT_Set_Pixel_Sizes(pFont->m_FtFace, 0, pSizeData->m_FontSize);
+			// remove it from the hash
+			int *pLink = &pFont->m_aCharacterHash[CharacterHash(pFontchr->m_SizeIndex, pFontchr->m_ID)];
+			while(*pLink != c)
+				pLink = &pFont->m_aCharacters[*pLink].m_NextInHash;
+			*pLink = pFontchr->m_NextInHash;
 
-		int OutlineThickness = AdjustOutlineThicknessToFontSize(1, pSizeData->m_FontSize);
+			// insert to the free list
+			pFontchr->m_NextInHash = pFont->m_FirstFreeCharacter;
+			pFont->m_FirstFreeCharacter = c;
+
+			c = Next;
+		}
+
+		if(pShelf->m_FirstChar != -1)
+			pFont->m_AtlasGeneration++;
+		pShelf->m_FirstChar = -1;
+		pShelf->m_CurrentX = 0;
+	}
+
+	// least recently used shelf of at least MinHeight, with Used only ones that hold glyphs
+	int OldestShelf(CFont *pFont, int MinHeight, bool Used)
+	{
+		int Oldest = -1;
+		for(int i = 0; i < pFont->m_NumShelves; i++)
+		{
+			if(pFont->m_aShelves[i].m_Height >= MinHeight && (!Used || pFont->m_aShelves[i].m_FirstChar != -1) &&
+				(Oldest == -1 || pFont->m_aShelves[i].m_TouchTime < pFont->m_aShelves[Oldest].m_TouchTime))
+				Oldest = i;
+		}
+		return Oldest;
+	}
+
+	// finds room for a w*h glyph, returns the shelf index or -1
+	int AllocateRect(CFont *pFont, int Width, int Height)
+	{
+		// best fitting shelf that still has room, without wasting too much height
+		int Best = -1;
+		for(int i = 0; i < pFont->m_NumShelves; i++)
+		{
+			CAtlasShelf *pShelf = &pFont->m_aShelves[i];
+			if(pShelf->m_Height >= Height && pShelf->m_Height <= Height+Height/4+1 && pShelf->m_CurrentX+Width <= ATLAS_WIDTH &&
+				(Best == -1 || pShelf->m_Height < pFont->m_aShelves[Best].m_Height))
+				Best = i;
+		}
+		if(Best != -1)
+			return Best;
 
+		// open a new shelf
+		while(pFont->m_NumShelves < MAX_SHELVES)
 		{
-			unsigned GlyphIndex;
-			int MaxH = 0;
-			int MaxW = 0;
+			int Bottom = 0;
+			if(pFont->m_NumShelves)
+				Bottom = pFont->m_aShelves[pFont->m_NumShelves-1].m_Y + pFont->m_aShelves[pFont->m_NumShelves-1].m_Height;
 
-			int Charcode = FT_Get_First_Char(pFont->m_FtFace, &GlyphIndex);
-			while(GlyphIndex != 0)
+			if(Bottom+Height <= pFont->m_AtlasHeight)
 			{
-				// do stuff
-				FT_Load_Glyph(pFont->m_FtFace, GlyphIndex, FT_LOAD_DEFAULT);
-
-				if(pFont->m_FtFace->glyph->metrics.width > MaxW) MaxW = pFont->m_FtFace->glyph->metrics.width; // ignore_convention
-				if(pFont->m_FtFace->glyph->metrics.height > MaxH) MaxH = pFont->m_FtFace->glyph->metrics.height; // ignore_convention
-				Charcode = FT_Get_Next_Char(pFont->m_FtFace, Charcode, &GlyphIndex);
+				CAtlasShelf *pShelf = &pFont->m_aShelves[pFont->m_NumShelves];
+				pShelf->m_Y = Bottom;
+				pShelf->m_Height = Height;
+				pShelf->m_CurrentX = 0;
+				pShelf->m_FirstChar = -1;
+				pShelf->m_TouchTime = m_TouchTime;
+				return pFont->m_NumShelves++;
 			}
 
-			MaxW = (MaxW>>6)+2+OutlineThickness*2;
-			MaxH = (MaxH>>6)+2+OutlineThickness*2;
+			if(!GrowAtlas(pFont))
+				break;
+		}
 
-			for(pSizeData->m_CharMaxWidth = 1; pSizeData->m_CharMaxWidth < MaxW; pSizeData->m_CharMaxWidth <<= 1);
-			for(pSizeData->m_CharMaxHeight = 1; pSizeData->m_CharMaxHeight < MaxH; pSizeData->m_CharMaxHeight <<= 1);
+		// kick out the least recently used shelf that is high enough
+		int Oldest = OldestShelf(pFont, Height, false);
+		if(Oldest != -1)
+		{
+			EvictShelf(pFont, Oldest);
+			return Oldest;
 		}
 
-		//dbg_msg("pFont", "init size %d, texture size %d %d", pFont->sizes[index].font_size, w, h);
-		//FT_New_Face(m_FTLibrary, "data/fonts/vera.ttf", 0, &pFont->ft_face);
-		InitTexture(pSizeData, pSizeData->m_CharMaxWidth, pSizeData->m_CharMaxHeight, 8, 8);
+		// no shelf is high enough, merge the oldest one with its neighbours below
+		return MergeShelves(pFont, OldestShelf(pFont, 0, false), Height);
 	}
 
-	CFontSizeData *GetSize(CFont *pFont, int Pixelsize)
+	int MergeShelves(CFont *pFont, int First, int Height)
 	{
-		int Index = GetFontSizeIndex(Pixelsize);
-		if(pFont->m_aSizes[Index].m_FontSize != aFontSizes[Index])
-			InitIndex(pFont, Index);
-		return &pFont->m_aSizes[Index];
-	}
+		// find the range of shelves to merge
+		int Last = First;
+		int Top = pFont->m_aShelves[First].m_Y;
+		int Bottom = Top + pFont->m_aShelves[First].m_Height;
+		while(Bottom-Top < Height && Last+1 < pFont->m_NumShelves)
+		{
+			Last++;
+			Bottom = pFont->m_aShelves[Last].m_Y + pFont->m_aShelves[Last].m_Height;
+		}
+		if(Bottom-Top < Height)
+		{
+			// use the free space at the end of the atlas and take shelves above
+			Bottom = min(Top+Height, pFont->m_AtlasHeight);
+			while(Bottom-Top < Height)
+				Top = pFont->m_aShelves[--First].m_Y;
+		}
 
+		for(int i = First; i <= Last; i++)
+			EvictShelf(pFont, i);
 
-	void UploadGlyph(CFontSizeData *pSizeData, int Texnum, int SlotID, int Chr, const void *pData)
-	{
-		int x = (SlotID%pSizeData->m_NumXChars) * (pSizeData->m_TextureWidth/pSizeData->m_NumXChars);
-		int y = (SlotID/pSizeData->m_NumXChars) * (pSizeData->m_TextureHeight/pSizeData->m_NumYChars);
+		// remove the merged shelves
+		int Removed = Last-First;
+		pFont->m_aShelves[First].m_Height = Bottom-Top;
+		pFont->m_aShelves[First].m_TouchTime = m_TouchTime;
+		for(int i = Last+1; i < pFont->m_NumShelves; i++)
+		{
+			pFont->m_aShelves[i-Removed] = pFont->m_aShelves[i];
+			for(int c = pFont->m_aShelves[i].m_FirstChar; c != -1; c = pFont->m_aCharacters[c].m_NextInShelf)
+				pFont->m_aCharacters[c].m_Shelf = i-Removed;
+		}
+		pFont->m_NumShelves -= Removed;
 
-		Graphics()->LoadTextureRawSub(pSizeData->m_aTextures[Texnum], x, y,
-			pSizeData->m_TextureWidth/pSizeData->m_NumXChars,
-			pSizeData->m_TextureHeight/pSizeData->m_NumYChars,
-			CImageInfo::FORMAT_ALPHA, pData);
-		/*
-		glBindTexture(GL_TEXTURE_2D, pSizeData->m_aTextures[Texnum]);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y,
-			pSizeData->m_TextureWidth/pSizeData->m_NumXChars,
-			pSizeData->m_TextureHeight/pSizeData->m_NumYChars,
-			m_FontTextureFormat, GL_UNSIGNED_BYTE, pData);*/
+		return First;
 	}
 
-	// 32k of data used for rendering glyphs
-	unsigned char ms_aGlyphData[(1024/8) * (1024/8)];
-	unsigned char ms_aGlyphDataOutlined[(1024/8) * (1024/8)];
-
-	int GetSlot(CFontSizeData *pSizeData)
+	// TODO: Refactor: move this into a pFont class
+	void InitIndex(CFont *pFont, int Index)
 	{
-		int CharCount = pSizeData->m_NumXChars*pSizeData->m_NumYChars;
-		if(pSizeData->m_CurrentCharacter < CharCount)
+		CFontSizeData *pSizeData = &pFont->m_aSizes[Index];
+
+		pSizeData->m_FontSize = aFontSizes[Index];
+		for(int i = 0; i < KERNING_CACHE_SIZE; i++)
 		{
-			int i = pSizeData->m_CurrentCharacter;
-			pSizeData->m_CurrentCharacter++;
-			return i;
+			pSizeData->m_aKerning[i].m_Left = -1;
+			pSizeData->m_aKerning[i].m_Right = -1;
 		}
+	}
+
+	CFontSizeData *GetSize(CFont *pFont, int Pixelsize)
+	{
+		int Index = GetFontSizeIndex(Pixelsize);
+		if(pFont->m_aSizes[Index].m_FontSize != aFontSizes[Index])
+			InitIndex(pFont, Index);
+		return &pFont->m_aSizes[Index];
+	}
 
-		// kick out the oldest
-		// TODO: remove this linear search
+	void SetPixelSize(CFont *pFont, int Size)
+	{
+		if(pFont->m_FtPixelSize != Size)
 		{
-			int Oldest = 0;
-			for(int i = 1; i < CharCount; i++)
-			{
-				if(pSizeData->m_aCharacters[i].m_TouchTime < pSizeData->m_aCharacters[Oldest].m_TouchTime)
-					Oldest = i;
-			}
+			FT_Set_Pixel_Sizes(pFont->m_FtFace, 0, Size);
+			pFont->m_FtPixelSize = Size;
+		}
+	}
 
-			if(time_get()-pSizeData->m_aCharacters[Oldest].m_TouchTime < time_freq() &&
-				(pSizeData->m_NumXChars < MAX_CHARACTERS || pSizeData->m_NumYChars < MAX_CHARACTERS))
-			{
-				IncreaseTextureSize(pSizeData);
-				return GetSlot(pSizeData);
-			}
+	void UploadGlyph(CFont *pFont, int Texnum, int x, int y, int Width, int Height, const unsigned char *pData)
+	{
+		for(int py = 0; py < Height; py++)
+			mem_copy(&pFont->m_apAtlasData[Texnum][(y+py)*ATLAS_WIDTH+x], &pData[py*Width], Width);
 
-			return Oldest;
-		}
+		Graphics()->LoadTextureRawSub(pFont->m_aTextures[Texnum], x, y, Width, Height, CImageInfo::FORMAT_ALPHA, pData);
 	}
 
-	int RenderGlyph(CFont *pFont, CFontSizeData *pSizeData, int Chr)
+	// 128k of data used for rendering glyphs
+	unsigned char ms_aGlyphData[MAX_GLYPH_SIZE * MAX_GLYPH_SIZE];
+	unsigned char ms_aGlyphDataOutlined[MAX_GLYPH_SIZE * MAX_GLYPH_SIZE];
+
+	CFontChar *RenderGlyph(CFont *pFont, CFontSizeData *pSizeData, int SizeIndex, int Chr)
 	{
 		FT_Bitmap *pBitmap;
-		int SlotID = 0;
-		int SlotW = pSizeData->m_TextureWidth / pSizeData->m_NumXChars;
-		int SlotH = pSizeData->m_TextureHeight / pSizeData->m_NumYChars;
-		int SlotSize = SlotW*SlotH;
 		int x = 1;
 		int y = 1;
 		unsigned int px, py;
 
-		FT_Set_Pixel_Sizes(pFont->m_FtFace, 0, pSizeData->m_FontSize);
+		SetPixelSize(pFont, pSizeData->m_FontSize);
 
 		if(FT_Load_Char(pFont->m_FtFace, Chr, FT_LOAD_RENDER|FT_LOAD_NO_BITMAP))
 		{
 			dbg_msg("pFont", "error loading glyph %d", Chr);
-			return -1;
+			return 0;
 		}
 
 		pBitmap = &pFont->m_FtFace->glyph->bitmap; // ignore_convention
 
-		// fetch slot
-		SlotID = GetSlot(pSizeData);
-		if(SlotID < 0)
-			return -1;
-
 		// adjust spacing
 		int OutlineThickness = AdjustOutlineThicknessToFontSize(1, pSizeData->m_FontSize);
 		x += OutlineThickness;
 		y += OutlineThickness;
 
+		int Width = pBitmap->width + OutlineThickness*2 + 2; // ignore_convention
+		int Height = pBitmap->rows + OutlineThickness*2 + 2; // ignore_convention
+		if(Width > MAX_GLYPH_SIZE || Height > MAX_GLYPH_SIZE)
+		{
+			dbg_msg("pFont", "glyph %d is too large", Chr);
+			return 0;
+		}
+
+		// fetch a free character, preferably from a shelf the glyph fits into
+		while(pFont->m_FirstFreeCharacter == -1)
+		{
+			int Oldest = OldestShelf(pFont, Height, true);
+			if(Oldest == -1)
+				Oldest = OldestShelf(pFont, 0, true);
+			if(Oldest == -1)
+				return 0;
+			EvictShelf(pFont, Oldest);
+		}
+
+		// fetch room in the atlas
+		int ShelfIndex = AllocateRect(pFont, Width, Height);
+		if(pFont->m_FirstFreeCharacter == -1)
+			return 0;
+
 		// prepare glyph data
-		mem_zero(ms_aGlyphData, SlotSize);
+		mem_zero(ms_aGlyphData, Width*Height);
 
 		if(pBitmap->pixel_mode == FT_PIXEL_MODE_GRAY) // ignore_convention
 		{
 			for(py = 0; py < pBitmap->rows; py++) // ignore_convention
 				for(px = 0; px < pBitmap->width; px++) // ignore_convention
-					ms_aGlyphData[(py+y)*SlotW+px+x] = pBitmap->buffer[py*pBitmap->pitch+px]; // ignore_convention
+					ms_aGlyphData[(py+y)*Width+px+x] = pBitmap->buffer[py*pBitmap->pitch+px]; // ignore_convention
 		}
 		else if(pBitmap->pixel_mode == FT_PIXEL_MODE_MONO) // ignore_convention
 		{
@@ -340,85 +535,95 @@ class CTextRender : public IEngineTextRender
 				for(px = 0; px < pBitmap->width; px++) // ignore_convention
 				{
 					if(pBitmap->buffer[py*pBitmap->pitch+px/8]&(1<<(7-(px%8)))) // ignore_convention
-						ms_aGlyphData[(py+y)*SlotW+px+x] = 255;
+						ms_aGlyphData[(py+y)*Width+px+x] = 255;
 				}
 		}
 
-		/*for(py = 0; py < SlotW; py++)
-			for(px = 0; px < SlotH; px++)
-				ms_aGlyphData[py*SlotW+px] = 255;*/
-
 		// upload the glyph
-		UploadGlyph(pSizeData, 0, SlotID, Chr, ms_aGlyphData);
+		CAtlasShelf *pShelf = &pFont->m_aShelves[ShelfIndex];
+		int AtlasX = pShelf->m_CurrentX;
+		int AtlasY = pShelf->m_Y;
+		pShelf->m_CurrentX += Width;
+		pShelf->m_TouchTime = m_TouchTime;
+
+		UploadGlyph(pFont, 0, AtlasX, AtlasY, Width, Height, ms_aGlyphData);
 
 		if(OutlineThickness == 1)
 		{
-			Grow(ms_aGlyphData, ms_aGlyphDataOutlined, SlotW, SlotH);
-			UploadGlyph(pSizeData, 1, SlotID, Chr, ms_aGlyphDataOutlined);
+			Grow(ms_aGlyphData, ms_aGlyphDataOutlined, Width, Height);
+			UploadGlyph(pFont, 1, AtlasX, AtlasY, Width, Height, ms_aGlyphDataOutlined);
 		}
 		else
 		{
 			for(int i = OutlineThickness; i > 0; i-=2)
 			{
-				Grow(ms_aGlyphData, ms_aGlyphDataOutlined, SlotW, SlotH);
-				Grow(ms_aGlyphDataOutlined, ms_aGlyphData, SlotW, SlotH);
+				Grow(ms_aGlyphData, ms_aGlyphDataOutlined, Width, Height);
+				Grow(ms_aGlyphDataOutlined, ms_aGlyphData, Width, Height);
 			}
-			UploadGlyph(pSizeData, 1, SlotID, Chr, ms_aGlyphData);
+			UploadGlyph(pFont, 1, AtlasX, AtlasY, Width, Height, ms_aGlyphData);
 		}
 
+		pFont->m_AtlasChanged = true;
+
 		// set char info
+		int Index = pFont->m_FirstFreeCharacter;
+		CFontChar *pFontchr = &pFont->m_aCharacters[Index];
+		pFont->m_FirstFreeCharacter = pFontchr->m_NextInHash;
 		{
-			CFontChar *pFontchr = &pSizeData->m_aCharacters[SlotID];
 			float Scale = 1.0f/pSizeData->m_FontSize;
-			float Uscale = 1.0f/pSizeData->m_TextureWidth;
-			float Vscale = 1.0f/pSizeData->m_TextureHeight;
-			int Height = pBitmap->rows + OutlineThickness*2 + 2; // ignore_convention
-			int Width = pBitmap->width + OutlineThickness*2 + 2; // ignore_convention
 
 			pFontchr->m_ID = Chr;
+			pFontchr->m_SizeIndex = SizeIndex;
 			pFontchr->m_Height = Height * Scale;
 			pFontchr->m_Width = Width * Scale;
 			pFontchr->m_OffsetX = (pFont->m_FtFace->glyph->bitmap_left-1) * Scale; // ignore_convention
 			pFontchr->m_OffsetY = (pSizeData->m_FontSize - pFont->m_FtFace->glyph->bitmap_top) * Scale; // ignore_convention
 			pFontchr->m_AdvanceX = (pFont->m_FtFace->glyph->advance.x>>6) * Scale; // ignore_convention
 
-			pFontchr->m_aUvs[0] = (SlotID%pSizeData->m_NumXChars) / (float)(pSizeData->m_NumXChars);
-			pFontchr->m_aUvs[1] = (SlotID/pSizeData->m_NumXChars) / (float)(pSizeData->m_NumYChars);
-			pFontchr->m_aUvs[2] = pFontchr->m_aUvs[0] + Width*Uscale;
-			pFontchr->m_aUvs[3] = pFontchr->m_aUvs[1] + Height*Vscale;
+			pFontchr->m_AtlasX = AtlasX;
+			pFontchr->m_AtlasY = AtlasY;
+			pFontchr->m_AtlasWidth = Width;
+			pFontchr->m_AtlasHeight = Height;
+			UpdateUvs(pFont, pFontchr);
 		}
 
-		return SlotID;
+		LinkCharacter(pFont, Index, ShelfIndex);
+		return pFontchr;
+	}
+
+	void LinkCharacter(CFont *pFont, int Index, int ShelfIndex)
+	{
+		CFontChar *pFontchr = &pFont->m_aCharacters[Index];
+		int Hash = CharacterHash(pFontchr->m_SizeIndex, pFontchr->m_ID);
+		pFontchr->m_Shelf = ShelfIndex;
+		pFontchr->m_NextInHash = pFont->m_aCharacterHash[Hash];
+		pFont->m_aCharacterHash[Hash] = Index;
+		pFontchr->m_NextInShelf = pFont->m_aShelves[ShelfIndex].m_FirstChar;
+		pFont->m_aShelves[ShelfIndex].m_FirstChar = Index;
 	}
 
 	CFontChar *GetChar(CFont *pFont, CFontSizeData *pSizeData, int Chr)
 	{
 		CFontChar *pFontchr = NULL;
+		int SizeIndex = pSizeData - pFont->m_aSizes;
 
 		// search for the character
-		// TODO: remove this linear search
-		int i;
-		for(i = 0; i < pSizeData->m_CurrentCharacter; i++)
+		for(int i = pFont->m_aCharacterHash[CharacterHash(SizeIndex, Chr)]; i != -1; i = pFont->m_aCharacters[i].m_NextInHash)
 		{
-			if(pSizeData->m_aCharacters[i].m_ID == Chr)
+			if(pFont->m_aCharacters[i].m_ID == Chr && pFont->m_aCharacters[i].m_SizeIndex == SizeIndex)
 			{
-				pFontchr = &pSizeData->m_aCharacters[i];
+				pFontchr = &pFont->m_aCharacters[i];
 				break;
 			}
 		}
 
 		// check if we need to render the character
 		if(!pFontchr)
-		{
-			int Index = RenderGlyph(pFont, pSizeData, Chr);
-			if(Index >= 0)
-				pFontchr = &pSizeData->m_aCharacters[Index];
-		}
+			pFontchr = RenderGlyph(pFont, pSizeData, SizeIndex, Chr);
 
-		// touch the character
-		// TODO: don't call time_get here
+		// touch the shelf
 		if(pFontchr)
-			pFontchr->m_TouchTime = time_get();
+			pFont->m_aShelves[pFontchr->m_Shelf].m_TouchTime = m_TouchTime;
 
 		return pFontchr;
 	}
@@ -426,14 +631,599 @@ class CTextRender : public IEngineTextRender
 	// must only be called from the rendering function as the pFont must be set to the correct size
 	void RenderSetup(CFont *pFont, int size)
 	{
-		FT_Set_Pixel_Sizes(pFont->m_FtFace, 0, size);
+		SetPixelSize(pFont, size);
+		m_TouchTime = time_get();
+	}
+
+	float Kerning(CFont *pFont, CFontSizeData *pSizeData, int Left, int Right)
+	{
+		if(!FT_HAS_KERNING(pFont->m_FtFace))
+			return 0;
+
+		CKerningEntry *pEntry = &pSizeData->m_aKerning[((unsigned)Left*31 + (unsigned)Right)&(KERNING_CACHE_SIZE-1)];
+		if(pEntry->m_Left != Left || pEntry->m_Right != Right)
+		{
+			FT_Vector Kerning = {0,0};
+			FT_Get_Kerning(pFont->m_FtFace, Left, Right, FT_KERNING_DEFAULT, &Kerning);
+			pEntry->m_Left = Left;
+			pEntry->m_Right = Right;
+			pEntry->m_Kerning = Kerning.x>>6;
+		}
+		return pEntry->m_Kerning;
+	}
+
+	// screen aligned values shared by layouting and rendering
+	struct CTextSetup
+	{
+		CFont *m_pFont;
+		CFontSizeData *m_pSizeData;
+		int m_ActualSize;
+		float m_Size;
+		float m_FakeToScreenX;
+		float m_FakeToScreenY;
+		float m_CursorX;
+		float m_CursorY;
+		float m_LineStartX;
+	};
+
+	bool PrepareCursor(const CTextCursor *pCursor, CTextSetup *pSetup)
+	{
+		float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+
+		// to correct coords, convert to screen coords, round, and convert back
+		Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+		pSetup->m_FakeToScreenX = (Graphics()->ScreenWidth()/(ScreenX1-ScreenX0));
+		pSetup->m_FakeToScreenY = (Graphics()->ScreenHeight()/(ScreenY1-ScreenY0));
+		int ActualX = (int)(pCursor->m_X * pSetup->m_FakeToScreenX);
+		int ActualY = (int)(pCursor->m_Y * pSetup->m_FakeToScreenY);
+
+		pSetup->m_CursorX = ActualX / pSetup->m_FakeToScreenX;
+		pSetup->m_CursorY = ActualY / pSetup->m_FakeToScreenY;
+		pSetup->m_LineStartX = (int)(pCursor->m_StartX * pSetup->m_FakeToScreenX) / pSetup->m_FakeToScreenX;
+
+		// same with size
+		pSetup->m_ActualSize = (int)(pCursor->m_FontSize * pSetup->m_FakeToScreenY);
+		pSetup->m_Size = pSetup->m_ActualSize / pSetup->m_FakeToScreenY;
+
+		// fetch pFont data
+		pSetup->m_pFont = pCursor->m_pFont;
+		if(!pSetup->m_pFont)
+			pSetup->m_pFont = m_pDefaultFont;
+
+		if(!pSetup->m_pFont)
+			return false;
+
+		pSetup->m_pSizeData = GetSize(pSetup->m_pFont, pSetup->m_ActualSize);
+		RenderSetup(pSetup->m_pFont, pSetup->m_ActualSize);
+		return true;
+	}
+
+	// glyph quad of a layout. the position is relative to the cursor on the
+	// first line and relative to the aligned line start on the other lines
+	struct CLayoutQuad
+	{
+		float m_aUvs[4];
+		float m_X;
+		float m_Y;
+		float m_Width;
+		float m_Height;
+		int m_FirstLine;
+	};
+
+	// laid out text, cached by everything that influences the layout
+	struct CTextLayout
+	{
+		CFont *m_pFont;
+		int m_ActualSize;
+		float m_FakeToScreenX;
+		float m_FakeToScreenY;
+		float m_StartOffset;
+		float m_LineWidth;
+		int m_MaxLines;
+		int m_LineCount;
+		int m_Flags;
+		unsigned m_Hash;
+		int m_Length;
+		char *m_pText;
+
+		float m_EndX;
+		float m_EndY;
+		int m_EndFirstLine;
+		int m_GotNewLine;
+		int m_EndLineCount;
+		int m_GlyphCount;
+		int m_CharCount;
+		CLayoutQuad *m_pQuads;
+		int m_NumQuads;
+		int m_AtlasGeneration;
+
+		int m_NextInHash;
+		int m_PrevUsed;
+		int m_NextUsed;
+	};
+
+	CTextLayout m_aLayouts[MAX_LAYOUTS];
+	int m_aLayoutHash[LAYOUT_HASH_SIZE];
+	int m_FirstUsedLayout;
+	int m_LastUsedLayout;
+
+	// scratch buffer the glyph quads are collected in
+	CLayoutQuad *m_pLayoutQuads;
+	int m_NumLayoutQuads;
+	int m_LayoutQuadsCapacity;
+
+	unsigned LayoutHash(const CTextCursor *pCursor, const CTextSetup *pSetup, const char *pText, int Length)
+	{
+		unsigned Hash = 2166136261u;
+		for(int i = 0; i < Length; i++)
+			Hash = (Hash^(unsigned char)pText[i])*16777619u;
+		Hash ^= pSetup->m_ActualSize*31 + (int)pCursor->m_LineWidth;
+		return Hash;
+	}
+
+	bool MatchLayout(const CTextLayout *pLayout, const CTextCursor *pCursor, const CTextSetup *pSetup)
+	{
+		return pLayout->m_pFont == pSetup->m_pFont && pLayout->m_ActualSize == pSetup->m_ActualSize &&
+			pLayout->m_FakeToScreenX == pSetup->m_FakeToScreenX && pLayout->m_FakeToScreenY == pSetup->m_FakeToScreenY &&
+			pLayout->m_StartOffset == pSetup->m_CursorX-pCursor->m_StartX && pLayout->m_LineWidth == pCursor->m_LineWidth &&
+			pLayout->m_MaxLines == pCursor->m_MaxLines && pLayout->m_LineCount == pCursor->m_LineCount &&
+			pLayout->m_Flags == (pCursor->m_Flags&TEXTFLAG_STOP_AT_END);
+	}
+
+	void TouchLayout(int Index)
+	{
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		if(m_FirstUsedLayout == Index)
+			return;
+
+		// unlink
+		m_aLayouts[pLayout->m_PrevUsed].m_NextUsed = pLayout->m_NextUsed;
+		if(pLayout->m_NextUsed != -1)
+			m_aLayouts[pLayout->m_NextUsed].m_PrevUsed = pLayout->m_PrevUsed;
+		else
+			m_LastUsedLayout = pLayout->m_PrevUsed;
+
+		// insert at the front
+		pLayout->m_PrevUsed = -1;
+		pLayout->m_NextUsed = m_FirstUsedLayout;
+		m_aLayouts[m_FirstUsedLayout].m_PrevUsed = Index;
+		m_FirstUsedLayout = Index;
+	}
+
+	void FreeLayout(int Index)
+	{
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		if(!pLayout->m_pText)
+			return;
+
+		// remove it from the hash
+		int *pLink = &m_aLayoutHash[pLayout->m_Hash&(LAYOUT_HASH_SIZE-1)];
+		while(*pLink != Index)
+			pLink = &m_aLayouts[*pLink].m_NextInHash;
+		*pLink = pLayout->m_NextInHash;
+
+		mem_free(pLayout->m_pQuads);
+		pLayout->m_pText = 0;
+		pLayout->m_pQuads = 0;
+	}
+
+	CTextLayout *FindLayout(const CTextCursor *pCursor, const CTextSetup *pSetup, const char *pText, int Length)
+	{
+		if(Length > MAX_LAYOUT_LENGTH)
+			return 0;
+
+		unsigned Hash = LayoutHash(pCursor, pSetup, pText, Length);
+		for(int i = m_aLayoutHash[Hash&(LAYOUT_HASH_SIZE-1)]; i != -1; i = m_aLayouts[i].m_NextInHash)
+		{
+			CTextLayout *pLayout = &m_aLayouts[i];
+			if(pLayout->m_Hash == Hash && pLayout->m_Length == Length && MatchLayout(pLayout, pCursor, pSetup) &&
+				mem_comp(pLayout->m_pText, pText, Length) == 0)
+			{
+				// glyphs moved in the atlas, the layout has to be redone
+				if(pLayout->m_AtlasGeneration != pSetup->m_pFont->m_AtlasGeneration)
+				{
+					FreeLayout(i);
+					return 0;
+				}
+
+				TouchLayout(i);
+				return pLayout;
+			}
+		}
+		return 0;
+	}
+
+	CTextLayout *CreateLayout(const CTextCursor *pCursor, const CTextSetup *pSetup, const char *pText, int Length)
+	{
+		if(Length > MAX_LAYOUT_LENGTH)
+			return 0;
+
+		// lay out the text on a copy of the cursor. glyphs rendered on the way can
+		// evict ones placed before, then it's done again with all glyphs cached.
+		// if the atlas still changed the layout is stored as outdated
+		CTextCursor Cursor;
+		int AtlasGeneration;
+		int GotNewLine;
+		for(int Try = 0; Try < 2; Try++)
+		{
+			Cursor = *pCursor;
+			Cursor.m_GlyphCount = 0;
+			Cursor.m_CharCount = 0;
+			AtlasGeneration = pSetup->m_pFont->m_AtlasGeneration;
+			m_NumLayoutQuads = 0;
+			GotNewLine = LayoutText(&Cursor, pSetup, pText, Length, true);
+			if(AtlasGeneration == pSetup->m_pFont->m_AtlasGeneration)
+				break;
+		}
+
+		// reuse the least recently used layout
+		int Index = m_LastUsedLayout;
+		FreeLayout(Index);
+		TouchLayout(Index);
+
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		pLayout->m_pFont = pSetup->m_pFont;
+		pLayout->m_ActualSize = pSetup->m_ActualSize;
+		pLayout->m_FakeToScreenX = pSetup->m_FakeToScreenX;
+		pLayout->m_FakeToScreenY = pSetup->m_FakeToScreenY;
+		pLayout->m_StartOffset = pSetup->m_CursorX-pCursor->m_StartX;
+		pLayout->m_LineWidth = pCursor->m_LineWidth;
+		pLayout->m_MaxLines = pCursor->m_MaxLines;
+		pLayout->m_LineCount = pCursor->m_LineCount;
+		pLayout->m_Flags = pCursor->m_Flags&TEXTFLAG_STOP_AT_END;
+		pLayout->m_Hash = LayoutHash(pCursor, pSetup, pText, Length);
+		pLayout->m_Length = Length;
+
+		pLayout->m_EndFirstLine = Cursor.m_LineCount == pCursor->m_LineCount;
+		pLayout->m_EndX = Cursor.m_X - (pLayout->m_EndFirstLine ? pSetup->m_CursorX : pSetup->m_LineStartX);
+		pLayout->m_GotNewLine = GotNewLine;
+		pLayout->m_EndY = Cursor.m_Y - pSetup->m_CursorY;
+		pLayout->m_EndLineCount = Cursor.m_LineCount;
+		pLayout->m_GlyphCount = Cursor.m_GlyphCount;
+		pLayout->m_CharCount = Cursor.m_CharCount;
+		pLayout->m_NumQuads = m_NumLayoutQuads;
+		pLayout->m_AtlasGeneration = AtlasGeneration;
+
+		// text and quads share one allocation
+		int QuadsSize = m_NumLayoutQuads*sizeof(CLayoutQuad);
+		pLayout->m_pQuads = (CLayoutQuad *)mem_alloc(QuadsSize+Length+1, sizeof(float));
+		mem_copy(pLayout->m_pQuads, m_pLayoutQuads, QuadsSize);
+		pLayout->m_pText = (char *)pLayout->m_pQuads + QuadsSize;
+		mem_copy(pLayout->m_pText, pText, Length);
+		pLayout->m_pText[Length] = 0;
+
+		int Hash = pLayout->m_Hash&(LAYOUT_HASH_SIZE-1);
+		pLayout->m_NextInHash = m_aLayoutHash[Hash];
+		m_aLayoutHash[Hash] = Index;
+		return pLayout;
+	}
+
+	void ApplyLayout(CTextCursor *pCursor, const CTextSetup *pSetup, const CTextLayout *pLayout)
+	{
+		pCursor->m_X = pLayout->m_EndX + (pLayout->m_EndFirstLine ? pSetup->m_CursorX : pSetup->m_LineStartX);
+		if(pLayout->m_GotNewLine)
+			pCursor->m_Y = pLayout->m_EndY + pSetup->m_CursorY;
+		pCursor->m_LineCount = pLayout->m_EndLineCount;
+		pCursor->m_GlyphCount += pLayout->m_GlyphCount;
+		pCursor->m_CharCount += pLayout->m_CharCount;
+	}
+
+	void AddLayoutQuad(const CTextSetup *pSetup, const CFontChar *pChr, float x, float y, float w, float h, bool FirstLine)
+	{
+		if(m_NumLayoutQuads == m_LayoutQuadsCapacity)
+		{
+			int Capacity = max(m_LayoutQuadsCapacity*2, 256);
+			CLayoutQuad *pQuads = (CLayoutQuad *)mem_alloc(Capacity*sizeof(CLayoutQuad), sizeof(float));
+			if(m_pLayoutQuads)
+			{
+				mem_copy(pQuads, m_pLayoutQuads, m_NumLayoutQuads*sizeof(CLayoutQuad));
+				mem_free(m_pLayoutQuads);
+			}
+			m_pLayoutQuads = pQuads;
+			m_LayoutQuadsCapacity = Capacity;
+		}
+
+		CLayoutQuad *pQuad = &m_pLayoutQuads[m_NumLayoutQuads++];
+		mem_copy(pQuad->m_aUvs, pChr->m_aUvs, sizeof(pQuad->m_aUvs));
+		pQuad->m_X = x - (FirstLine ? pSetup->m_CursorX : pSetup->m_LineStartX);
+		pQuad->m_Y = y - pSetup->m_CursorY;
+		pQuad->m_Width = w;
+		pQuad->m_Height = h;
+		pQuad->m_FirstLine = FirstLine;
+	}
+
+	void RenderQuads(const CTextSetup *pSetup, const CLayoutQuad *pQuads, int NumQuads)
+	{
+		for(int i = 0; i < 2; i++)
+		{
+			// TODO: Make this better
+			if (i == 0)
+				Graphics()->TextureSet(pSetup->m_pFont->m_aTextures[1]);
+			else
+				Graphics()->TextureSet(pSetup->m_pFont->m_aTextures[0]);
+
+			Graphics()->QuadsBegin();
+			if (i == 0)
+				Graphics()->SetColor(m_TextOutlineR, m_TextOutlineG, m_TextOutlineB, m_TextOutlineA*m_TextA);
+			else
+				Graphics()->SetColor(m_TextR, m_TextG, m_TextB, m_TextA);
+
+			for(int q = 0; q < NumQuads; q++)
+			{
+				const CLayoutQuad *pQuad = &pQuads[q];
+				Graphics()->QuadsSetSubset(pQuad->m_aUvs[0], pQuad->m_aUvs[1], pQuad->m_aUvs[2], pQuad->m_aUvs[3]);
+				IGraphics::CQuadItem QuadItem(pQuad->m_X + (pQuad->m_FirstLine ? pSetup->m_CursorX : pSetup->m_LineStartX),
+					pQuad->m_Y + pSetup->m_CursorY, pQuad->m_Width, pQuad->m_Height);
+				Graphics()->QuadsDrawTL(&QuadItem, 1);
+			}
+
+			Graphics()->QuadsEnd();
+		}
+	}
+
+	// runs the layout for the cursor and advances it, collecting the glyph quads if wanted.
+	// returns whether the text was wrapped
+	int LayoutText(CTextCursor *pCursor, const CTextSetup *pSetup, const char *pText, int Length, bool CollectQuads)
+	{
+		CFont *pFont = pSetup->m_pFont;
+		CFontSizeData *pSizeData = pSetup->m_pSizeData;
+		float FakeToScreenX = pSetup->m_FakeToScreenX;
+		float FakeToScreenY = pSetup->m_FakeToScreenY;
+		float Size = pSetup->m_Size;
+		float Scale = 1.0f/pSizeData->m_FontSize;
+
+		int GotNewLine = 0;
+		const char *pCurrent = (char *)pText;
+		const char *pEnd = pCurrent+Length;
+		float DrawX = pSetup->m_CursorX;
+		float DrawY = pSetup->m_CursorY;
+		int StartLineCount = pCursor->m_LineCount;
+		int LineCount = pCursor->m_LineCount;
+
+		while(pCurrent < pEnd && (pCursor->m_MaxLines < 1 || LineCount <= pCursor->m_MaxLines))
+		{
+			int NewLine = 0;
+			const char *pBatchEnd = pEnd;
+			if(pCursor->m_LineWidth > 0 && !(pCursor->m_Flags&TEXTFLAG_STOP_AT_END))
+			{
+				int Wlen = min(WordLength((char *)pCurrent), (int)(pEnd-pCurrent));
+				CTextCursor Compare = *pCursor;
+				Compare.m_X = DrawX;
+				Compare.m_Y = DrawY;
+				Compare.m_Flags &= ~TEXTFLAG_RENDER;
+				Compare.m_LineWidth = -1;
+				MeasureText(&Compare, pCurrent, Wlen);
+
+				if(Compare.m_X-DrawX > pCursor->m_LineWidth)
+				{
+					// word can't be fitted in one line, cut it
+					CTextCursor Cutter = *pCursor;
+					Cutter.m_GlyphCount = 0;
+					Cutter.m_X = DrawX;
+					Cutter.m_Y = DrawY;
+					Cutter.m_Flags &= ~TEXTFLAG_RENDER;
+					Cutter.m_Flags |= TEXTFLAG_STOP_AT_END;
+
+					MeasureText(&Cutter, (const char *)pCurrent, Wlen);
+					Wlen = Cutter.m_GlyphCount;
+					NewLine = 1;
+
+					if(Wlen <= 3) // if we can't place 3 chars of the word on this line, take the next
+						Wlen = 0;
+				}
+				else if(Compare.m_X-pCursor->m_StartX > pCursor->m_LineWidth)
+				{
+					NewLine = 1;
+					Wlen = 0;
+				}
+
+				pBatchEnd = pCurrent + Wlen;
+			}
+
+			const char *pTmp = pCurrent;
+			int NextCharacter = str_utf8_decode(&pTmp);
+			while(pCurrent < pBatchEnd)
+			{
+				pCursor->m_CharCount += pTmp-pCurrent;
+				int Character = NextCharacter;
+				pCurrent = pTmp;
+				NextCharacter = str_utf8_decode(&pTmp);
+
+				if(Character == '\n')
+				{
+					DrawX = pCursor->m_StartX;
+					DrawY += Size;
+					DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
+					DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
+					++LineCount;
+					if(pCursor->m_MaxLines > 0 && LineCount > pCursor->m_MaxLines)
+						break;
+					continue;
+				}
+
+				CFontChar *pChr = GetChar(pFont, pSizeData, Character);
+				if(pChr)
+				{
+					float Advance = pChr->m_AdvanceX + Kerning(pFont, pSizeData, Character, NextCharacter)*Scale;
+					if(pCursor->m_Flags&TEXTFLAG_STOP_AT_END && DrawX+Advance*Size-pCursor->m_StartX > pCursor->m_LineWidth)
+					{
+						// we hit the end of the line, no more to render or count
+						pCurrent = pEnd;
+						break;
+					}
+
+					if(CollectQuads)
+						AddLayoutQuad(pSetup, pChr, DrawX+pChr->m_OffsetX*Size, DrawY+pChr->m_OffsetY*Size, pChr->m_Width*Size, pChr->m_Height*Size, LineCount == StartLineCount);
+
+					DrawX += Advance*Size;
+					pCursor->m_GlyphCount++;
+				}
+			}
+
+			if(NewLine)
+			{
+				DrawX = pCursor->m_StartX;
+				DrawY += Size;
+				GotNewLine = 1;
+				DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
+				DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
+				++LineCount;
+			}
+		}
+
+		pCursor->m_X = DrawX;
+		pCursor->m_LineCount = LineCount;
+
+		if(GotNewLine)
+			pCursor->m_Y = DrawY;
+		return GotNewLine;
+	}
+
+	// uncached layout without rendering, used for measuring words
+	void MeasureText(CTextCursor *pCursor, const char *pText, int Length)
+	{
+		CTextSetup Setup;
+		if(PrepareCursor(pCursor, &Setup))
+			LayoutText(pCursor, &Setup, pText, Length, false);
+	}
+
+	void AtlasCacheFilename(CFont *pFont, char *pBuffer, int BufferSize)
+	{
+		str_format(pBuffer, BufferSize, "fontcache/%08x_%u.atlas", pFont->m_FileCrc, pFont->m_FileSize);
+	}
+
+	bool LoadAtlasCache(CFont *pFont)
+	{
+		char aFilename[128];
+		AtlasCacheFilename(pFont, aFilename, sizeof(aFilename));
+		IOHANDLE File = Storage()->OpenFile(aFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+		if(!File)
+			return false;
+
+		CAtlasCacheHeader Header;
+		bool Valid = io_read(File, &Header, sizeof(Header)) == sizeof(Header) &&
+			mem_comp(Header.m_aID, "TWFA", sizeof(Header.m_aID)) == 0 && Header.m_Version == ATLAS_CACHE_VERSION &&
+			Header.m_FontCrc == pFont->m_FileCrc && Header.m_FontSize == pFont->m_FileSize &&
+			Header.m_AtlasHeight >= ATLAS_MIN_HEIGHT && Header.m_AtlasHeight <= ATLAS_MAX_HEIGHT &&
+			(Header.m_AtlasHeight&(Header.m_AtlasHeight-1)) == 0 && // grown by doubling from the minimum
+			Header.m_UsedHeight >= 0 && Header.m_UsedHeight <= Header.m_AtlasHeight &&
+			Header.m_NumShelves >= 0 && Header.m_NumShelves <= MAX_SHELVES &&
+			Header.m_NumCharacters >= 0 && Header.m_NumCharacters <= MAX_CHARACTERS &&
+			Header.m_aPageSizes[0] > 0 && Header.m_aPageSizes[1] > 0;
+		if(!Valid)
+		{
+			io_close(File);
+			return false;
+		}
+
+		ResetAtlas(pFont, Header.m_AtlasHeight);
+
+		// restore the pages
+		unsigned long UsedSize = ATLAS_WIDTH*Header.m_UsedHeight;
+		for(int i = 0; i < 2 && Valid; i++)
+		{
+			void *pCompressed = mem_alloc(Header.m_aPageSizes[i], 1);
+			unsigned long Size = UsedSize;
+			Valid = io_read(File, pCompressed, Header.m_aPageSizes[i]) == (unsigned)Header.m_aPageSizes[i] &&
+				uncompress(pFont->m_apAtlasData[i], &Size, (Bytef *)pCompressed, Header.m_aPageSizes[i]) == Z_OK && Size == UsedSize; // ignore_convention
+			mem_free(pCompressed);
+		}
+
+		// restore shelves and characters
+		if(Valid)
+			Valid = io_read(File, pFont->m_aShelves, sizeof(CAtlasShelf)*Header.m_NumShelves) == sizeof(CAtlasShelf)*Header.m_NumShelves;
+		pFont->m_NumShelves = Header.m_NumShelves;
+		for(int i = 0; i < pFont->m_NumShelves; i++)
+		{
+			pFont->m_aShelves[i].m_FirstChar = -1;
+			pFont->m_aShelves[i].m_TouchTime = 0;
+			if(pFont->m_aShelves[i].m_Y < 0 || pFont->m_aShelves[i].m_Height <= 0 || pFont->m_aShelves[i].m_Y+pFont->m_aShelves[i].m_Height > Header.m_UsedHeight)
+				Valid = false;
+		}
+
+		for(int i = 0; i < Header.m_NumCharacters && Valid; i++)
+		{
+			int Index = pFont->m_FirstFreeCharacter;
+			CFontChar *pFontchr = &pFont->m_aCharacters[Index];
+			pFont->m_FirstFreeCharacter = pFontchr->m_NextInHash;
+			Valid = io_read(File, pFontchr, sizeof(CFontChar)) == sizeof(CFontChar) &&
+				pFontchr->m_SizeIndex >= 0 && pFontchr->m_SizeIndex < (int)NUM_FONT_SIZES &&
+				pFontchr->m_Shelf >= 0 && pFontchr->m_Shelf < pFont->m_NumShelves &&
+				pFontchr->m_AtlasX >= 0 && pFontchr->m_AtlasX+pFontchr->m_AtlasWidth <= ATLAS_WIDTH &&
+				pFontchr->m_AtlasY >= 0 && pFontchr->m_AtlasY+pFontchr->m_AtlasHeight <= Header.m_UsedHeight;
+			if(Valid)
+			{
+				UpdateUvs(pFont, pFontchr);
+				LinkCharacter(pFont, Index, pFontchr->m_Shelf);
+			}
+		}
+		io_close(File);
+
+		if(!Valid)
+		{
+			dbg_msg("textrender", "invalid font atlas cache '%s'", aFilename);
+			ResetAtlas(pFont, ATLAS_MIN_HEIGHT);
+			return false;
+		}
+
+		dbg_msg("textrender", "loaded %d glyphs from font atlas cache", Header.m_NumCharacters);
+		return true;
 	}
 
-	float Kerning(CFont *pFont, int Left, int Right)
+	void SaveAtlasCache(CFont *pFont)
 	{
-		FT_Vector Kerning = {0,0};
-		FT_Get_Kerning(pFont->m_FtFace, Left, Right, FT_KERNING_DEFAULT, &Kerning);
-		return (Kerning.x>>6);
+		if(!pFont->m_AtlasChanged || !pFont->m_NumShelves)
+			return;
+
+		char aFilename[128];
+		AtlasCacheFilename(pFont, aFilename, sizeof(aFilename));
+		Storage()->CreateFolder("fontcache", IStorage::TYPE_SAVE);
+		IOHANDLE File = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(!File)
+			return;
+
+		CAtlasCacheHeader Header;
+		mem_copy(Header.m_aID, "TWFA", sizeof(Header.m_aID));
+		Header.m_Version = ATLAS_CACHE_VERSION;
+		Header.m_FontCrc = pFont->m_FileCrc;
+		Header.m_FontSize = pFont->m_FileSize;
+		Header.m_AtlasHeight = pFont->m_AtlasHeight;
+		Header.m_UsedHeight = 0;
+		if(pFont->m_NumShelves)
+			Header.m_UsedHeight = pFont->m_aShelves[pFont->m_NumShelves-1].m_Y + pFont->m_aShelves[pFont->m_NumShelves-1].m_Height;
+		Header.m_NumShelves = pFont->m_NumShelves;
+		Header.m_NumCharacters = 0;
+		for(int s = 0; s < pFont->m_NumShelves; s++)
+			for(int c = pFont->m_aShelves[s].m_FirstChar; c != -1; c = pFont->m_aCharacters[c].m_NextInShelf)
+				Header.m_NumCharacters++;
+
+		// compress the used part of the pages
+		unsigned long UsedSize = ATLAS_WIDTH*Header.m_UsedHeight;
+		unsigned long MaxCompressedSize = compressBound(UsedSize);
+		void *apCompressed[2];
+		for(int i = 0; i < 2; i++)
+		{
+			unsigned long Size = MaxCompressedSize;
+			apCompressed[i] = mem_alloc(MaxCompressedSize, 1);
+			compress((Bytef *)apCompressed[i], &Size, pFont->m_apAtlasData[i], UsedSize); // ignore_convention
+			Header.m_aPageSizes[i] = Size;
+		}
+
+		io_write(File, &Header, sizeof(Header));
+		for(int i = 0; i < 2; i++)
+		{
+			io_write(File, apCompressed[i], Header.m_aPageSizes[i]);
+			mem_free(apCompressed[i]);
+		}
+		io_write(File, pFont->m_aShelves, sizeof(CAtlasShelf)*pFont->m_NumShelves);
+		for(int s = 0; s < pFont->m_NumShelves; s++)
+			for(int c = pFont->m_aShelves[s].m_FirstChar; c != -1; c = pFont->m_aCharacters[c].m_NextInShelf)
+				io_write(File, &pFont->m_aCharacters[c], sizeof(CFontChar));
+		io_close(File);
+
+		pFont->m_AtlasChanged = false;
+		dbg_msg("textrender", "saved %d glyphs to font atlas cache", Header.m_NumCharacters);
 	}
 
 
@@ -441,6 +1231,7 @@ public:
 	CTextRender()
 	{
 		m_pGraphics = 0;
+		m_pStorage = 0;
 
 		m_TextR = 1.0f;
 		m_TextG = 1.0f;
@@ -452,6 +1243,25 @@ public:
 		m_TextOutlineA = 0.3f;
 
 		m_pDefaultFont = 0;
+		m_TouchTime = 0;
+
+		// all layouts start out free, linked in the lru list
+		for(int i = 0; i < MAX_LAYOUTS; i++)
+		{
+			m_aLayouts[i].m_pText = 0;
+			m_aLayouts[i].m_pQuads = 0;
+			m_aLayouts[i].m_PrevUsed = i-1;
+			m_aLayouts[i].m_NextUsed = i+1;
+		}
+		m_aLayouts[MAX_LAYOUTS-1].m_NextUsed = -1;
+		m_FirstUsedLayout = 0;
+		m_LastUsedLayout = MAX_LAYOUTS-1;
+		for(int i = 0; i < LAYOUT_HASH_SIZE; i++)
+			m_aLayoutHash[i] = -1;
+
+		m_pLayoutQuads = 0;
+		m_NumLayoutQuads = 0;
+		m_LayoutQuadsCapacity = 0;
 
 		// GL_LUMINANCE can be good for debugging
 		//m_FontTextureFormat = GL_ALPHA;
@@ -460,9 +1270,16 @@ public:
 	virtual void Init()
 	{
 		m_pGraphics = Kernel()->RequestInterface<IGraphics>();
+		m_pStorage = Kernel()->RequestInterface<IStorage>();
 		FT_Init_FreeType(&m_FTLibrary);
 	}
 
+	virtual void Shutdown()
+	{
+		if(m_pDefaultFont)
+			SaveAtlasCache(m_pDefaultFont);
+	}
+
 
 	virtual int LoadFont(const char *pFilename)
 	{
@@ -479,6 +1296,33 @@ public:
 
 		for(unsigned i = 0; i < NUM_FONT_SIZES; i++)
 			pFont->m_aSizes[i].m_FontSize = -1;
+		pFont->m_FtPixelSize = -1;
+
+		// identify the font file, so a cached atlas can be reused
+		IOHANDLE File = io_open(pFont->m_aFilename, IOFLAG_READ);
+		if(File)
+		{
+			unsigned char aBuffer[64*1024];
+			unsigned Crc = crc32(0L, 0x0, 0);
+			unsigned Size = 0;
+			while(1)
+			{
+				unsigned Bytes = io_read(File, aBuffer, sizeof(aBuffer));
+				if(Bytes <= 0)
+					break;
+				Crc = crc32(Crc, aBuffer, Bytes); // ignore_convention
+				Size += Bytes;
+			}
+			io_close(File);
+			pFont->m_FileCrc = Crc;
+			pFont->m_FileSize = Size;
+		}
+
+		pFont->m_aTextures[0].Invalidate();
+		pFont->m_aTextures[1].Invalidate();
+		if(!LoadAtlasCache(pFont))
+			ResetAtlas(pFont, ATLAS_MIN_HEIGHT);
+		UploadAtlas(pFont);
 
 		dbg_msg("textrender", "loaded pFont from '%s'", pFilename);
 		m_pDefaultFont = pFont;
@@ -639,7 +1483,7 @@ public:
 
 		pSizeData = GetSize(pFont, ActualSize);
 		RenderSetup(pFont, ActualSize);
-		*pFontTexture = pSizeData->m_aTextures[0];
+		*pFontTexture = pFont->m_aTextures[0];
 
 		float Scale = 1.0f/pSizeData->m_FontSize;
 
@@ -720,7 +1564,7 @@ public:
 				CFontChar *pChr = GetChar(pFont, pSizeData, Character);
 				if(pChr)
 				{
-					float Advance = pChr->m_AdvanceX + Kerning(pFont, Character, NextCharacter)*Scale;
+					float Advance = pChr->m_AdvanceX + Kerning(pFont, pSizeData, Character, NextCharacter)*Scale;
 					if(pCursor->m_Flags&TEXTFLAG_STOP_AT_END && DrawX+Advance*Size-pCursor->m_StartX > pCursor->m_LineWidth)
 					{
 						// we hit the end of the line, no more to render or count
@@ -768,187 +1612,32 @@ public:
 
 	virtual void TextEx(CTextCursor *pCursor, const char *pText, int Length)
 	{
-		CFont *pFont = pCursor->m_pFont;
-		CFontSizeData *pSizeData = NULL;
-
-		//dbg_msg("textrender", "rendering text '%s'", text);
-
-		float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
-		float FakeToScreenX, FakeToScreenY;
-		int ActualX, ActualY;
-
-		int ActualSize;
-		int i;
-		int GotNewLine = 0;
-		float DrawX = 0.0f, DrawY = 0.0f;
-		int LineCount = 0;
-		float CursorX, CursorY;
-
-		float Size = pCursor->m_FontSize;
-
-		// to correct coords, convert to screen coords, round, and convert back
-		Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
-
-		FakeToScreenX = (Graphics()->ScreenWidth()/(ScreenX1-ScreenX0));
-		FakeToScreenY = (Graphics()->ScreenHeight()/(ScreenY1-ScreenY0));
-		ActualX = (int)(pCursor->m_X * FakeToScreenX);
-		ActualY = (int)(pCursor->m_Y * FakeToScreenY);
-
-		CursorX = ActualX / FakeToScreenX;
-		CursorY = ActualY / FakeToScreenY;
-
-		// same with size
-		ActualSize = (int)(Size * FakeToScreenY);
-		Size = ActualSize / FakeToScreenY;
-
-		// fetch pFont data
-		if(!pFont)
-			pFont = m_pDefaultFont;
-
-		if(!pFont)
+		CTextSetup Setup;
+		if(!PrepareCursor(pCursor, &Setup))
 			return;
 
-		pSizeData = GetSize(pFont, ActualSize);
-		RenderSetup(pFont, ActualSize);
-
-		float Scale = 1.0f/pSizeData->m_FontSize;
-
 		// set length
 		if(Length < 0)
 			Length = str_length(pText);
 
-		// if we don't want to render, we can just skip the first outline pass
-		i = 1;
-		if(pCursor->m_Flags&TEXTFLAG_RENDER)
-			i = 0;
+		const CTextLayout *pLayout = FindLayout(pCursor, &Setup, pText, Length);
+		if(!pLayout)
+			pLayout = CreateLayout(pCursor, &Setup, pText, Length);
 
-		for(;i < 2; i++)
+		if(pLayout)
 		{
-			const char *pCurrent = (char *)pText;
-			const char *pEnd = pCurrent+Length;
-			DrawX = CursorX;
-			DrawY = CursorY;
-			LineCount = pCursor->m_LineCount;
-
 			if(pCursor->m_Flags&TEXTFLAG_RENDER)
-			{
-				// TODO: Make this better
-				if (i == 0)
-					Graphics()->TextureSet(pSizeData->m_aTextures[1]);
-				else
-					Graphics()->TextureSet(pSizeData->m_aTextures[0]);
-
-				Graphics()->QuadsBegin();
-				if (i == 0)
-					Graphics()->SetColor(m_TextOutlineR, m_TextOutlineG, m_TextOutlineB, m_TextOutlineA*m_TextA);
-				else
-					Graphics()->SetColor(m_TextR, m_TextG, m_TextB, m_TextA);
-			}
-
-			while(pCurrent < pEnd && (pCursor->m_MaxLines < 1 || LineCount <= pCursor->m_MaxLines))
-			{
-				int NewLine = 0;
-				const char *pBatchEnd = pEnd;
-				if(pCursor->m_LineWidth > 0 && !(pCursor->m_Flags&TEXTFLAG_STOP_AT_END))
-				{
-					int Wlen = min(WordLength((char *)pCurrent), (int)(pEnd-pCurrent));
-					CTextCursor Compare = *pCursor;
-					Compare.m_X = DrawX;
-					Compare.m_Y = DrawY;
-					Compare.m_Flags &= ~TEXTFLAG_RENDER;
-					Compare.m_LineWidth = -1;
-					TextEx(&Compare, pCurrent, Wlen);
-
-					if(Compare.m_X-DrawX > pCursor->m_LineWidth)
-					{
-						// word can't be fitted in one line, cut it
-						CTextCursor Cutter = *pCursor;
-						Cutter.m_GlyphCount = 0;
-						Cutter.m_X = DrawX;
-						Cutter.m_Y = DrawY;
-						Cutter.m_Flags &= ~TEXTFLAG_RENDER;
-						Cutter.m_Flags |= TEXTFLAG_STOP_AT_END;
-
-						TextEx(&Cutter, (const char *)pCurrent, Wlen);
-						Wlen = Cutter.m_GlyphCount;
-						NewLine = 1;
-
-						if(Wlen <= 3) // if we can't place 3 chars of the word on this line, take the next
-							Wlen = 0;
-					}
-					else if(Compare.m_X-pCursor->m_StartX > pCursor->m_LineWidth)
-					{
-						NewLine = 1;
-						Wlen = 0;
-					}
-
-					pBatchEnd = pCurrent + Wlen;
-				}
-
-				const char *pTmp = pCurrent;
-				int NextCharacter = str_utf8_decode(&pTmp);
-				while(pCurrent < pBatchEnd)
-				{
-					pCursor->m_CharCount += pTmp-pCurrent;
-					int Character = NextCharacter;
-					pCurrent = pTmp;
-					NextCharacter = str_utf8_decode(&pTmp);
-
-					if(Character == '\n')
-					{
-						DrawX = pCursor->m_StartX;
-						DrawY += Size;
-						DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
-						DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
-						++LineCount;
-						if(pCursor->m_MaxLines > 0 && LineCount > pCursor->m_MaxLines)
-							break;
-						continue;
-					}
-
-					CFontChar *pChr = GetChar(pFont, pSizeData, Character);
-					if(pChr)
-					{
-						float Advance = pChr->m_AdvanceX + Kerning(pFont, Character, NextCharacter)*Scale;
-						if(pCursor->m_Flags&TEXTFLAG_STOP_AT_END && DrawX+Advance*Size-pCursor->m_StartX > pCursor->m_LineWidth)
-						{
-							// we hit the end of the line, no more to render or count
-							pCurrent = pEnd;
-							break;
-						}
-
-						if(pCursor->m_Flags&TEXTFLAG_RENDER)
-						{
-							Graphics()->QuadsSetSubset(pChr->m_aUvs[0], pChr->m_aUvs[1], pChr->m_aUvs[2], pChr->m_aUvs[3]);
-							IGraphics::CQuadItem QuadItem(DrawX+pChr->m_OffsetX*Size, DrawY+pChr->m_OffsetY*Size, pChr->m_Width*Size, pChr->m_Height*Size);
-							Graphics()->QuadsDrawTL(&QuadItem, 1);
-						}
-
-						DrawX += Advance*Size;
-						pCursor->m_GlyphCount++;
-					}
-				}
-
-				if(NewLine)
-				{
-					DrawX = pCursor->m_StartX;
-					DrawY += Size;
-					GotNewLine = 1;
-					DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
-					DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
-					++LineCount;
-				}
-			}
-
+				RenderQuads(&Setup, pLayout->m_pQuads, pLayout->m_NumQuads);
+			ApplyLayout(pCursor, &Setup, pLayout);
+		}
+		else
+		{
+			// too long to be cached
+			m_NumLayoutQuads = 0;
+			LayoutText(pCursor, &Setup, pText, Length, pCursor->m_Flags&TEXTFLAG_RENDER);
 			if(pCursor->m_Flags&TEXTFLAG_RENDER)
-				Graphics()->QuadsEnd();
+				RenderQuads(&Setup, m_pLayoutQuads, m_NumLayoutQuads);
 		}
-
-		pCursor->m_X = DrawX;
-		pCursor->m_LineCount = LineCount;
-
-		if(GotNewLine)
-			pCursor->m_Y = DrawY;
 	}
 
 	float TextGetLineBaseY(const CTextCursor *pCursor)
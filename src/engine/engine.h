@@ -27,8 +27,9 @@ public:
 	virtual void InitLogfile() = 0;
 	virtual void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype) = 0;
 	virtual void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData) = 0;
+	virtual bool RemoveJob(CJob *pJob) = 0;
 };
 
-extern IEngine *CreateEngine(const char *pAppname);
+extern IEngine *CreateEngine(const char *pAppname, int NumJobThreads = 1);
 
 #endif
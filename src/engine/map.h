@@ -11,6 +11,7 @@ class IMap : public IInterface
 public:
 	virtual void *GetData(int Index) = 0;
 	virtual void *GetDataSwapped(int Index) = 0;
+	virtual void LoadData(const int *pIndices, int NumIndices) = 0;
 	virtual void UnloadData(int Index) = 0;
 	virtual void *GetItem(int Index, int *Type, int *pID) = 0;
 	virtual void GetType(int Type, int *pStart, int *pNum) = 0;
@@ -27,6 +28,7 @@ public:
 	virtual bool IsLoaded() = 0;
 	virtual void Unload() = 0;
 	virtual unsigned Crc() = 0;
+	virtual void MemoryUsage(int *pMapped, int *pResident, int *pLoaded) = 0;
 };
 
 extern IEngineMap *CreateEngineMap();
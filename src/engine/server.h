@@ -49,9 +49,13 @@ public:
 	virtual void SetClientCountry(int ClientID, int Country) = 0;
 	virtual void SetClientScore(int ClientID, int Score) = 0;
 
+	// the server info for browsers is cached, call this when something it shows changed
+	virtual void ExpireServerInfo() = 0;
+
 	virtual int SnapNewID() = 0;
 	virtual void SnapFreeID(int ID) = 0;
 	virtual void *SnapNewItem(int Type, int ID, int Size) = 0;
+	virtual int SnapSize() const = 0;
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
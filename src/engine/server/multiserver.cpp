@@ -0,0 +1,230 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/config.h>
+#include <engine/console.h>
+#include <engine/engine.h>
+#include <engine/map.h>
+#include <engine/masterserver.h>
+#include <engine/server.h>
+#include <engine/storage.h>
+
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/econ.h>
+#include <engine/shared/mapchecker.h>
+#include <engine/shared/netban.h>
+#include <engine/shared/network.h>
+#include <engine/shared/perf.h>
+#include <engine/shared/snapshot.h>
+
+#include "register.h"
+#include "server.h"
+#include "multiserver.h"
+
+CMultiServer::CMultiServer(IEngine *pEngine, IStorage *pStorage)
+{
+	m_NumInstances = 0;
+	m_NumRunning = 0;
+	m_Lock = lock_create();
+	m_pEngine = pEngine;
+	m_pStorage = pStorage;
+}
+
+CMultiServer::~CMultiServer()
+{
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		CInstance *pInstance = m_apInstances[i];
+		pInstance->MakeCurrent();
+		delete pInstance->m_pServer;
+		delete pInstance->m_pKernel;
+		delete pInstance->m_pEngineMap;
+		delete pInstance->m_pGameServer;
+		delete pInstance->m_pConsole;
+		delete pInstance->m_pEngineMasterServer;
+		delete pInstance->m_pConfig;
+		delete pInstance;
+	}
+	lock_destroy(m_Lock);
+}
+
+bool CMultiServer::AddInstance(const char *pConfigFile, bool UseDefaultConfig, int NumArgs, const char **ppArgs, bool GenerateRconPassword)
+{
+	if(m_NumInstances == MAX_INSTANCES)
+	{
+		dbg_msg("multiserver", "too many servers, max is %d", (int)MAX_INSTANCES);
+		return false;
+	}
+
+	// everything created from here on binds to the config of this instance
+	CInstance *pInstance = new CInstance;
+	mem_zero(&pInstance->m_Config, sizeof(pInstance->m_Config));
+	pInstance->m_ID = m_NumInstances;
+	pInstance->MakeCurrent();
+
+	pInstance->m_pKernel = IKernel::Create();
+	pInstance->m_pServer = new CServer();
+	pInstance->m_pEngineMap = CreateEngineMap();
+	pInstance->m_pGameServer = CreateGameServer();
+	pInstance->m_pConsole = CreateConsole(CFGFLAG_SERVER|CFGFLAG_ECON);
+	pInstance->m_pEngineMasterServer = CreateEngineMasterServer();
+	pInstance->m_pConfig = CreateConfig();
+	pInstance->m_Deadline = 0;
+	pInstance->m_Busy = false;
+	pInstance->m_Started = false;
+	pInstance->m_Running = false;
+	m_apInstances[m_NumInstances++] = pInstance;
+
+	CServer *pServer = pInstance->m_pServer;
+	IKernel *pKernel = pInstance->m_pKernel;
+	pServer->InitRegister(&pServer->m_NetServer, pInstance->m_pEngineMasterServer, pInstance->m_pConsole);
+
+	// engine and storage are shared, they stay with the kernel of the first server
+	bool RegisterFail = false;
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pServer); // register as both
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(m_pEngine);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IEngineMap*>(pInstance->m_pEngineMap)); // register as both
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IMap*>(pInstance->m_pEngineMap));
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pInstance->m_pGameServer);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pInstance->m_pConsole);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(m_pStorage);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(pInstance->m_pConfig);
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IEngineMasterServer*>(pInstance->m_pEngineMasterServer)); // register as both
+	RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IMasterServer*>(pInstance->m_pEngineMasterServer));
+	if(RegisterFail)
+		return false;
+
+	if(pInstance->m_ID == 0)
+		m_pEngine->Init();
+	pInstance->m_pConfig->Init(CFGFLAG_SERVER|CFGFLAG_ECON);
+	pInstance->m_pEngineMasterServer->Init();
+	pInstance->m_pEngineMasterServer->Load();
+
+	// autoexec and the command line like a single server, then the
+	// config of this server so it can override them
+	pServer->RegisterCommands();
+	if(!UseDefaultConfig)
+	{
+		pInstance->m_pConsole->ExecuteFile("autoexec.cfg");
+		pInstance->m_pConsole->ParseArguments(NumArgs, ppArgs);
+	}
+	pInstance->m_pConsole->ExecuteFile(pConfigFile);
+
+	// restore empty config strings to their defaults
+	pInstance->m_pConfig->RestoreStrings();
+
+	if(pInstance->m_ID == 0)
+		m_pEngine->InitLogfile();
+
+	if(GenerateRconPassword)
+		pServer->InitRconPasswordIfUnset();
+
+	dbg_msg("multiserver", "server %d uses '%s' on port %d", pInstance->m_ID, pConfigFile, g_Config.m_SvPort);
+	return true;
+}
+
+CMultiServer::CInstance *CMultiServer::PickInstance()
+{
+	CInstance *pBest = 0;
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		CInstance *pInstance = m_apInstances[i];
+		if(pInstance->m_Running && !pInstance->m_Busy && (!pBest || pInstance->m_Deadline < pBest->m_Deadline))
+			pBest = pInstance;
+	}
+	if(pBest)
+		pBest->m_Busy = true;
+	return pBest;
+}
+
+void CMultiServer::Work()
+{
+	while(1)
+	{
+		lock_wait(m_Lock);
+		if(!m_NumRunning)
+		{
+			lock_unlock(m_Lock);
+			break;
+		}
+		CInstance *pInstance = PickInstance();
+		lock_unlock(m_Lock);
+
+		// every server is taken by another thread
+		if(!pInstance)
+		{
+			thread_sleep(1);
+			continue;
+		}
+
+		// sleep until the deadline, incomming data for this server wakes us up early.
+		// rounding up keeps us from spinning through the last millisecond
+		int Wait = (int)(((pInstance->m_Deadline-time_get())*1000+time_freq()-1)/time_freq());
+		if(Wait > 0)
+			net_socket_read_wait(pInstance->m_pServer->m_NetServer.Socket(), min(Wait, (int)POLL_INTERVAL));
+
+		pInstance->MakeCurrent();
+		pInstance->m_pServer->Update();
+		pInstance->m_Deadline = min(pInstance->m_pServer->TickStartTime(pInstance->m_pServer->Tick()+1),
+			time_get()+time_freq()*POLL_INTERVAL/1000);
+
+		lock_wait(m_Lock);
+		pInstance->m_Busy = false;
+		if(!pInstance->m_pServer->IsRunning())
+		{
+			pInstance->m_Running = false;
+			m_NumRunning--;
+		}
+		lock_unlock(m_Lock);
+	}
+}
+
+void CMultiServer::WorkerThread(void *pUser)
+{
+	static_cast<CMultiServer *>(pUser)->Work();
+}
+
+int CMultiServer::Run(int NumThreads)
+{
+	// start all servers one after another, a failing one does not stop the others
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		CInstance *pInstance = m_apInstances[i];
+		pInstance->MakeCurrent();
+		dbg_msg("multiserver", "starting server %d...", i);
+		if(pInstance->m_pServer->Start() != 0)
+		{
+			dbg_msg("multiserver", "server %d failed to start", i);
+			continue;
+		}
+		pInstance->m_Started = true;
+		pInstance->m_Running = true;
+		pInstance->m_Deadline = time_get();
+		m_NumRunning++;
+	}
+
+	if(!m_NumRunning)
+		return -1;
+
+	// the calling thread is one of the workers
+	NumThreads = clamp(NumThreads, 1, (int)MAX_THREADS);
+	void *apThreads[MAX_THREADS];
+	for(int i = 1; i < NumThreads; i++)
+		apThreads[i] = thread_init(WorkerThread, this);
+	Work();
+	for(int i = 1; i < NumThreads; i++)
+		thread_wait(apThreads[i]);
+
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		CInstance *pInstance = m_apInstances[i];
+		pInstance->MakeCurrent();
+		if(pInstance->m_Started)
+			pInstance->m_pServer->Stop();
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SERVER_MULTISERVER_H
+#define ENGINE_SERVER_MULTISERVER_H
+
+#include <engine/shared/config.h>
+
+// hosts several independent servers in one process. every server has its
+// own kernel, config and port, while engine and storage are shared. a
+// fixed set of threads runs the servers, always picking the one with the
+// earliest deadline
+class CMultiServer
+{
+	enum
+	{
+		MAX_THREADS=16,
+		POLL_INTERVAL=5, // ms, same as the single server loop
+	};
+
+	class CInstance
+	{
+	public:
+		CConfiguration m_Config;
+		int m_ID;
+
+		class IKernel *m_pKernel;
+		class CServer *m_pServer;
+		class IEngineMap *m_pEngineMap;
+		class IGameServer *m_pGameServer;
+		class IConsole *m_pConsole;
+		class IEngineMasterServer *m_pEngineMasterServer;
+		class IConfig *m_pConfig;
+
+		int64 m_Deadline;
+		bool m_Busy;
+		bool m_Started;
+		bool m_Running;
+
+		void MakeCurrent() { g_pConfig = &m_Config; g_InstanceID = m_ID; }
+	};
+
+	CInstance *m_apInstances[MAX_INSTANCES];
+	int m_NumInstances;
+	int m_NumRunning;
+	LOCK m_Lock;
+
+	class IEngine *m_pEngine;
+	class IStorage *m_pStorage;
+
+	CInstance *PickInstance();
+	void Work();
+	static void WorkerThread(void *pUser);
+
+public:
+	CMultiServer(class IEngine *pEngine, class IStorage *pStorage);
+	~CMultiServer();
+
+	bool AddInstance(const char *pConfigFile, bool UseDefaultConfig, int NumArgs, const char **ppArgs, bool GenerateRconPassword);
+	int Run(int NumThreads);
+};
+
+#endif
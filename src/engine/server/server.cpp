@@ -22,14 +22,19 @@
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
+#include <engine/shared/perf.h>
 #include <engine/shared/protocol.h>
+#include <engine/shared/protocol_ex.h>
 #include <engine/shared/snapshot.h>
 
 #include <mastersrv/mastersrv.h>
 
+#include "multiserver.h"
 #include "register.h"
 #include "server.h"
 
+#include <zlib.h>
+
 #if defined(CONF_FAMILY_WINDOWS)
 	#define WIN32_LEAN_AND_MEAN
 	#include <windows.h>
@@ -264,10 +269,33 @@ void CServer::CClient::Reset()
 	m_LastAckedSnapshot = -1;
 	m_LastInputTick = -1;
 	m_SnapRate = CClient::SNAPRATE_INIT;
+	m_SnapLoss = -1.0f;
+	m_SnapLossTime = 0;
+	m_SnapPartsSent = 0;
+	m_SnapParitySent = 0;
+	m_SnapInterval = g_Config.m_SvSnapIntervalMin;
+	m_SnapCredit = 1.0f;
+	m_SnapsSent = 0;
+	m_SnapsAcked = 0;
+	m_SnapInputs = 0;
+	m_SnapAckLoss = 0.0f;
+	m_SnapDelaySum = 0;
+	m_SnapDelayNum = 0;
+	m_SnapDelayMin = -1;
+	m_SnapRateTime = time_get();
 	m_Score = 0;
 	m_MapChunk = 0;
+	m_MapChunksAcked = 0;
+	m_MapWindow = 0;
+	m_MapRequests = 0;
+	m_MapDownloadBytes = 0;
+	m_MapDownloadStart = 0;
+	m_MapRttMin = 0;
+	m_MapRtt = 0;
 }
 
+static const char *s_apPerfZoneNames[] = {"update", "network", "bans", "tick", "snapshot", "snap", "delta", "compress", "send", "register"};
+
 CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 {
 	m_TickSpeed = SERVER_TICK_SPEED;
@@ -277,8 +305,14 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_CurrentGameTick = 0;
 	m_RunServer = 1;
 
-	m_pCurrentMapData = 0;
 	m_CurrentMapSize = 0;
+	m_pMapChunkData = 0;
+	m_MapChunkStride = 0;
+	m_MapChunkHeaderSize = 0;
+	m_NumMapChunks = 0;
+	m_pMapShared = 0;
+	m_MapSharedSize = 0;
+	m_MapSharedFile = 0;
 
 	m_MapReload = 0;
 
@@ -287,6 +321,12 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 	m_RconPasswordSet = 0;
 	m_GeneratedRconPassword = 0;
+	m_RconLineReentry = 0;
+
+	m_Perf.Init(s_apPerfZoneNames, NUM_PERFZONES);
+	m_PerfSeconds = 0;
+
+	m_ServerInfoValid = false;
 
 	Init();
 }
@@ -297,6 +337,8 @@ void CServer::SetClientName(int ClientID, const char *pName)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY || !pName)
 		return;
 
+	if(str_comp(m_aClients[ClientID].m_aName, pName) != 0)
+		ExpireServerInfo();
 	str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
 }
 
@@ -305,6 +347,8 @@ void CServer::SetClientClan(int ClientID, const char *pClan)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY || !pClan)
 		return;
 
+	if(str_comp(m_aClients[ClientID].m_aClan, pClan) != 0)
+		ExpireServerInfo();
 	str_copy(m_aClients[ClientID].m_aClan, pClan, MAX_CLAN_LENGTH);
 }
 
@@ -313,6 +357,8 @@ void CServer::SetClientCountry(int ClientID, int Country)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
 
+	if(m_aClients[ClientID].m_Country != Country)
+		ExpireServerInfo();
 	m_aClients[ClientID].m_Country = Country;
 }
 
@@ -320,6 +366,8 @@ void CServer::SetClientScore(int ClientID, int Score)
 {
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
+	if(m_aClients[ClientID].m_Score != Score)
+		ExpireServerInfo();
 	m_aClients[ClientID].m_Score = Score;
 }
 
@@ -484,14 +532,18 @@ void CServer::InitRconPasswordIfUnset()
 
 int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 {
-	CNetChunk Packet;
 	if(!pMsg)
 		return -1;
+	return SendMsgData(pMsg->Data(), pMsg->Size(), Flags, ClientID);
+}
 
+int CServer::SendMsgData(const void *pData, int Size, int Flags, int ClientID)
+{
+	CNetChunk Packet;
 	mem_zero(&Packet, sizeof(CNetChunk));
 	Packet.m_ClientID = ClientID;
-	Packet.m_pData = pMsg->Data();
-	Packet.m_DataSize = pMsg->Size();
+	Packet.m_pData = pData;
+	Packet.m_DataSize = Size;
 
 	if(Flags&MSGFLAG_VITAL)
 		Packet.m_Flags |= NETSENDFLAG_VITAL;
@@ -500,7 +552,7 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 
 	// write message to demo recorder
 	if(!(Flags&MSGFLAG_NORECORD))
-		m_DemoRecorder.RecordMessage(pMsg->Data(), pMsg->Size());
+		m_DemoRecorder.RecordMessage(pData, Size);
 
 	if(!(Flags&MSGFLAG_NOSEND))
 	{
@@ -521,8 +573,71 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 	return 0;
 }
 
+void CServer::UpdateSnapRate(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	int64 Now = time_get();
+	if(Now-pClient->m_SnapRateTime < time_freq())
+		return;
+	pClient->m_SnapRateTime = Now;
+
+	// loss from the acks, out of the snapshots the client had a chance to ack
+	int Ackable = min(pClient->m_SnapsSent, pClient->m_SnapInputs);
+	if(Ackable > 0)
+	{
+		float Loss = clamp(1.0f - pClient->m_SnapsAcked/(float)Ackable, 0.0f, 1.0f);
+		pClient->m_SnapAckLoss = pClient->m_SnapAckLoss*0.75f + Loss*0.25f;
+	}
+
+	// a client reporting its snapshot loss knows better, but it only reports
+	// after multi-part snapshots, so an old report stops counting
+	if(pClient->m_SnapLoss >= 0.0f && Now-pClient->m_SnapLossTime > 3*time_freq())
+		pClient->m_SnapLoss = -1.0f;
+	float Loss = pClient->m_SnapLoss >= 0.0f ? pClient->m_SnapLoss : pClient->m_SnapAckLoss;
+
+	// queueing shows as delay above the lowest one seen, which slowly forgets
+	bool Queueing = false;
+	if(pClient->m_SnapDelayNum > 0)
+	{
+		int Delay = pClient->m_SnapDelaySum/pClient->m_SnapDelayNum;
+		if(pClient->m_SnapDelayMin < 0 || Delay < pClient->m_SnapDelayMin)
+			pClient->m_SnapDelayMin = Delay;
+		else
+			pClient->m_SnapDelayMin += 4;
+		Queueing = Delay > pClient->m_SnapDelayMin*3/2 + 50;
+	}
+
+	// back off fast when congested, speed up slowly when not
+	float Min = g_Config.m_SvSnapIntervalMin;
+	float Max = max(g_Config.m_SvSnapIntervalMax, g_Config.m_SvSnapIntervalMin);
+	if(Loss > 0.1f || Queueing)
+		pClient->m_SnapInterval *= 1.5f;
+	else if(Loss < 0.05f)
+		pClient->m_SnapInterval -= 1.0f;
+	pClient->m_SnapInterval = clamp(pClient->m_SnapInterval, Min, Max);
+
+	pClient->m_SnapsSent = 0;
+	pClient->m_SnapsAcked = 0;
+	pClient->m_SnapInputs = 0;
+	pClient->m_SnapDelaySum = 0;
+	pClient->m_SnapDelayNum = 0;
+}
+
+float CServer::SnapRate(int ClientID) const
+{
+	float Interval = g_Config.m_SvHighBandwidth ? 1.0f : 2.0f;
+	if(m_aClients[ClientID].m_SnapRate == CClient::SNAPRATE_INIT)
+		Interval = 10.0f;
+	else if(m_aClients[ClientID].m_SnapRate == CClient::SNAPRATE_RECOVER)
+		Interval = 50.0f;
+	else
+		Interval = max(Interval, m_aClients[ClientID].m_SnapInterval);
+	return SERVER_TICK_SPEED/Interval;
+}
+
 void CServer::DoSnapshot()
 {
+	CPerfScope PerfScope(&m_Perf, PERFZONE_SNAPSHOT);
 	GameServer()->OnPreSnap();
 
 	// create snapshot for demo recording
@@ -555,6 +670,16 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick()%10) != 0)
 			continue;
 
+		// throttle clients on a congested connection
+		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
+		{
+			UpdateSnapRate(i);
+			m_aClients[i].m_SnapCredit += (g_Config.m_SvHighBandwidth ? 1.0f : 2.0f) / m_aClients[i].m_SnapInterval;
+			if(m_aClients[i].m_SnapCredit < 1.0f)
+				continue;
+			m_aClients[i].m_SnapCredit = min(m_aClients[i].m_SnapCredit-1.0f, 1.0f);
+		}
+
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
@@ -570,11 +695,13 @@ void CServer::DoSnapshot()
 
 			m_SnapshotBuilder.Init();
 
+			int64 PerfStart = perf_time();
 			GameServer()->OnSnap(i);
 
 			// finish snapshot
 			SnapshotSize = m_SnapshotBuilder.Finish(pData);
 			Crc = pData->Crc();
+			m_Perf.Add(PERFZONE_SNAP, PerfStart, perf_time());
 
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
@@ -589,7 +716,11 @@ void CServer::DoSnapshot()
 			{
 				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
 				if(DeltashotSize >= 0)
+				{
 					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
+						m_aClients[i].m_SnapsSent++;
+				}
 				else
 				{
 					// no acked package found, force client to recover rate
@@ -599,7 +730,9 @@ void CServer::DoSnapshot()
 			}
 
 			// create delta
+			PerfStart = perf_time();
 			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			m_Perf.Add(PERFZONE_DELTA, PerfStart, perf_time());
 
 			if(DeltaSize)
 			{
@@ -608,9 +741,18 @@ void CServer::DoSnapshot()
 				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
 				int NumPackets;
 
+				PerfStart = perf_time();
 				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
 				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+				m_Perf.Add(PERFZONE_COMPRESS, PerfStart, perf_time());
+
+				// one parity part per group, a group gets smaller the more the client loses.
+				// clients that never reported loss (older versions) get no parity
+				int GroupSize = 0;
+				if(NumPackets > 1 && g_Config.m_SvSnapParity && m_aClients[i].m_SnapLoss >= 0.01f)
+					GroupSize = clamp((int)(1.0f/(4.0f*m_aClients[i].m_SnapLoss)), 1, NumPackets);
 
+				PerfStart = perf_time();
 				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
 				{
 					int Chunk = Left < MaxSize ? Left : MaxSize;
@@ -637,15 +779,38 @@ void CServer::DoSnapshot()
 						Msg.AddInt(Chunk);
 						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
 						SendMsg(&Msg, MSGFLAG_FLUSH, i);
+						m_aClients[i].m_SnapPartsSent++;
+
+						// close the group
+						if(GroupSize && ((n+1)%GroupSize == 0 || Left == 0))
+						{
+							char aParity[MAX_SNAPSHOT_PACKSIZE];
+							int ParitySize = CSnapshotParts::CreateParity(aCompData, SnapshotSize, MaxSize, GroupSize, n/GroupSize, aParity);
+							CMsgPacker Msg(NETMSG_SNAPPARITY, true);
+							Msg.AddInt(m_CurrentGameTick);
+							Msg.AddInt(m_CurrentGameTick-DeltaTick);
+							Msg.AddInt(NumPackets);
+							Msg.AddInt(n/GroupSize);
+							Msg.AddInt(GroupSize);
+							Msg.AddInt(SnapshotSize);
+							Msg.AddInt(Crc);
+							Msg.AddInt(ParitySize);
+							Msg.AddRaw(aParity, ParitySize);
+							SendMsg(&Msg, MSGFLAG_FLUSH, i);
+							m_aClients[i].m_SnapParitySent++;
+						}
 					}
 				}
+				m_Perf.Add(PERFZONE_SEND, PerfStart, perf_time());
 			}
 			else
 			{
+				PerfStart = perf_time();
 				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick-DeltaTick);
 				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				m_Perf.Add(PERFZONE_SEND, PerfStart, perf_time());
 			}
 		}
 	}
@@ -667,6 +832,7 @@ int CServer::NewClientCallback(int ClientID, void *pUser)
 	pThis->m_aClients[ClientID].m_NoRconNote = false;
 	pThis->m_aClients[ClientID].m_Quitting = false;
 	pThis->m_aClients[ClientID].Reset();
+	pThis->ExpireServerInfo();
 	return 0;
 }
 
@@ -697,6 +863,7 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 	pThis->m_aClients[ClientID].m_NoRconNote = false;
 	pThis->m_aClients[ClientID].m_Quitting = false;
 	pThis->m_aClients[ClientID].m_Snapshots.PurgeAll();
+	pThis->ExpireServerInfo();
 	return 0;
 }
 
@@ -711,6 +878,93 @@ void CServer::SendMap(int ClientID)
 	SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
 }
 
+void CServer::SendMapData(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	int64 Now = time_get();
+
+	// nothing to serve until a dropped mapping got reloaded
+	if(!m_pMapShared && !m_pMapChunkData)
+		return;
+
+	// the client asks for the next package once it got m_MapChunksPerRequest chunks,
+	// so every request after the first one acknowledges a full package
+	if(pClient->m_MapRequests++ == 0)
+	{
+		// the map file was changed in place, the mapping doesn't hold the
+		// loaded map anymore and reading past a cut off end would crash
+		if(m_pMapShared && !MapSharedValid(m_MapSharedFile))
+		{
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "map file changed on disk, reloading the map");
+			UnmapShared();
+			m_MapReload = 1;
+			return;
+		}
+
+		pClient->m_MapWindow = m_MapChunksPerRequest;
+		pClient->m_MapDownloadStart = Now;
+	}
+	else
+	{
+		int Sent = pClient->m_MapChunk < 0 ? m_NumMapChunks : pClient->m_MapChunk;
+		pClient->m_MapChunksAcked = min(pClient->m_MapChunksAcked+m_MapChunksPerRequest, Sent);
+
+		// round trip of the last acknowledged chunk drives the window: grow while the
+		// link does not queue up, back off as soon as the delay starts to build
+		if(pClient->m_MapChunksAcked > 0)
+		{
+			int64 Rtt = Now - pClient->m_aMapChunkTime[(pClient->m_MapChunksAcked-1)%CClient::MAP_TIME_SLOTS];
+			if(!pClient->m_MapRttMin || Rtt < pClient->m_MapRttMin)
+				pClient->m_MapRttMin = Rtt;
+			pClient->m_MapRtt = pClient->m_MapRtt ? (pClient->m_MapRtt*7+Rtt)/8 : Rtt;
+
+			int MaxWindow = max((int)CClient::MAP_WINDOW_MAX, m_MapChunksPerRequest);
+			if(Rtt <= pClient->m_MapRttMin*5/4+time_freq()/200)
+				pClient->m_MapWindow = min(pClient->m_MapWindow+1, MaxWindow);
+			else if(Rtt > pClient->m_MapRttMin*2)
+				pClient->m_MapWindow = max(pClient->m_MapWindow*3/4, m_MapChunksPerRequest);
+		}
+	}
+
+	// top up the chunks in flight
+	while(pClient->m_MapChunk >= 0 && pClient->m_MapChunk-pClient->m_MapChunksAcked < pClient->m_MapWindow)
+	{
+		int Chunk = pClient->m_MapChunk;
+		int ChunkSize = min((int)MAP_CHUNK_SIZE, m_CurrentMapSize-Chunk*MAP_CHUNK_SIZE);
+
+		if(Chunk+1 >= m_NumMapChunks)
+			pClient->m_MapChunk = -1;
+		else
+			pClient->m_MapChunk++;
+
+		if(m_pMapShared)
+		{
+			unsigned char aChunk[NET_MAX_PAYLOAD];
+			mem_copy(aChunk, m_aMapChunkHeader, m_MapChunkHeaderSize);
+			mem_copy(aChunk+m_MapChunkHeaderSize, m_pMapShared+Chunk*MAP_CHUNK_SIZE, ChunkSize);
+			SendMsgData(aChunk, m_MapChunkHeaderSize+ChunkSize, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
+		}
+		else
+			SendMsgData(m_pMapChunkData+Chunk*m_MapChunkStride, m_MapChunkHeaderSize+ChunkSize, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
+		pClient->m_aMapChunkTime[Chunk%CClient::MAP_TIME_SLOTS] = Now;
+		pClient->m_MapDownloadBytes += ChunkSize;
+
+		if(g_Config.m_Debug)
+		{
+			char aBuf[64];
+			str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
+			Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+		}
+	}
+}
+
+int CServer::MapDownloadRate(int ClientID) const
+{
+	const CClient *pClient = &m_aClients[ClientID];
+	int64 Elapsed = max(time_get()-pClient->m_MapDownloadStart, time_freq()/1000);
+	return (int)(pClient->m_MapDownloadBytes*time_freq()/Elapsed/1024);
+}
+
 void CServer::SendConnectionReady(int ClientID)
 {
 	CMsgPacker Msg(NETMSG_CON_READY, true);
@@ -727,11 +981,10 @@ void CServer::SendRconLine(int ClientID, const char *pLine)
 void CServer::SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighted)
 {
 	CServer *pThis = (CServer *)pUser;
-	static volatile int ReentryGuard = 0;
 	int i;
 
-	if(ReentryGuard) return;
-	ReentryGuard++;
+	if(pThis->m_RconLineReentry) return;
+	pThis->m_RconLineReentry++;
 
 	for(i = 0; i < MAX_CLIENTS; i++)
 	{
@@ -739,7 +992,7 @@ void CServer::SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighte
 			pThis->SendRconLine(i, pLine);
 	}
 
-	ReentryGuard--;
+	pThis->m_RconLineReentry--;
 }
 
 void CServer::SendRconCmdAdd(const IConsole::CCommandInfo *pCommandInfo, int ClientID)
@@ -822,34 +1075,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 		{
 			if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) == 0 || m_aClients[ClientID].m_State == CClient::STATE_CONNECTING)
 			{
-				int ChunkSize = MAP_CHUNK_SIZE;
-
-				// send map chunks
-				for(int i = 0; i < m_MapChunksPerRequest && m_aClients[ClientID].m_MapChunk >= 0; ++i)
-				{
-					int Chunk = m_aClients[ClientID].m_MapChunk;
-					int Offset = Chunk * ChunkSize;
-
-					// check for last part
-					if(Offset+ChunkSize >= m_CurrentMapSize)
-					{
-						ChunkSize = m_CurrentMapSize-Offset;
-						m_aClients[ClientID].m_MapChunk = -1;
-					}
-					else
-						m_aClients[ClientID].m_MapChunk++;
-
-					CMsgPacker Msg(NETMSG_MAP_DATA, true);
-					Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
-					SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
-
-					if(g_Config.m_Debug)
-					{
-						char aBuf[64];
-						str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
-						Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
-					}
-				}
+				SendMapData(ClientID);
 			}
 		}
 		else if(Msg == NETMSG_READY)
@@ -862,8 +1088,16 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				char aBuf[256];
 				str_format(aBuf, sizeof(aBuf), "player is ready. ClientID=%x addr=%s", ClientID, aAddrStr);
 				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
+				if(m_aClients[ClientID].m_MapDownloadBytes)
+				{
+					str_format(aBuf, sizeof(aBuf), "map download ClientID=%x bytes=%d rate=%dKiB/s window=%d rtt=%dms", ClientID,
+						m_aClients[ClientID].m_MapDownloadBytes, MapDownloadRate(ClientID), m_aClients[ClientID].m_MapWindow,
+						(int)(m_aClients[ClientID].m_MapRtt*1000/time_freq()));
+					Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
+				}
 				m_aClients[ClientID].m_State = CClient::STATE_READY;
 				GameServer()->OnClientConnected(ClientID);
+				ExpireServerInfo();
 				SendConnectionReady(ClientID);
 			}
 		}
@@ -888,6 +1122,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			int64 TagTime;
 			int64 Now = time_get();
 
+			int PrevAckedSnapshot = m_aClients[ClientID].m_LastAckedSnapshot;
 			m_aClients[ClientID].m_LastAckedSnapshot = Unpacker.GetInt();
 			int IntendedTick = Unpacker.GetInt();
 			int Size = Unpacker.GetInt();
@@ -897,7 +1132,12 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				return;
 
 			if(m_aClients[ClientID].m_LastAckedSnapshot > 0)
+			{
+				// coming back from recovery, start slow and let the rate control speed up
+				if(m_aClients[ClientID].m_SnapRate == CClient::SNAPRATE_RECOVER)
+					m_aClients[ClientID].m_SnapInterval = g_Config.m_SvSnapIntervalMax;
 				m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_FULL;
+			}
 
 			// add message to report the input timing
 			// skip packets that are old
@@ -924,10 +1164,19 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				pInput->m_aData[i] = Unpacker.GetInt();
 
 			int PingCorrection = clamp(Unpacker.GetInt(), 0, 50);
+			m_aClients[ClientID].m_SnapInputs++;
 			if(m_aClients[ClientID].m_Snapshots.Get(m_aClients[ClientID].m_LastAckedSnapshot, &TagTime, 0, 0) >= 0)
 			{
 				m_aClients[ClientID].m_Latency = (int)(((Now-TagTime)*1000)/time_freq());
 				m_aClients[ClientID].m_Latency = max(0, m_aClients[ClientID].m_Latency - PingCorrection);
+
+				// only a newly acked snapshot tells the delay, later inputs repeat the ack
+				if(m_aClients[ClientID].m_LastAckedSnapshot > PrevAckedSnapshot)
+				{
+					m_aClients[ClientID].m_SnapsAcked++;
+					m_aClients[ClientID].m_SnapDelaySum += m_aClients[ClientID].m_Latency;
+					m_aClients[ClientID].m_SnapDelayNum++;
+				}
 			}
 
 			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
@@ -1020,6 +1269,20 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			CMsgPacker Msg(NETMSG_PING_REPLY, true);
 			SendMsg(&Msg, 0, ClientID);
 		}
+		else if(Msg == NETMSG_SNAPLOSS)
+		{
+			int Expected = Unpacker.GetInt();
+			int Lost = Unpacker.GetInt();
+			if(Unpacker.Error() || Expected <= 0 || Lost < 0 || Lost > Expected)
+				return;
+
+			float Loss = Lost/(float)Expected;
+			m_aClients[ClientID].m_SnapLossTime = time_get();
+			if(m_aClients[ClientID].m_SnapLoss < 0.0f)
+				m_aClients[ClientID].m_SnapLoss = Loss;
+			else
+				m_aClients[ClientID].m_SnapLoss = m_aClients[ClientID].m_SnapLoss*0.75f + Loss*0.25f;
+		}
 		else
 		{
 			if(g_Config.m_Debug)
@@ -1050,7 +1313,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 	}
 }
 
-void CServer::GenerateServerInfo(CPacker *pPacker, int Token)
+void CServer::GenerateServerInfo(CPacker *pPacker, bool ClientList)
 {
 	// count the players
 	int PlayerCount = 0, ClientCount = 0;
@@ -1065,13 +1328,6 @@ void CServer::GenerateServerInfo(CPacker *pPacker, int Token)
 		}
 	}
 
-	if(Token != -1)
-	{
-		pPacker->Reset();
-		pPacker->AddRaw(SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
-		pPacker->AddInt(Token);
-	}
-
 	pPacker->AddString(GameServer()->Version(), 32);
 	pPacker->AddString(g_Config.m_SvName, 64);
 	pPacker->AddString(g_Config.m_SvHostname, 128);
@@ -1090,7 +1346,7 @@ void CServer::GenerateServerInfo(CPacker *pPacker, int Token)
 	pPacker->AddInt(ClientCount); // num clients
 	pPacker->AddInt(m_NetServer.MaxClients()); // max clients
 
-	if(Token != -1)
+	if(ClientList)
 	{
 		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
@@ -1109,7 +1365,7 @@ void CServer::GenerateServerInfo(CPacker *pPacker, int Token)
 void CServer::SendServerInfo(int ClientID)
 {
 	CMsgPacker Msg(NETMSG_SERVERINFO, true);
-	GenerateServerInfo(&Msg, -1);
+	GenerateServerInfo(&Msg, false);
 	if(ClientID == -1)
 	{
 		for(int i = 0; i < MAX_CLIENTS; i++)
@@ -1122,9 +1378,33 @@ void CServer::SendServerInfo(int ClientID)
 		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
 }
 
+void CServer::SendServerInfoConnless(const NETADDR *pAddr, int Token, TOKEN ResponseToken)
+{
+	if(!m_ServerInfoValid)
+	{
+		m_ServerInfo.Reset();
+		GenerateServerInfo(&m_ServerInfo, true);
+		m_ServerInfoValid = true;
+	}
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddRaw(SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
+	Packer.AddInt(Token);
+	Packer.AddRaw(m_ServerInfo.Data(), m_ServerInfo.Size());
+
+	CNetChunk Response;
+	Response.m_ClientID = -1;
+	Response.m_Address = *pAddr;
+	Response.m_Flags = NETSENDFLAG_CONNLESS;
+	Response.m_pData = Packer.Data();
+	Response.m_DataSize = Packer.Size();
+	m_NetServer.Send(&Response, ResponseToken);
+}
 
 void CServer::PumpNetwork()
 {
+	CPerfScope PerfScope(&m_Perf, PERFZONE_NETWORK);
 	CNetChunk Packet;
 	TOKEN ResponseToken;
 
@@ -1146,24 +1426,17 @@ void CServer::PumpNetwork()
 				if(Unpacker.Error())
 					continue;
 
-				CPacker Packer;
-				CNetChunk Response;
-				
-				GenerateServerInfo(&Packer, SrvBrwsToken);
-
-				Response.m_ClientID = -1;
-				Response.m_Address = Packet.m_Address;
-				Response.m_Flags = NETSENDFLAG_CONNLESS;
-				Response.m_pData = Packer.Data();
-				Response.m_DataSize = Packer.Size();
-				m_NetServer.Send(&Response, ResponseToken);
+				SendServerInfoConnless(&Packet.m_Address, SrvBrwsToken, ResponseToken);
 			}
 		}
 		else
 			ProcessClientPacket(&Packet);
 	}
 
-	m_ServerBan.Update();
+	{
+		CPerfScope PerfScope(&m_Perf, PERFZONE_BANS);
+		m_ServerBan.Update();
+	}
 	m_Econ.Update();
 }
 
@@ -1179,6 +1452,29 @@ const char *CServer::GetMapName() const
 	return pMapShortName;
 }
 
+bool CServer::MapSharedValid(IOHANDLE File) const
+{
+	return io_length(File) == m_CurrentMapSize &&
+		crc32(crc32(0L, 0x0, 0), m_pMapShared, m_CurrentMapSize) == m_CurrentMapCrc; // ignore_convention
+}
+
+void CServer::UnmapShared()
+{
+	io_unmap(m_pMapShared, m_MapSharedSize);
+	m_pMapShared = 0;
+	m_MapSharedSize = 0;
+	if(m_MapSharedFile)
+		io_close(m_MapSharedFile);
+	m_MapSharedFile = 0;
+}
+
+// with sv_map_shared map downloads are served from a mapping of the map
+// file. replacing the file is fine (the mapping keeps the old one), but
+// rewriting it in place changes what gets sent and cutting it short makes
+// reads past its end crash. the file length and crc are checked when a
+// download starts and the map is reloaded if they changed, a file cut
+// short during a download can still crash though.
+// on windows a mapped file can't be changed at all
 int CServer::LoadMap(const char *pMapName)
 {
 	char aBuf[512];
@@ -1208,15 +1504,52 @@ int CServer::LoadMap(const char *pMapName)
 
 	str_copy(m_aCurrentMap, pMapName, sizeof(m_aCurrentMap));
 
-	// load complete map into memory for download
+	// load complete map into memory for download, already packed as
+	// NETMSG_MAP_DATA messages so serving a chunk is a single copy
 	{
+		if(m_pMapChunkData)
+			mem_free(m_pMapChunkData);
+		m_pMapChunkData = 0;
+		UnmapShared();
+
 		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
 		m_CurrentMapSize = (int)io_length(File);
-		if(m_pCurrentMapData)
-			mem_free(m_pCurrentMapData);
-		m_pCurrentMapData = (unsigned char *)mem_alloc(m_CurrentMapSize, 1);
-		io_read(File, m_pCurrentMapData, m_CurrentMapSize);
-		io_close(File);
+		m_NumMapChunks = max((m_CurrentMapSize+MAP_CHUNK_SIZE-1)/MAP_CHUNK_SIZE, 1);
+
+		CMsgPacker Header(NETMSG_MAP_DATA, true);
+		m_MapChunkHeaderSize = Header.Size();
+		m_MapChunkStride = m_MapChunkHeaderSize+MAP_CHUNK_SIZE;
+		mem_copy(m_aMapChunkHeader, Header.Data(), m_MapChunkHeaderSize);
+
+		// the page cache holds one copy of a mapped file for all processes.
+		// the crc makes sure the file is still the one the map was loaded from
+		if(g_Config.m_SvMapShared)
+		{
+			m_pMapShared = (unsigned char *)io_map(File, &m_MapSharedSize, IOMAP_READONLY);
+			if(m_pMapShared && m_MapSharedSize == (unsigned)m_CurrentMapSize && MapSharedValid(File))
+			{
+				m_MapSharedFile = File;
+				File = 0;
+			}
+			if(m_pMapShared && !m_MapSharedFile)
+			{
+				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", "map file changed while loading, not sharing it");
+				UnmapShared();
+			}
+		}
+
+		if(!m_pMapShared)
+		{
+			m_pMapChunkData = (unsigned char *)mem_alloc_tag(m_NumMapChunks*m_MapChunkStride, 1, MEMTAG_MAP);
+			for(int i = 0; i < m_NumMapChunks; i++)
+			{
+				unsigned char *pChunk = m_pMapChunkData+i*m_MapChunkStride;
+				mem_copy(pChunk, m_aMapChunkHeader, m_MapChunkHeaderSize);
+				io_read(File, pChunk+m_MapChunkHeaderSize, min((int)MAP_CHUNK_SIZE, m_CurrentMapSize-i*MAP_CHUNK_SIZE));
+			}
+		}
+		if(File)
+			io_close(File);
 	}
 	return 1;
 }
@@ -1226,7 +1559,7 @@ void CServer::InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterS
 	m_Register.Init(pNetServer, pMasterServer, pConsole);
 }
 
-int CServer::Run()
+int CServer::Start()
 {
 	//
 	m_PrintCBIndex = Console()->RegisterPrintCallback(g_Config.m_ConsoleOutputLevel, SendRconLineAuthed, this);
@@ -1261,6 +1594,7 @@ int CServer::Run()
 	}
 
 	m_NetServer.SetCallbacks(NewClientCallback, DelClientCallback, this);
+	m_NetServer.SetPacketRates(g_Config.m_SvNetRateAddr, g_Config.m_SvNetRateNet);
 
 	m_Econ.Init(Console(), &m_ServerBan);
 
@@ -1283,119 +1617,149 @@ int CServer::Run()
 	}
 
 	// start game
-	{
-		int64 ReportTime = time_get();
-		int ReportInterval = 3;
+	m_ReportTime = time_get();
+	m_Lastheartbeat = 0;
+	m_GameStartTime = time_get();
+	return 0;
+}
+
+void CServer::Update()
+{
+	CPerfScope PerfScope(&m_Perf, PERFZONE_UPDATE);
+	int ReportInterval = 3;
+	char aBuf[256];
 
-		m_Lastheartbeat = 0;
-		m_GameStartTime = time_get();
+	int64 t = time_get();
+	int NewTicks = 0;
 
-		while(m_RunServer)
+	// load new map TODO: don't poll this
+	if(str_comp(g_Config.m_SvMap, m_aCurrentMap) != 0 || m_MapReload || m_CurrentGameTick >= 0x6FFFFFFF) //	force reload to make sure the ticks stay within a valid range
+	{
+		m_MapReload = 0;
+
+		// load map
+		if(LoadMap(g_Config.m_SvMap))
 		{
-			int64 t = time_get();
-			int NewTicks = 0;
+			// new map loaded
+			GameServer()->OnShutdown();
 
-			// load new map TODO: don't poll this
-			if(str_comp(g_Config.m_SvMap, m_aCurrentMap) != 0 || m_MapReload || m_CurrentGameTick >= 0x6FFFFFFF) //	force reload to make sure the ticks stay within a valid range
+			for(int c = 0; c < MAX_CLIENTS; c++)
 			{
-				m_MapReload = 0;
+				if(m_aClients[c].m_State <= CClient::STATE_AUTH)
+					continue;
 
-				// load map
-				if(LoadMap(g_Config.m_SvMap))
-				{
-					// new map loaded
-					GameServer()->OnShutdown();
+				SendMap(c);
+				m_aClients[c].Reset();
+				m_aClients[c].m_State = CClient::STATE_CONNECTING;
+			}
 
-					for(int c = 0; c < MAX_CLIENTS; c++)
-					{
-						if(m_aClients[c].m_State <= CClient::STATE_AUTH)
-							continue;
+			m_GameStartTime = time_get();
+			m_CurrentGameTick = 0;
+			Kernel()->ReregisterInterface(GameServer());
+			GameServer()->OnInit();
+			ExpireServerInfo();
+		}
+		else
+		{
+			str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", g_Config.m_SvMap);
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+			str_copy(g_Config.m_SvMap, m_aCurrentMap, sizeof(g_Config.m_SvMap));
+		}
+	}
 
-						SendMap(c);
-						m_aClients[c].Reset();
-						m_aClients[c].m_State = CClient::STATE_CONNECTING;
-					}
+	while(t > TickStartTime(m_CurrentGameTick+1))
+	{
+		m_CurrentGameTick++;
+		NewTicks++;
 
-					m_GameStartTime = time_get();
-					m_CurrentGameTick = 0;
-					Kernel()->ReregisterInterface(GameServer());
-					GameServer()->OnInit();
-				}
-				else
+		// apply new input
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(m_aClients[c].m_State == CClient::STATE_EMPTY)
+				continue;
+			for(int i = 0; i < 200; i++)
+			{
+				if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
 				{
-					str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", g_Config.m_SvMap);
-					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
-					str_copy(g_Config.m_SvMap, m_aCurrentMap, sizeof(g_Config.m_SvMap));
+					if(m_aClients[c].m_State == CClient::STATE_INGAME)
+						GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
+					break;
 				}
 			}
+		}
 
-			while(t > TickStartTime(m_CurrentGameTick+1))
-			{
-				m_CurrentGameTick++;
-				NewTicks++;
-
-				// apply new input
-				for(int c = 0; c < MAX_CLIENTS; c++)
-				{
-					if(m_aClients[c].m_State == CClient::STATE_EMPTY)
-						continue;
-					for(int i = 0; i < 200; i++)
-					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
-						{
-							if(m_aClients[c].m_State == CClient::STATE_INGAME)
-								GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
-							break;
-						}
-					}
-				}
+		{
+			CPerfScope PerfScope(&m_Perf, PERFZONE_TICK);
+			GameServer()->OnTick();
+		}
+	}
 
-				GameServer()->OnTick();
-			}
+	// snap game
+	if(NewTicks)
+	{
+		if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+			DoSnapshot();
 
-			// snap game
-			if(NewTicks)
-			{
-				if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
-					DoSnapshot();
+		UpdateClientRconCommands();
+	}
 
-				UpdateClientRconCommands();
-			}
+	// master server stuff
+	{
+		CPerfScope PerfScope(&m_Perf, PERFZONE_REGISTER);
+		m_Register.RegisterUpdate(m_NetServer.NetType());
+	}
 
-			// master server stuff
-			m_Register.RegisterUpdate(m_NetServer.NetType());
+	PumpNetwork();
 
-			PumpNetwork();
+	if(m_ReportTime < time_get())
+	{
+		if(g_Config.m_Debug)
+		{
+			/*
+			static NETSTATS prev_stats;
+			NETSTATS stats;
+			netserver_stats(net, &stats);
 
-			if(ReportTime < time_get())
-			{
-				if(g_Config.m_Debug)
-				{
-					/*
-					static NETSTATS prev_stats;
-					NETSTATS stats;
-					netserver_stats(net, &stats);
+			perf_next();
 
-					perf_next();
+			if(config.dbg_pref)
+				perf_dump(&rootscope);
 
-					if(config.dbg_pref)
-						perf_dump(&rootscope);
+			dbg_msg("server", "send=%8d recv=%8d",
+				(stats.send_bytes - prev_stats.send_bytes)/reportinterval,
+				(stats.recv_bytes - prev_stats.recv_bytes)/reportinterval);
 
-					dbg_msg("server", "send=%8d recv=%8d",
-						(stats.send_bytes - prev_stats.send_bytes)/reportinterval,
-						(stats.recv_bytes - prev_stats.recv_bytes)/reportinterval);
+			prev_stats = stats;
+			*/
+		}
 
-					prev_stats = stats;
-					*/
-				}
+		m_ReportTime += time_freq()*ReportInterval;
+	}
 
-				ReportTime += time_freq()*ReportInterval;
-			}
+	if(m_Perf.Update())
+	{
+		m_PerfSeconds++;
+		if(g_Config.m_SvPerfReport && m_PerfSeconds%g_Config.m_SvPerfReport == 0)
+			PrintPerf(IConsole::OUTPUT_LEVEL_ADDINFO);
+	}
 
-			// wait for incomming data
-			net_socket_read_wait(m_NetServer.Socket(), 5);
-		}
+	if(m_Perf.TraceDone())
+	{
+		char aFilename[128];
+		char aDate[20];
+		str_timestamp(aDate, sizeof(aDate));
+		str_format(aFilename, sizeof(aFilename), "dumps/perf_%d_%s.json", g_InstanceID, aDate);
+		int NumEvents = m_Perf.NumTraceEvents();
+		if(m_Perf.SaveTrace(Storage(), aFilename, g_InstanceID))
+			str_format(aBuf, sizeof(aBuf), "saved %d trace events to '%s'", NumEvents, aFilename);
+		else
+			str_format(aBuf, sizeof(aBuf), "failed to save trace to '%s'", aFilename);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", aBuf);
 	}
+}
+
+void CServer::Stop()
+{
 	// disconnect all clients on shutdown
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
@@ -1408,8 +1772,26 @@ int CServer::Run()
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
 
-	if(m_pCurrentMapData)
-		mem_free(m_pCurrentMapData);
+	if(m_pMapChunkData)
+		mem_free(m_pMapChunkData);
+	m_pMapChunkData = 0;
+	UnmapShared();
+}
+
+int CServer::Run()
+{
+	if(Start() != 0)
+		return -1;
+
+	while(m_RunServer)
+	{
+		Update();
+
+		// wait for incomming data
+		net_socket_read_wait(m_NetServer.Socket(), 5);
+	}
+
+	Stop();
 	return 0;
 }
 
@@ -1440,9 +1822,14 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 			{
 				const char *pAuthStr = pThis->m_aClients[i].m_Authed == CServer::AUTHED_ADMIN ? "(Admin)" :
 										pThis->m_aClients[i].m_Authed == CServer::AUTHED_MOD ? "(Mod)" : "";
-				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s client=%x name='%s' score=%d %s", i, aAddrStr,
-					pThis->m_aClients[i].m_Version, pThis->m_aClients[i].m_aName, pThis->m_aClients[i].m_Score, pAuthStr);
+				const CNetConnection *pConn = pThis->m_NetServer.Connection(i);
+				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s client=%x name='%s' score=%d rtt=%dms loss=%.1f%% snaps=%.1f/s %s", i, aAddrStr,
+					pThis->m_aClients[i].m_Version, pThis->m_aClients[i].m_aName, pThis->m_aClients[i].m_Score,
+					pConn->Rtt(), pConn->LossRate()*100.0f, pThis->SnapRate(i), pAuthStr);
 			}
+			else if(pThis->m_aClients[i].m_MapDownloadBytes)
+				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s connecting map=%d%% rate=%dKiB/s", i, aAddrStr,
+					(int)(pThis->m_aClients[i].m_MapDownloadBytes*100LL/max(pThis->m_CurrentMapSize, 1)), pThis->MapDownloadRate(i));
 			else
 				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s connecting", i, aAddrStr);
 			pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
@@ -1455,6 +1842,94 @@ void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 	((CServer *)pUser)->m_RunServer = 0;
 }
 
+void CServer::ConMapMemory(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	char aBuf[256];
+
+	int Mapped, Resident, Loaded;
+	pThis->m_pMap->MemoryUsage(&Mapped, &Resident, &Loaded);
+	str_format(aBuf, sizeof(aBuf), "map '%s' crc=%08x mapped=%d resident=%d loaded=%d", pThis->m_aCurrentMap, pThis->m_CurrentMapCrc,
+		Mapped, Resident, Loaded);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
+
+	if(pThis->m_pMapShared)
+		str_format(aBuf, sizeof(aBuf), "download shared=%d resident=%d", pThis->m_MapSharedSize,
+			mem_resident(pThis->m_pMapShared, pThis->m_MapSharedSize));
+	else
+		str_format(aBuf, sizeof(aBuf), "download private=%d", pThis->m_pMapChunkData ? pThis->m_NumMapChunks*pThis->m_MapChunkStride : 0);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
+}
+
+void CServer::PrintPerf(int Level)
+{
+	char aBuf[256];
+	for(int i = 0; i < m_Perf.NumZones(); i++)
+	{
+		m_Perf.FormatZone(i, aBuf, sizeof(aBuf));
+		Console()->Print(Level, "perf", aBuf);
+	}
+}
+
+void CServer::ConPerf(IConsole::IResult *pResult, void *pUser)
+{
+	static_cast<CServer *>(pUser)->PrintPerf(IConsole::OUTPUT_LEVEL_STANDARD);
+}
+
+void CServer::ConNetFilter(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const CNetFilter *apFilters[2] = { pThis->m_NetServer.Filter(), pThis->m_Econ.Filter() };
+	const char *apNames[2] = { "game", "econ" };
+	for(int f = 0; f < 2; f++)
+	{
+		if(!apFilters[f])
+			continue;
+
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%s:", apNames[f]);
+		for(int i = 0; i < CNetFilter::NUM_DROPS; i++)
+		{
+			char aDrop[64];
+			str_format(aDrop, sizeof(aDrop), " %s=%d", CNetFilter::DropName(i), apFilters[f]->Drops(i));
+			str_append(aBuf, aDrop, sizeof(aBuf));
+		}
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_filter", aBuf);
+	}
+}
+
+void CServer::ConMemStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	if(!CONF_MEMSTATS)
+	{
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mem_stats", "built without memory accounting");
+		return;
+	}
+
+	for(int i = 0; i < NUM_MEMTAGS; i++)
+	{
+		MEMSTATS Stats;
+		mem_stats(i, &Stats);
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%-8s live=%lld peak=%lld allocs=%lld frees=%lld", mem_tag_name(i),
+			Stats.live, Stats.peak, Stats.allocs, Stats.frees);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mem_stats", aBuf);
+	}
+}
+
+void CServer::ConPerfTrace(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	int Seconds = pResult->NumArguments() ? clamp(pResult->GetInteger(0), 1, 60) : 5;
+	char aBuf[128];
+	if(pThis->m_Perf.StartTrace(Seconds))
+		str_format(aBuf, sizeof(aBuf), "tracing for %d seconds", Seconds);
+	else
+		str_copy(aBuf, "already tracing", sizeof(aBuf));
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", aBuf);
+}
+
 void CServer::DemoRecorder_HandleAutoStart()
 {
 	if(g_Config.m_SvAutoDemoRecord)
@@ -1530,6 +2005,7 @@ void CServer::ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserD
 	if(pResult->NumArguments())
 	{
 		str_clean_whitespaces(g_Config.m_SvName);
+		((CServer *)pUserData)->ExpireServerInfo();
 		((CServer *)pUserData)->SendServerInfo(-1);
 	}
 }
@@ -1541,6 +2017,13 @@ void CServer::ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pU
 		((CServer *)pUserData)->m_NetServer.SetMaxClientsPerIP(pResult->GetInteger(0));
 }
 
+void CServer::ConchainNetRateUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		((CServer *)pUserData)->m_NetServer.SetPacketRates(g_Config.m_SvNetRateAddr, g_Config.m_SvNetRateNet);
+}
+
 void CServer::ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	if(pResult->NumArguments() == 2)
@@ -1600,6 +2083,11 @@ void CServer::RegisterCommands()
 	Console()->Register("kick", "i?r", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
+	Console()->Register("map_memory", "", CFGFLAG_SERVER, ConMapMemory, this, "Show the memory used by the current map");
+	Console()->Register("perf", "", CFGFLAG_SERVER, ConPerf, this, "Show the timings of the last second");
+	Console()->Register("net_filter", "", CFGFLAG_SERVER, ConNetFilter, this, "Show how many packets were dropped before decoding, by reason");
+	Console()->Register("mem_stats", "", CFGFLAG_SERVER, ConMemStats, this, "Show the memory in use per subsystem, with its peak and allocation counts");
+	Console()->Register("perf_trace", "?i", CFGFLAG_SERVER, ConPerfTrace, this, "Record all timings for a number of seconds to a chrome trace file in dumps");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 
 	Console()->Register("record", "?s", CFGFLAG_SERVER|CFGFLAG_STORE, ConRecord, this, "Record to a file");
@@ -1609,8 +2097,13 @@ void CServer::RegisterCommands()
 
 	Console()->Chain("sv_name", ConchainSpecialInfoupdate, this);
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
+	Console()->Chain("sv_hostname", ConchainSpecialInfoupdate, this);
+	Console()->Chain("sv_skill_level", ConchainSpecialInfoupdate, this);
+	Console()->Chain("sv_player_slots", ConchainSpecialInfoupdate, this);
 
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
+	Console()->Chain("sv_net_rate_addr", ConchainNetRateUpdate, this);
+	Console()->Chain("sv_net_rate_net", ConchainNetRateUpdate, this);
 	Console()->Chain("mod_command", ConchainModCommandUpdate, this);
 	Console()->Chain("console_output_level", ConchainConsoleOutputLevelUpdate, this);
 	Console()->Chain("sv_rcon_password", ConchainRconPasswordSet, this);
@@ -1639,6 +2132,11 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
 }
 
+int CServer::SnapSize() const
+{
+	return m_SnapshotBuilder.DataSize();
+}
+
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
@@ -1676,6 +2174,41 @@ int main(int argc, const char **argv) // ignore_convention
 		SkipPWGen = true;	// skip automatic password generation
 	}
 
+	// multi server mode: --multi <threads> <config file>... [-- <arguments>]
+	// the other arguments are used by every server, like in single server mode
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		if(str_comp("--multi", argv[i]) == 0 && i+2 < argc) // ignore_convention
+		{
+			int ConfigsEnd = i+2;
+			while(ConfigsEnd < argc && str_comp("--", argv[ConfigsEnd]) != 0) // ignore_convention
+				ConfigsEnd++;
+
+			const char **ppArgs = (const char **)mem_alloc(argc*sizeof(const char *), 1); // ignore_convention
+			int NumArgs = 0;
+			for(int a = 1; a < argc; a++) // ignore_convention
+				if(a < i || a > ConfigsEnd)
+					ppArgs[NumArgs++] = argv[a]; // ignore_convention
+
+			IEngine *pEngine = CreateEngine("Teeworlds");
+			IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_SERVER, argc, argv); // ignore_convention
+			CMultiServer *pMultiServer = new CMultiServer(pEngine, pStorage);
+
+			int Result = 0;
+			for(int c = i+2; c < ConfigsEnd && Result == 0; c++)
+				if(!pMultiServer->AddInstance(argv[c], UseDefaultConfig, NumArgs, ppArgs, !SkipPWGen)) // ignore_convention
+					Result = -1;
+			if(Result == 0)
+				Result = pMultiServer->Run(str_toint(argv[i+1])); // ignore_convention
+
+			mem_free(ppArgs);
+			delete pMultiServer;
+			delete pEngine;
+			delete pStorage;
+			return Result;
+		}
+	}
+
 	CServer *pServer = CreateServer();
 	IKernel *pKernel = IKernel::Create();
 
@@ -111,6 +111,25 @@ public:
 		int m_LastInputTick;
 		CSnapshotStorage m_Snapshots;
 
+		// snapshot parity, the loss stays negative for clients that never report it
+		// and goes back to negative when the last report is too old
+		float m_SnapLoss;
+		int64 m_SnapLossTime;
+		int m_SnapPartsSent;
+		int m_SnapParitySent;
+
+		// snapshot rate control, the interval is in ticks and follows the ack delay and loss
+		float m_SnapInterval;
+		float m_SnapCredit;
+		int m_SnapsSent; // delta snapshots at the full rate only
+		int m_SnapsAcked;
+		int m_SnapInputs; // a client acks with its inputs, so it can't ack more often than it sends them
+		float m_SnapAckLoss;
+		int m_SnapDelaySum;
+		int m_SnapDelayNum;
+		int m_SnapDelayMin;
+		int64 m_SnapRateTime;
+
 		CInput m_LatestInput;
 		CInput m_aInputs[200]; // TODO: handle input better
 		int m_CurrentInput;
@@ -123,7 +142,22 @@ public:
 		int m_Authed;
 		int m_AuthTries;
 
+		// map download
+		enum
+		{
+			MAP_WINDOW_MAX=16, // keeps the in-flight chunks well inside the resend buffer
+			MAP_TIME_SLOTS=32,
+		};
+
 		int m_MapChunk;
+		int m_MapChunksAcked;
+		int m_MapWindow;
+		int m_MapRequests;
+		int m_MapDownloadBytes;
+		int64 m_MapDownloadStart;
+		int64 m_MapRttMin;
+		int64 m_MapRtt;
+		int64 m_aMapChunkTime[MAP_TIME_SLOTS];
 		bool m_NoRconNote;
 		bool m_Quitting;
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
@@ -150,6 +184,29 @@ public:
 	int m_PrintCBIndex;
 
 	int64 m_Lastheartbeat;
+	int64 m_ReportTime;
+
+	// timings of the hot paths, nested zones are counted in their parents too
+	enum
+	{
+		PERFZONE_UPDATE=0,
+		PERFZONE_NETWORK,
+		PERFZONE_BANS,
+		PERFZONE_TICK,
+		PERFZONE_SNAPSHOT,
+		PERFZONE_SNAP,
+		PERFZONE_DELTA,
+		PERFZONE_COMPRESS,
+		PERFZONE_SEND,
+		PERFZONE_REGISTER,
+		NUM_PERFZONES
+	};
+	CPerf m_Perf;
+	int m_PerfSeconds;
+
+	// packed server info with the client list, rebuilt when expired
+	CPacker m_ServerInfo;
+	bool m_ServerInfoValid;
 
 	// map
 	enum
@@ -158,12 +215,23 @@ public:
 	};
 	char m_aCurrentMap[64];
 	unsigned m_CurrentMapCrc;
-	unsigned char *m_pCurrentMapData;
 	int m_CurrentMapSize;
 	int m_MapChunksPerRequest;
+	unsigned char *m_pMapChunkData; // prepacked NETMSG_MAP_DATA messages
+	int m_MapChunkStride;
+	unsigned char m_aMapChunkHeader[8];
+	int m_MapChunkHeaderSize;
+	int m_NumMapChunks;
+	unsigned char *m_pMapShared; // read-only mapping of the map file if sv_map_shared is set
+	unsigned m_MapSharedSize;
+	IOHANDLE m_MapSharedFile; // kept open to notice the mapped file getting shorter
+
+	bool MapSharedValid(IOHANDLE File) const; // the file still holds the loaded map
+	void UnmapShared();
 
 	int m_RconPasswordSet;
 	int m_GeneratedRconPassword;
+	int m_RconLineReentry;
 
 	CDemoRecorder m_DemoRecorder;
 	CRegister m_Register;
@@ -199,13 +267,18 @@ public:
 	int MaxClients() const;
 
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
+	int SendMsgData(const void *pData, int Size, int Flags, int ClientID);
 
+	void UpdateSnapRate(int ClientID);
+	float SnapRate(int ClientID) const;
 	void DoSnapshot();
 
 	static int NewClientCallback(int ClientID, void *pUser);
 	static int DelClientCallback(int ClientID, const char *pReason, void *pUser);
 
 	void SendMap(int ClientID);
+	void SendMapData(int ClientID);
+	int MapDownloadRate(int ClientID) const;
 	void SendConnectionReady(int ClientID);
 	void SendRconLine(int ClientID, const char *pLine);
 	static void SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighted);
@@ -217,9 +290,12 @@ public:
 	void ProcessClientPacket(CNetChunk *pPacket);
 
 	void SendServerInfo(int ClientID);
-	void GenerateServerInfo(CPacker *pPacker, int Token);
+	void GenerateServerInfo(CPacker *pPacker, bool ClientList);
+	void SendServerInfoConnless(const NETADDR *pAddr, int Token, TOKEN ResponseToken);
+	void ExpireServerInfo() { m_ServerInfoValid = false; }
 
 	void PumpNetwork();
+	void PrintPerf(int Level);
 
 	const char *GetMapName() const;
 	int LoadMap(const char *pMapName);
@@ -227,9 +303,20 @@ public:
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
 	int Run();
 
+	// split up version of Run for hosts that drive several servers
+	int Start();
+	void Update();
+	void Stop();
+	bool IsRunning() const { return m_RunServer != 0; }
+
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
+	static void ConMapMemory(IConsole::IResult *pResult, void *pUser);
+	static void ConPerf(IConsole::IResult *pResult, void *pUser);
+	static void ConNetFilter(IConsole::IResult *pResult, void *pUser);
+	static void ConMemStats(IConsole::IResult *pResult, void *pUser);
+	static void ConPerfTrace(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
@@ -237,6 +324,7 @@ public:
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainNetRateUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainConsoleOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainRconPasswordSet(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -247,6 +335,7 @@ public:
 	virtual int SnapNewID();
 	virtual void SnapFreeID(int ID);
 	virtual void *SnapNewItem(int Type, int ID, int Size);
+	virtual int SnapSize() const;
 	void SnapSetStaticsize(int ItemType, int Size);
 };
 
@@ -5,7 +5,7 @@
 #include "compression.h"
 
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
-unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
+unsigned char *CVariableInt::PackLong(unsigned char *pDst, int i)
 {
 	*pDst = (i>>25)&0x40; // set sign bit if i<0
 	i = i^(i>>31); // if(i<0) i = ~i
@@ -30,7 +30,7 @@ unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
 	return pDst;
 }
 
-const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut)
+const unsigned char *CVariableInt::UnpackLong(const unsigned char *pSrc, int *pInOut)
 {
 	int Sign = (*pSrc>>6)&1;
 	*pInOut = *pSrc&0x3F;
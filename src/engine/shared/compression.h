@@ -5,9 +5,27 @@
 // variable int packing
 class CVariableInt
 {
+	static unsigned char *PackLong(unsigned char *pDst, int i);
+	static const unsigned char *UnpackLong(const unsigned char *pSrc, int *pInOut);
+
 public:
-	static unsigned char *Pack(unsigned char *pDst, int i);
-	static const unsigned char *Unpack(const unsigned char *pSrc, int *pInOut);
+	// ints in [-64, 63] take one byte without extend bit and are handled inline
+	static unsigned char *Pack(unsigned char *pDst, int i)
+	{
+		if((unsigned)i+64u >= 128u)
+			return PackLong(pDst, i);
+		*pDst = ((i>>25)&0x40) | ((i^(i>>31))&0x3F);
+		return pDst+1;
+	}
+
+	static const unsigned char *Unpack(const unsigned char *pSrc, int *pInOut)
+	{
+		if(*pSrc&0x80)
+			return UnpackLong(pSrc, pInOut);
+		*pInOut = (*pSrc&0x3F) ^ -((*pSrc>>6)&1);
+		return pSrc+1;
+	}
+
 	static long Compress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
 	static long Decompress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
 };
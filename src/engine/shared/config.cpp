@@ -6,7 +6,9 @@
 #include <engine/shared/config.h>
 
 
-CConfiguration g_Config;
+static CConfiguration s_Config;
+THREAD_LOCAL CConfiguration *g_pConfig = &s_Config;
+THREAD_LOCAL int g_InstanceID = 0;
 
 class CConfig : public IConfig
 {
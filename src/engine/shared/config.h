@@ -3,6 +3,8 @@
 #ifndef ENGINE_SHARED_CONFIG_H
 #define ENGINE_SHARED_CONFIG_H
 
+#include <base/system.h>
+
 struct CConfiguration
 {
 	#define MACRO_CONFIG_INT(Name,ScriptName,Def,Min,Max,Save,Desc) int m_##Name;
@@ -12,7 +14,17 @@ struct CConfiguration
 	#undef MACRO_CONFIG_STR
 };
 
-extern CConfiguration g_Config;
+enum
+{
+	MAX_INSTANCES=32,
+};
+
+// the configuration and index of the server instance the current thread
+// works for. there is just one unless the server runs in multi server mode,
+// which switches them whenever a thread picks up another instance
+extern THREAD_LOCAL CConfiguration *g_pConfig;
+extern THREAD_LOCAL int g_InstanceID;
+#define g_Config (*g_pConfig)
 
 enum
 {
@@ -43,6 +43,7 @@ MACRO_CONFIG_INT(SndMusic, snd_enable_music, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIEN
 MACRO_CONFIG_INT(SndVolume, snd_volume, 100, 0, 100, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Sound volume")
 MACRO_CONFIG_INT(SndDevice, snd_device, -1, 0, 0, CFGFLAG_SAVE|CFGFLAG_CLIENT, "(deprecated) Sound device to use")
 MACRO_CONFIG_INT(SndNonactiveMute, snd_nonactive_mute, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "")
+MACRO_CONFIG_INT(SndNullDevice, snd_null_device, 0, 0, 1, CFGFLAG_CLIENT, "Mix sound into a buffer instead of an audio device")
 
 MACRO_CONFIG_INT(GfxScreen, gfx_screen, 0, 0, 0, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Screen index")
 MACRO_CONFIG_INT(GfxScreenWidth, gfx_screen_width, 0, 0, 0, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Screen resolution width")
@@ -73,7 +74,14 @@ MACRO_CONFIG_INT(SvExternalPort, sv_external_port, 0, 0, 0, CFGFLAG_SAVE|CFGFLAG
 MACRO_CONFIG_STR(SvMap, sv_map, 128, "dm1", CFGFLAG_SAVE|CFGFLAG_SERVER, "Map to use on the server")
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, 8, 1, MAX_CLIENTS, CFGFLAG_SAVE|CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SAVE|CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
+MACRO_CONFIG_INT(SvNetRateAddr, sv_net_rate_addr, 1000, 0, 100000, CFGFLAG_SAVE|CFGFLAG_SERVER, "Packets per second accepted from one address that is not connected (0 = no limit)")
+MACRO_CONFIG_INT(SvNetRateNet, sv_net_rate_net, 4000, 0, 100000, CFGFLAG_SAVE|CFGFLAG_SERVER, "Packets per second accepted from one /24 (IPv4) or /64 (IPv6) network that is not connected (0 = no limit)")
 MACRO_CONFIG_INT(SvMapDownloadSpeed, sv_map_download_speed, 2, 1, 16, CFGFLAG_SAVE|CFGFLAG_SERVER, "Number of map data packages a client gets on each request")
+MACRO_CONFIG_INT(SvMapShared, sv_map_shared, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Serve map downloads from a read-only mapping of the map file, shared by all server processes on the host")
+MACRO_CONFIG_INT(SvSnapParity, sv_snap_parity, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Send parity parts with large snapshots so clients can rebuild a lost part, the amount follows the loss clients report")
+MACRO_CONFIG_INT(SvSnapIntervalMin, sv_snap_interval_min, 1, 1, 50, CFGFLAG_SAVE|CFGFLAG_SERVER, "Minimum number of ticks between two snapshots of a client")
+MACRO_CONFIG_INT(SvSnapIntervalMax, sv_snap_interval_max, 10, 1, 50, CFGFLAG_SAVE|CFGFLAG_SERVER, "Maximum number of ticks between two snapshots of a client on a congested connection")
+MACRO_CONFIG_INT(SvPerfReport, sv_perf_report, 0, 0, 3600, CFGFLAG_SAVE|CFGFLAG_SERVER, "Print the timings of the server every that many seconds, also to the external console (0 = off)")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SAVE|CFGFLAG_SERVER, "Remote console password (full access)")
@@ -674,14 +674,21 @@ CConsole::CConsole(int FlagMask)
 	// TODO: this should disappear
 	#define MACRO_CONFIG_INT(Name,ScriptName,Def,Min,Max,Flags,Desc) \
 	{ \
-		static CIntVariableData Data = { this, &g_Config.m_##Name, Min, Max }; \
-		Register(#ScriptName, "?i", Flags, IntVariableCommand, &Data, Desc); \
+		CIntVariableData *pData = static_cast<CIntVariableData *>(m_VariableData.Allocate(sizeof(CIntVariableData))); \
+		pData->m_pConsole = this; \
+		pData->m_pVariable = &g_Config.m_##Name; \
+		pData->m_Min = Min; \
+		pData->m_Max = Max; \
+		Register(#ScriptName, "?i", Flags, IntVariableCommand, pData, Desc); \
 	}
 
 	#define MACRO_CONFIG_STR(Name,ScriptName,Len,Def,Flags,Desc) \
 	{ \
-		static CStrVariableData Data = { this, g_Config.m_##Name, Len }; \
-		Register(#ScriptName, "?r", Flags, StrVariableCommand, &Data, Desc); \
+		CStrVariableData *pData = static_cast<CStrVariableData *>(m_VariableData.Allocate(sizeof(CStrVariableData))); \
+		pData->m_pConsole = this; \
+		pData->m_pStr = g_Config.m_##Name; \
+		pData->m_MaxSize = Len; \
+		Register(#ScriptName, "?r", Flags, StrVariableCommand, pData, Desc); \
 	}
 
 	#include "config_variables.h"
@@ -761,7 +768,7 @@ void CConsole::Register(const char *pName, const char *pParams,
 	bool DoAdd = false;
 	if(pCommand == 0)
 	{
-		pCommand = new(mem_alloc(sizeof(CCommand), sizeof(void*))) CCommand;
+		pCommand = new(mem_alloc_tag(sizeof(CCommand), sizeof(void*), MEMTAG_CONSOLE)) CCommand;
 		DoAdd = true;
 	}
 	pCommand->m_pfnCallback = pfnFunc;
@@ -882,7 +889,7 @@ void CConsole::Chain(const char *pName, FChainCommandCallback pfnChainFunc, void
 		return;
 	}
 
-	CChain *pChainInfo = (CChain *)mem_alloc(sizeof(CChain), sizeof(void*));
+	CChain *pChainInfo = (CChain *)mem_alloc_tag(sizeof(CChain), sizeof(void*), MEMTAG_CONSOLE);
 
 	// store info
 	pChainInfo->m_pfnChainCallback = pfnChainFunc;
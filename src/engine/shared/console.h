@@ -50,6 +50,7 @@ class CConsole : public IConsole
 
 	CCommand *m_pRecycleList;
 	CHeap m_TempCommands;
+	CHeap m_VariableData; // bindings of the config variables, one set per console
 
 	static void Con_Chain(IResult *pResult, void *pUserData);
 	static void Con_Echo(IResult *pResult, void *pUserData);
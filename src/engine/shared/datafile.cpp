@@ -2,6 +2,8 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
+#include <engine/engine.h>
 #include <engine/storage.h>
 #include "datafile.h"
 #include <zlib.h>
@@ -58,6 +60,8 @@ struct CDatafileInfo
 struct CDatafile
 {
 	IOHANDLE m_File;
+	char *m_pMapping; // the whole file, if it could be mapped
+	unsigned m_MappingSize;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
 	CDatafileHeader m_Header;
@@ -77,9 +81,20 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	// map the file, so the items can be used in place and the data can be
+	// decompressed without reading it first. pages stay shared with other
+	// processes until someone writes to the items
+	unsigned MappingSize = 0;
+	char *pMapping = 0;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	pMapping = (char *)io_map(File, &MappingSize, IOMAP_COPY);
+#endif
 
 	// take the CRC of the file and store it
 	unsigned Crc = crc32(0L, 0x0, 0);
+	if(pMapping)
+		Crc = crc32(Crc, (const Bytef *)pMapping, MappingSize); // ignore_convention
+	else
 	{
 		enum
 		{
@@ -102,12 +117,17 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	io_read(File, &Header, sizeof(Header));
+	mem_zero(&Header, sizeof(Header));
+	if(pMapping)
+		mem_copy(&Header, pMapping, min((unsigned)sizeof(Header), MappingSize));
+	else
+		io_read(File, &Header, sizeof(Header));
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			io_unmap(pMapping, MappingSize);
 			io_close(File);
 			return 0;
 		}
@@ -119,6 +139,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		io_unmap(pMapping, MappingSize);
 		io_close(File);
 		return 0;
 	}
@@ -131,26 +152,41 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Size += Header.m_NumRawData*sizeof(int); // v4 has uncompressed data sizes aswell
 	Size += Header.m_ItemSize;
 
-	unsigned AllocSize = Size;
+	unsigned AllocSize = pMapping ? 0 : Size; // a mapped file is used in place
 	AllocSize += sizeof(CDatafile); // add space for info structure
 	AllocSize += Header.m_NumRawData*sizeof(void*); // add space for data pointers
 
-	CDatafile *pTmpDataFile = (CDatafile*)mem_alloc(AllocSize, 1);
+	CDatafile *pTmpDataFile = (CDatafile*)mem_alloc_tag(AllocSize, 1, MEMTAG_MAP);
 	pTmpDataFile->m_Header = Header;
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (char**)(pTmpDataFile+1);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile+1)+Header.m_NumRawData*sizeof(char *);
 	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_pMapping = pMapping;
+	pTmpDataFile->m_MappingSize = MappingSize;
 	pTmpDataFile->m_Crc = Crc;
 
 	// clear the data pointers
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
 
 	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	unsigned ReadSize;
+	if(pMapping)
+	{
+		ReadSize = min(Size, MappingSize-min((unsigned)sizeof(CDatafileHeader), MappingSize));
+		pTmpDataFile->m_pData = pMapping+sizeof(CDatafileHeader);
+
+		// everything is read through the mapping from now on
+		io_close(File);
+		pTmpDataFile->m_File = 0;
+	}
+	else
+		ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
 	if(ReadSize != Size)
 	{
-		io_close(pTmpDataFile->m_File);
+		if(pTmpDataFile->m_File)
+			io_close(pTmpDataFile->m_File);
+		io_unmap(pMapping, MappingSize);
 		mem_free(pTmpDataFile);
 		pTmpDataFile = 0;
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
@@ -253,37 +289,62 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		int SwapSize = DataSize;
 #endif
 
+		// the data can be used straight from the mapping
+		const char *pMapped = 0;
+		if(m_pDataFile->m_pMapping)
+		{
+			unsigned Offset = m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index];
+			if(Offset > m_pDataFile->m_MappingSize || (unsigned)DataSize > m_pDataFile->m_MappingSize-Offset)
+			{
+				dbg_msg("datafile", "data outside of the file. index=%d", Index);
+				return 0;
+			}
+			pMapped = m_pDataFile->m_pMapping+Offset;
+		}
+
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
-			void *pTemp = (char *)mem_alloc(DataSize, 1);
+			void *pTemp = 0;
 			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
 			unsigned long s;
 
 			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
+			char *pData = (char *)mem_alloc_tag(UncompressedSize, 1, MEMTAG_MAP);
 
 			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+			if(!pMapped)
+			{
+				pTemp = mem_alloc_tag(DataSize, 1, MEMTAG_MAP);
+				io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
+				io_read(m_pDataFile->m_File, pTemp, DataSize);
+			}
 
 			// decompress the data, TODO: check for errors
 			s = UncompressedSize;
-			uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef*)pTemp, DataSize); // ignore_convention
+			uncompress((Bytef*)pData, &s, (Bytef*)(pMapped ? pMapped : pTemp), DataSize); // ignore_convention
 #if defined(CONF_ARCH_ENDIAN_BIG)
 			SwapSize = s;
 #endif
 
 			// clean up the temporary buffers
-			mem_free(pTemp);
+			if(pTemp)
+				mem_free(pTemp);
+			m_pDataFile->m_ppDataPtrs[Index] = pData;
 		}
 		else
 		{
-			// load the data
+			// load the data, it's copied even if mapped as the caller owns it
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			char *pData = (char *)mem_alloc_tag(DataSize, 1, MEMTAG_MAP);
+			if(pMapped)
+				mem_copy(pData, pMapped, DataSize);
+			else
+			{
+				io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
+				io_read(m_pDataFile->m_File, pData, DataSize);
+			}
+			m_pDataFile->m_ppDataPtrs[Index] = pData;
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -300,6 +361,83 @@ void *CDataFileReader::GetData(int Index)
 	return GetDataImpl(Index, 0);
 }
 
+struct CDatafileLoad
+{
+	CDataFileReader *m_pReader;
+	int *m_pIndices;
+	int m_NumIndices;
+	volatile unsigned m_NextIndex;
+};
+
+int CDataFileReader::LoadDataThread(void *pUser)
+{
+	CDatafileLoad *pLoad = (CDatafileLoad *)pUser;
+	while(1)
+	{
+		int i = atomic_inc(&pLoad->m_NextIndex)-1;
+		if(i >= pLoad->m_NumIndices)
+			break;
+		pLoad->m_pReader->GetDataImpl(pLoad->m_pIndices[i], 0);
+	}
+	return 0;
+}
+
+void CDataFileReader::LoadData(IEngine *pEngine, const int *pIndices, int NumIndices)
+{
+	if(!m_pDataFile)
+		return;
+
+	// collect the data that isn't loaded yet, each index only once
+	CDatafileLoad Load;
+	Load.m_pReader = this;
+	Load.m_pIndices = (int *)mem_alloc_tag(max(NumIndices, 1)*sizeof(int), 1, MEMTAG_MAP);
+	Load.m_NumIndices = 0;
+	Load.m_NextIndex = 0;
+	for(int i = 0; i < NumIndices; i++)
+	{
+		int Index = pIndices[i];
+		if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData || m_pDataFile->m_ppDataPtrs[Index])
+			continue;
+
+		bool Found = false;
+		for(int j = 0; j < Load.m_NumIndices && !Found; j++)
+			Found = Load.m_pIndices[j] == Index;
+		if(!Found)
+			Load.m_pIndices[Load.m_NumIndices++] = Index;
+	}
+
+	// without a mapping all reads go through the same file handle.
+	// on big endian machines the data might have to be swapped by the
+	// first caller, so it's loaded on demand there
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	if(m_pDataFile->m_pMapping && pEngine && Load.m_NumIndices > 1)
+	{
+		// decompress on the job pool and on this thread at the same time
+		CJob aJobs[MAX_LOAD_JOBS];
+		int NumJobs = min((int)MAX_LOAD_JOBS, Load.m_NumIndices-1);
+		for(int i = 0; i < NumJobs; i++)
+			pEngine->AddJob(&aJobs[i], LoadDataThread, &Load);
+		LoadDataThread(&Load);
+
+		// all data is taken, jobs still queued behind others aren't needed anymore
+		for(int i = 0; i < NumJobs; i++)
+		{
+			if(pEngine->RemoveJob(&aJobs[i]))
+				continue;
+			while(aJobs[i].Status() != CJob::STATE_DONE)
+				thread_sleep(1);
+		}
+	}
+	else
+#endif
+	{
+		for(int i = 0; i < Load.m_NumIndices; i++)
+			GetDataImpl(Load.m_pIndices[i], 0);
+	}
+
+	mem_free(Load.m_pIndices);
+}
+
 void *CDataFileReader::GetDataSwapped(int Index)
 {
 	return GetDataImpl(Index, 1);
@@ -395,7 +533,9 @@ bool CDataFileReader::Close()
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 		mem_free(m_pDataFile->m_ppDataPtrs[i]);
 
-	io_close(m_pDataFile->m_File);
+	if(m_pDataFile->m_File)
+		io_close(m_pDataFile->m_File);
+	io_unmap(m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
 	mem_free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
@@ -407,13 +547,36 @@ unsigned CDataFileReader::Crc() const
 	return m_pDataFile->m_Crc;
 }
 
+void CDataFileReader::MemoryUsage(int *pMapped, int *pResident, int *pLoaded) const
+{
+	*pMapped = 0;
+	*pResident = 0;
+	*pLoaded = 0;
+	if(!m_pDataFile)
+		return;
+
+	*pMapped = m_pDataFile->m_MappingSize;
+	*pResident = m_pDataFile->m_pMapping ? mem_resident(m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize) : 0;
+	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
+	{
+		if(!m_pDataFile->m_ppDataPtrs[i])
+			continue;
+		if(m_pDataFile->m_Header.m_Version == 4)
+			*pLoaded += m_pDataFile->m_Info.m_pDataSizes[i];
+		else
+			*pLoaded += GetDataSize(i);
+	}
+}
+
 
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
-	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES, 1));
-	m_pItems = static_cast<CItemInfo *>(mem_alloc(sizeof(CItemInfo) * MAX_ITEMS, 1));
-	m_pDatas = static_cast<CDataInfo *>(mem_alloc(sizeof(CDataInfo) * MAX_DATAS, 1));
+	m_pEngine = 0;
+	m_CompressionLevel = COMPRESSION_DEFAULT;
+	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc_tag(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES, 1, MEMTAG_MAP));
+	m_pItems = static_cast<CItemInfo *>(mem_alloc_tag(sizeof(CItemInfo) * MAX_ITEMS, 1, MEMTAG_MAP));
+	m_pDatas = static_cast<CDataInfo *>(mem_alloc_tag(sizeof(CDataInfo) * MAX_DATAS, 1, MEMTAG_MAP));
 }
 
 CDataFileWriter::~CDataFileWriter()
@@ -426,13 +589,16 @@ CDataFileWriter::~CDataFileWriter()
 	m_pDatas = 0;
 }
 
-bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename)
+bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename, IEngine *pEngine, int CompressionLevel)
 {
 	dbg_assert(!m_File, "a file already exists");
 	m_File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 	if(!m_File)
 		return false;
 
+	m_pEngine = pEngine;
+	m_CompressionLevel = CompressionLevel == COMPRESSION_DEFAULT ? COMPRESSION_DEFAULT : clamp(CompressionLevel, (int)COMPRESSION_FASTEST, (int)COMPRESSION_BEST);
+
 	m_NumItems = 0;
 	m_NumDatas = 0;
 	m_NumItemTypes = 0;
@@ -460,7 +626,7 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 	m_pItems[m_NumItems].m_Size = Size;
 
 	// copy data
-	m_pItems[m_NumItems].m_pData = mem_alloc(Size, 1);
+	m_pItems[m_NumItems].m_pData = mem_alloc_tag(Size, 1, MEMTAG_MAP);
 	mem_copy(m_pItems[m_NumItems].m_pData, pData, Size);
 
 	if(!m_pItemTypes[Type].m_Num) // count item types
@@ -489,25 +655,50 @@ int CDataFileWriter::AddData(int Size, void *pData)
 
 	dbg_assert(m_NumDatas < 1024, "too much data");
 
+	// the data gets compressed in Finish, all at once
 	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
-	void *pCompData = mem_alloc(s, 1); // temporary buffer that we use during compression
+	pInfo->m_UncompressedSize = Size;
+	pInfo->m_CompressedSize = 0;
+	pInfo->m_pUncompressedData = mem_alloc_tag(max(Size, 1), 1, MEMTAG_MAP);
+	mem_copy(pInfo->m_pUncompressedData, pData, Size);
+	pInfo->m_pCompressedData = 0;
+
+	m_NumDatas++;
+	return m_NumDatas-1;
+}
 
-	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pData, Size); // ignore_convention
+void CDataFileWriter::CompressData(CDataInfo *pInfo)
+{
+	unsigned long s = compressBound(pInfo->m_UncompressedSize);
+	void *pCompData = mem_alloc_tag(s, 1, MEMTAG_MAP); // temporary buffer that we use during compression
+
+	int Result = compress2((Bytef*)pCompData, &s, (Bytef*)pInfo->m_pUncompressedData, pInfo->m_UncompressedSize, m_CompressionLevel); // ignore_convention
 	if(Result != Z_OK)
 	{
 		dbg_msg("datafile", "compression error %d", Result);
 		dbg_assert(0, "zlib error");
 	}
 
-	pInfo->m_UncompressedSize = Size;
+	// keep only what the compressed data needs until it's written
 	pInfo->m_CompressedSize = (int)s;
-	pInfo->m_pCompressedData = mem_alloc(pInfo->m_CompressedSize, 1);
+	pInfo->m_pCompressedData = mem_alloc_tag(max(pInfo->m_CompressedSize, 1), 1, MEMTAG_MAP);
 	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
 	mem_free(pCompData);
+	mem_free(pInfo->m_pUncompressedData);
+	pInfo->m_pUncompressedData = 0;
+}
 
-	m_NumDatas++;
-	return m_NumDatas-1;
+int CDataFileWriter::CompressDataThread(void *pUser)
+{
+	CDataFileWriter *pSelf = (CDataFileWriter *)pUser;
+	while(1)
+	{
+		int i = atomic_inc(&pSelf->m_NextCompress)-1;
+		if(i >= pSelf->m_NumDatas)
+			break;
+		pSelf->CompressData(&pSelf->m_pDatas[i]);
+	}
+	return 0;
 }
 
 int CDataFileWriter::AddDataSwapped(int Size, void *pData)
@@ -515,7 +706,7 @@ int CDataFileWriter::AddDataSwapped(int Size, void *pData)
 	dbg_assert(Size%sizeof(int) == 0, "incorrect boundary");
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
-	void *pSwapped = mem_alloc(Size, 1); // temporary buffer that we use during compression
+	void *pSwapped = mem_alloc_tag(Size, 1, MEMTAG_MAP); // temporary buffer that we use during compression
 	mem_copy(pSwapped, pData, Size);
 	swap_endian(pSwapped, sizeof(int), Size/sizeof(int));
 	int Index = AddData(Size, pSwapped);
@@ -536,6 +727,28 @@ int CDataFileWriter::Finish()
 	int DataSize = 0;
 	CDatafileHeader Header;
 
+	// compress the datas on the job pool and on this thread at the same time
+	m_NextCompress = 0;
+	if(m_pEngine && m_NumDatas > 1)
+	{
+		CJob aJobs[MAX_COMPRESS_JOBS];
+		int NumJobs = min((int)MAX_COMPRESS_JOBS, m_NumDatas-1);
+		for(int i = 0; i < NumJobs; i++)
+			m_pEngine->AddJob(&aJobs[i], CompressDataThread, this);
+		CompressDataThread(this);
+
+		// all datas are taken, jobs still queued behind others aren't needed anymore
+		for(int i = 0; i < NumJobs; i++)
+		{
+			if(m_pEngine->RemoveJob(&aJobs[i]))
+				continue;
+			while(aJobs[i].Status() != CJob::STATE_DONE)
+				thread_sleep(1);
+		}
+	}
+	else
+		CompressDataThread(this);
+
 	// we should now write this file!
 	if(DEBUG)
 		dbg_msg("datafile", "writing");
@@ -559,11 +772,13 @@ int CDataFileWriter::Finish()
 	FileSize = HeaderSize + TypesSize + OffsetSize + ItemSize + DataSize;
 	SwapSize = FileSize - DataSize;
 
-	(void)SwapSize;
-
 	if(DEBUG)
 		dbg_msg("datafile", "num_m_aItemTypes=%d TypesSize=%d m_aItemsize=%d DataSize=%d", m_NumItemTypes, TypesSize, ItemSize, DataSize);
 
+	// everything in front of the datas is put together in one buffer
+	char *pBuffer = (char *)mem_alloc_tag(SwapSize, 1, MEMTAG_MAP);
+	char *pWrite = pBuffer;
+
 	// construct Header
 	{
 		Header.m_aID[0] = 'D';
@@ -582,10 +797,8 @@ int CDataFileWriter::Finish()
 		// write Header
 		if(DEBUG)
 			dbg_msg("datafile", "HeaderSize=%d", sizeof(Header));
-#if defined(CONF_ARCH_ENDIAN_BIG)
-		swap_endian(&Header, sizeof(int), sizeof(Header)/sizeof(int));
-#endif
-		io_write(m_File, &Header, sizeof(Header));
+		mem_copy(pWrite, &Header, sizeof(Header));
+		pWrite += sizeof(Header);
 	}
 
 	// write types
@@ -600,10 +813,8 @@ int CDataFileWriter::Finish()
 			Info.m_Num = m_pItemTypes[i].m_Num;
 			if(DEBUG)
 				dbg_msg("datafile", "writing type=%x start=%d num=%d", Info.m_Type, Info.m_Start, Info.m_Num);
-#if defined(CONF_ARCH_ENDIAN_BIG)
-			swap_endian(&Info, sizeof(int), sizeof(CDatafileItemType)/sizeof(int));
-#endif
-			io_write(m_File, &Info, sizeof(Info));
+			mem_copy(pWrite, &Info, sizeof(Info));
+			pWrite += sizeof(Info);
 			Count += m_pItemTypes[i].m_Num;
 		}
 	}
@@ -619,11 +830,8 @@ int CDataFileWriter::Finish()
 			{
 				if(DEBUG)
 					dbg_msg("datafile", "writing item offset num=%d offset=%d", k, Offset);
-				int Temp = Offset;
-#if defined(CONF_ARCH_ENDIAN_BIG)
-				swap_endian(&Temp, sizeof(int), sizeof(Temp)/sizeof(int));
-#endif
-				io_write(m_File, &Temp, sizeof(Temp));
+				mem_copy(pWrite, &Offset, sizeof(Offset));
+				pWrite += sizeof(Offset);
 				Offset += m_pItems[k].m_Size + sizeof(CDatafileItem);
 
 				// next
@@ -637,11 +845,8 @@ int CDataFileWriter::Finish()
 	{
 		if(DEBUG)
 			dbg_msg("datafile", "writing data offset num=%d offset=%d", i, Offset);
-		int Temp = Offset;
-#if defined(CONF_ARCH_ENDIAN_BIG)
-		swap_endian(&Temp, sizeof(int), sizeof(Temp)/sizeof(int));
-#endif
-		io_write(m_File, &Temp, sizeof(Temp));
+		mem_copy(pWrite, &Offset, sizeof(Offset));
+		pWrite += sizeof(Offset);
 		Offset += m_pDatas[i].m_CompressedSize;
 	}
 
@@ -650,11 +855,8 @@ int CDataFileWriter::Finish()
 	{
 		if(DEBUG)
 			dbg_msg("datafile", "writing data uncompressed size num=%d size=%d", i, m_pDatas[i].m_UncompressedSize);
-		int UncompressedSize = m_pDatas[i].m_UncompressedSize;
-#if defined(CONF_ARCH_ENDIAN_BIG)
-		swap_endian(&UncompressedSize, sizeof(int), sizeof(UncompressedSize)/sizeof(int));
-#endif
-		io_write(m_File, &UncompressedSize, sizeof(UncompressedSize));
+		mem_copy(pWrite, &m_pDatas[i].m_UncompressedSize, sizeof(int));
+		pWrite += sizeof(int);
 	}
 
 	// write m_pItems
@@ -672,12 +874,10 @@ int CDataFileWriter::Finish()
 				if(DEBUG)
 					dbg_msg("datafile", "writing item type=%x idx=%d id=%d size=%d", i, k, m_pItems[k].m_ID, m_pItems[k].m_Size);
 
-#if defined(CONF_ARCH_ENDIAN_BIG)
-				swap_endian(&Item, sizeof(int), sizeof(Item)/sizeof(int));
-				swap_endian(m_pItems[k].m_pData, sizeof(int), m_pItems[k].m_Size/sizeof(int));
-#endif
-				io_write(m_File, &Item, sizeof(Item));
-				io_write(m_File, m_pItems[k].m_pData, m_pItems[k].m_Size);
+				mem_copy(pWrite, &Item, sizeof(Item));
+				pWrite += sizeof(Item);
+				mem_copy(pWrite, m_pItems[k].m_pData, m_pItems[k].m_Size);
+				pWrite += m_pItems[k].m_Size;
 
 				// next
 				k = m_pItems[k].m_Next;
@@ -685,19 +885,27 @@ int CDataFileWriter::Finish()
 		}
 	}
 
+	dbg_assert(pWrite == pBuffer+SwapSize, "datafile size mismatch");
+
+	// everything up to the datas consists of ints
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(pBuffer, sizeof(int), SwapSize/sizeof(int));
+#endif
+	io_write(m_File, pBuffer, SwapSize);
+	mem_free(pBuffer);
+
 	// write data
 	for(int i = 0; i < m_NumDatas; i++)
 	{
 		if(DEBUG)
 			dbg_msg("datafile", "writing data id=%d size=%d", i, m_pDatas[i].m_CompressedSize);
 		io_write(m_File, m_pDatas[i].m_pCompressedData, m_pDatas[i].m_CompressedSize);
+		mem_free(m_pDatas[i].m_pCompressedData);
 	}
 
 	// free data
 	for(int i = 0; i < m_NumItems; i++)
 		mem_free(m_pItems[i].m_pData);
-	for(int i = 0; i < m_NumDatas; ++i)
-		mem_free(m_pDatas[i].m_pCompressedData);
 
 	io_close(m_File);
 	m_File = 0;
@@ -6,8 +6,14 @@
 // raw datafile access
 class CDataFileReader
 {
+	enum
+	{
+		MAX_LOAD_JOBS=8,
+	};
+
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, int Swap);
+	static int LoadDataThread(void *pUser);
 public:
 	CDataFileReader() : m_pDataFile(0) {}
 	~CDataFileReader() { Close(); }
@@ -19,6 +25,7 @@ public:
 
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
+	void LoadData(class IEngine *pEngine, const int *pIndices, int NumIndices); // decompresses several datas in parallel
 	int GetDataSize(int Index) const;
 	void ReplaceData(int Index, char *pData);
 	void UnloadData(int Index);
@@ -31,6 +38,7 @@ public:
 	void Unload();
 
 	unsigned Crc() const;
+	void MemoryUsage(int *pMapped, int *pResident, int *pLoaded) const; // resident is -1 if unknown
 };
 
 // write access
@@ -40,6 +48,7 @@ class CDataFileWriter
 	{
 		int m_UncompressedSize;
 		int m_CompressedSize;
+		void *m_pUncompressedData; // kept until the data is compressed in Finish
 		void *m_pCompressedData;
 	};
 
@@ -65,9 +74,13 @@ class CDataFileWriter
 		MAX_ITEM_TYPES=0xffff,
 		MAX_ITEMS=1024,
 		MAX_DATAS=1024,
+		MAX_COMPRESS_JOBS=8,
 	};
 
 	IOHANDLE m_File;
+	class IEngine *m_pEngine;
+	int m_CompressionLevel;
+	volatile unsigned m_NextCompress;
 	int m_NumItems;
 	int m_NumDatas;
 	int m_NumItemTypes;
@@ -75,10 +88,21 @@ class CDataFileWriter
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
 
+	void CompressData(CDataInfo *pInfo);
+	static int CompressDataThread(void *pUser);
+
 public:
+	enum
+	{
+		COMPRESSION_DEFAULT=-1,
+		COMPRESSION_FASTEST=1,
+		COMPRESSION_BEST=9,
+	};
+
 	CDataFileWriter();
 	~CDataFileWriter();
-	bool Open(class IStorage *pStorage, const char *Filename);
+	// the datas are compressed in parallel on the job pool of pEngine, if given
+	bool Open(class IStorage *pStorage, const char *Filename, class IEngine *pEngine = 0, int CompressionLevel = COMPRESSION_DEFAULT);
 	int AddData(int Size, void *pData);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
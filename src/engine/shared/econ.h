@@ -43,6 +43,7 @@ class CEcon
 
 public:
 	IConsole *Console() { return m_pConsole; }
+	const CNetFilter *Filter() const { return m_Ready ? m_NetConsole.Filter() : 0; }
 
 	void Init(IConsole *pConsole, class CNetBan *pNetBan);
 	void Update();
@@ -46,7 +46,7 @@ public:
 		}
 	}
 
-	CEngine(const char *pAppname)
+	CEngine(const char *pAppname, int NumJobThreads)
 	{
 		srand(time_get());
 		dbg_logger_stdout();
@@ -66,7 +66,7 @@ public:
 		net_init();
 		CNetBase::Init();
 
-		m_JobPool.Init(1);
+		m_JobPool.Init(NumJobThreads);
 
 		m_Logging = false;
 	}
@@ -102,6 +102,11 @@ public:
 			dbg_msg("engine", "job added");
 		m_JobPool.Add(pJob, pfnFunc, pData);
 	}
+
+	bool RemoveJob(CJob *pJob)
+	{
+		return m_JobPool.Remove(pJob);
+	}
 };
 
-IEngine *CreateEngine(const char *pAppname) { return new CEngine(pAppname); }
+IEngine *CreateEngine(const char *pAppname, int NumJobThreads) { return new CEngine(pAppname, NumJobThreads); }
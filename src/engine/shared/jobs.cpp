@@ -7,7 +7,7 @@ CJobPool::CJobPool()
 {
 	// empty the pool
 	m_NumThreads = 0;
-	m_Shutdown = false;
+	m_Shutdown = 0;
 	m_Lock = lock_create();
 	m_pFirstJob = 0;
 	m_pLastJob = 0;
@@ -15,7 +15,7 @@ CJobPool::CJobPool()
 
 CJobPool::~CJobPool()
 {
-	m_Shutdown = true;
+	atomic_store(&m_Shutdown, 1, MEMORY_ORDER_RELEASE);
 	for(int i = 0; i < m_NumThreads; i++)
 	{
 		thread_wait(m_apThreads[i]);
@@ -28,7 +28,7 @@ void CJobPool::WorkerThread(void *pUser)
 {
 	CJobPool *pPool = (CJobPool *)pUser;
 
-	while(!pPool->m_Shutdown)
+	while(!atomic_load(&pPool->m_Shutdown, MEMORY_ORDER_ACQUIRE))
 	{
 		CJob *pJob = 0;
 
@@ -48,9 +48,9 @@ void CJobPool::WorkerThread(void *pUser)
 		// do the job if we have one
 		if(pJob)
 		{
-			pJob->m_Status = CJob::STATE_RUNNING;
+			atomic_store(&pJob->m_Status, CJob::STATE_RUNNING, MEMORY_ORDER_RELAXED);
 			pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
-			pJob->m_Status = CJob::STATE_DONE;
+			atomic_store(&pJob->m_Status, CJob::STATE_DONE, MEMORY_ORDER_RELEASE);
 		}
 		else
 			thread_sleep(10);
@@ -87,3 +87,29 @@ int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
 	return 0;
 }
 
+bool CJobPool::Remove(CJob *pJob)
+{
+	lock_wait(m_Lock);
+
+	// workers take jobs from the front, so a job without a previous one
+	// that isn't the first anymore has been taken
+	bool Queued = pJob->m_pPrev || m_pFirstJob == pJob;
+	if(Queued)
+	{
+		if(pJob->m_pPrev)
+			pJob->m_pPrev->m_pNext = pJob->m_pNext;
+		else
+			m_pFirstJob = pJob->m_pNext;
+		if(pJob->m_pNext)
+			pJob->m_pNext->m_pPrev = pJob->m_pPrev;
+		else
+			m_pLastJob = pJob->m_pPrev;
+		pJob->m_pPrev = 0;
+		pJob->m_pNext = 0;
+		atomic_store(&pJob->m_Status, CJob::STATE_DONE, MEMORY_ORDER_RELAXED);
+	}
+
+	lock_unlock(m_Lock);
+	return Queued;
+}
+
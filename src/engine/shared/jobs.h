@@ -2,6 +2,8 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef ENGINE_SHARED_JOBS_H
 #define ENGINE_SHARED_JOBS_H
+#include <base/tl/threading.h>
+
 typedef int (*JOBFUNC)(void *pData);
 
 class CJobPool;
@@ -13,8 +15,9 @@ class CJob
 	CJob *m_pPrev;
 	CJob *m_pNext;
 
-	volatile int m_Status;
-	volatile int m_Result;
+	// the result is written before the status turns done and read after
+	volatile unsigned m_Status;
+	int m_Result;
 
 	JOBFUNC m_pfnFunc;
 	void *m_pFuncData;
@@ -32,7 +35,7 @@ public:
 		STATE_DONE
 	};
 
-	int Status() const { return m_Status; }
+	int Status() const { return atomic_load(&m_Status, MEMORY_ORDER_ACQUIRE); }
 	int Result() const {return m_Result; }
 };
 
@@ -44,7 +47,7 @@ class CJobPool
 	};
 	int m_NumThreads;
 	void *m_apThreads[MAX_THREADS];
-	volatile bool m_Shutdown;
+	volatile unsigned m_Shutdown;
 
 	LOCK m_Lock;
 	CJob *m_pFirstJob;
@@ -58,5 +61,8 @@ public:
 
 	int Init(int NumThreads);
 	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+
+	// takes the job out of the queue when no worker has started it yet, it's done then
+	bool Remove(CJob *pJob);
 };
 #endif
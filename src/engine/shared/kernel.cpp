@@ -65,7 +65,9 @@ public:
 			return false;
 		}
 
-		pInterface->m_pKernel = this;
+		// an interface shared by several kernels stays with the one it was registered to first
+		if(!pInterface->m_pKernel)
+			pInterface->m_pKernel = this;
 		m_aInterfaces[m_NumInterfaces].m_pInterface = pInterface;
 		str_copy(m_aInterfaces[m_NumInterfaces].m_aName, pName, sizeof(m_aInterfaces[m_NumInterfaces].m_aName));
 		m_NumInterfaces++;
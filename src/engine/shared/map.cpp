@@ -1,6 +1,8 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
+#include <engine/engine.h>
 #include <engine/map.h>
 #include <engine/storage.h>
 #include <game/mapitems.h>
@@ -14,6 +16,10 @@ public:
 
 	virtual void *GetData(int Index) { return m_DataFile.GetData(Index); }
 	virtual void *GetDataSwapped(int Index) { return m_DataFile.GetDataSwapped(Index); }
+	virtual void LoadData(const int *pIndices, int NumIndices)
+	{
+		m_DataFile.LoadData(Kernel() ? Kernel()->RequestInterface<IEngine>() : 0, pIndices, NumIndices);
+	}
 	virtual void UnloadData(int Index) { m_DataFile.UnloadData(Index); }
 	virtual void *GetItem(int Index, int *pType, int *pID) { return m_DataFile.GetItem(Index, pType, pID); }
 	virtual void GetType(int Type, int *pStart, int *pNum) { m_DataFile.GetType(Type, pStart, pNum); }
@@ -42,6 +48,19 @@ public:
 		int GroupsStart, GroupsNum, LayersStart, LayersNum;
 		m_DataFile.GetType(MAPITEMTYPE_GROUP, &GroupsStart, &GroupsNum);
 		m_DataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+
+		// inflate the tile data of all layers at once
+		int *pTileData = static_cast<int *>(mem_alloc_tag(max(LayersNum, 1)*sizeof(int), 1, MEMTAG_MAP));
+		int NumTileData = 0;
+		for(int l = 0; l < LayersNum; l++)
+		{
+			CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(m_DataFile.GetItem(LayersStart + l, 0, 0));
+			if(pLayer->m_Type == LAYERTYPE_TILES)
+				pTileData[NumTileData++] = reinterpret_cast<CMapItemLayerTilemap *>(pLayer)->m_Data;
+		}
+		LoadData(pTileData, NumTileData);
+		mem_free(pTileData);
+
 		for(int g = 0; g < GroupsNum; g++)
 		{
 			CMapItemGroup *pGroup = static_cast<CMapItemGroup *>(m_DataFile.GetItem(GroupsStart + g, 0, 0));
@@ -55,7 +74,7 @@ public:
 					
 					if(pTilemap->m_Version > 3)
 					{
-						CTile *pTiles = static_cast<CTile *>(mem_alloc(pTilemap->m_Width * pTilemap->m_Height * sizeof(CTile), 1));
+						CTile *pTiles = static_cast<CTile *>(mem_alloc_tag(pTilemap->m_Width * pTilemap->m_Height * sizeof(CTile), 1, MEMTAG_MAP));
 
 						// extract original tile data
 						int i = 0;
@@ -90,6 +109,11 @@ public:
 	{
 		return m_DataFile.Crc();
 	}
+
+	virtual void MemoryUsage(int *pMapped, int *pResident, int *pLoaded)
+	{
+		m_DataFile.MemoryUsage(pMapped, pResident, pLoaded);
+	}
 };
 
 extern IEngineMap *CreateEngineMap() { return new CMap; }
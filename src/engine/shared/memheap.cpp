@@ -5,13 +5,28 @@
 
 
 // allocates a new chunk to be used
-void CHeap::NewChunk()
+void CHeap::NewChunk(unsigned MinSize)
 {
 	CChunk *pChunk;
 	char *pMem;
 
-	// allocate memory
-	pMem = (char*)mem_alloc(sizeof(CChunk)+CHUNK_SIZE, 1);
+	// take a spare chunk if one is large enough
+	for(CChunk **ppSpare = &m_pSpare; *ppSpare; ppSpare = &(*ppSpare)->m_pNext)
+	{
+		pChunk = *ppSpare;
+		if((unsigned)(pChunk->m_pEnd-pChunk->m_pMemory) >= MinSize)
+		{
+			*ppSpare = pChunk->m_pNext;
+			pChunk->m_pCurrent = pChunk->m_pMemory;
+			pChunk->m_pNext = m_pCurrent;
+			m_pCurrent = pChunk;
+			return;
+		}
+	}
+
+	// allocate memory, large allocations get a chunk of their size
+	unsigned Size = MinSize > (unsigned)CHUNK_SIZE ? MinSize : (unsigned)CHUNK_SIZE;
+	pMem = (char*)mem_alloc_tag(sizeof(CChunk)+Size, 1, MEMTAG_HEAP);
 	if(!pMem)
 		return;
 
@@ -20,25 +35,33 @@ void CHeap::NewChunk()
 	pChunk = (CChunk*)pMem;
 	pChunk->m_pMemory = (char*)(pChunk+1);
 	pChunk->m_pCurrent = pChunk->m_pMemory;
-	pChunk->m_pEnd = pChunk->m_pMemory + CHUNK_SIZE;
-	pChunk->m_pNext = (CChunk *)0x0;
-
+	pChunk->m_pEnd = pChunk->m_pMemory + Size;
 	pChunk->m_pNext = m_pCurrent;
 	m_pCurrent = pChunk;
+	m_Size += Size;
 }
 
 //****************
-void *CHeap::AllocateFromChunk(unsigned int Size)
+void *CHeap::AllocateFromChunk(unsigned int Size, unsigned Alignment)
 {
 	char *pMem;
 
+	if(!m_pCurrent)
+		return (void*)0x0;
+
+	// the chunk memory starts 16 byte aligned, so aligning the offset is enough
+	unsigned Offset = (m_pCurrent->m_pCurrent - m_pCurrent->m_pMemory + Alignment-1) & ~(Alignment-1);
+
 	// check if we need can fit the allocation
-	if(m_pCurrent->m_pCurrent + Size > m_pCurrent->m_pEnd)
+	if(Offset + Size > (unsigned)(m_pCurrent->m_pEnd - m_pCurrent->m_pMemory))
 		return (void*)0x0;
 
 	// get memory and move the pointer forward
-	pMem = m_pCurrent->m_pCurrent;
-	m_pCurrent->m_pCurrent += Size;
+	pMem = m_pCurrent->m_pMemory + Offset;
+	m_Used += pMem + Size - m_pCurrent->m_pCurrent;
+	m_pCurrent->m_pCurrent = pMem + Size;
+	if(m_Used > m_HighWater)
+		m_HighWater = m_Used;
 	return pMem;
 }
 
@@ -46,6 +69,10 @@ void *CHeap::AllocateFromChunk(unsigned int Size)
 CHeap::CHeap()
 {
 	m_pCurrent = 0x0;
+	m_pSpare = 0x0;
+	m_Used = 0;
+	m_HighWater = 0;
+	m_Size = 0;
 	Reset();
 }
 
@@ -56,41 +83,89 @@ CHeap::~CHeap()
 
 void CHeap::Reset()
 {
-	Clear();
-	NewChunk();
+	// go back to the start of the oldest chunk and free all others
+	CChunk *pFirst = m_pCurrent;
+	while(pFirst && pFirst->m_pNext)
+		pFirst = pFirst->m_pNext;
+	if(pFirst)
+	{
+		CMark Start = { pFirst, pFirst->m_pMemory, 0 };
+		Rewind(Start);
+	}
+
+	while(m_pSpare)
+	{
+		CChunk *pNext = m_pSpare->m_pNext;
+		m_Size -= m_pSpare->m_pEnd - m_pSpare->m_pMemory;
+		mem_free(m_pSpare);
+		m_pSpare = pNext;
+	}
+
+	if(!m_pCurrent)
+		NewChunk(CHUNK_SIZE);
 }
 
 // destroys the heap
 void CHeap::Clear()
 {
-	CChunk *pChunk = m_pCurrent;
-	CChunk *pNext;
-
-	while(pChunk)
+	CChunk *apLists[2] = { m_pCurrent, m_pSpare };
+	for(int i = 0; i < 2; i++)
 	{
-		pNext = pChunk->m_pNext;
-		mem_free(pChunk);
-		pChunk = pNext;
+		CChunk *pChunk = apLists[i];
+		CChunk *pNext;
+
+		while(pChunk)
+		{
+			pNext = pChunk->m_pNext;
+			mem_free(pChunk);
+			pChunk = pNext;
+		}
 	}
 
 	m_pCurrent = 0x0;
+	m_pSpare = 0x0;
+	m_Used = 0;
+	m_Size = 0;
 }
 
 //
-void *CHeap::Allocate(unsigned Size)
+void *CHeap::Allocate(unsigned Size, unsigned Alignment)
 {
 	char *pMem;
 
 	// try to allocate from current chunk
-	pMem = (char *)AllocateFromChunk(Size);
+	pMem = (char *)AllocateFromChunk(Size, Alignment);
 	if(!pMem)
 	{
 		// allocate new chunk and add it to the heap
-		NewChunk();
+		NewChunk(Size);
 
 		// try to allocate again
-		pMem = (char *)AllocateFromChunk(Size);
+		pMem = (char *)AllocateFromChunk(Size, Alignment);
 	}
 
 	return pMem;
 }
+
+CHeap::CMark CHeap::Mark() const
+{
+	CMark Mark = { m_pCurrent, m_pCurrent ? m_pCurrent->m_pCurrent : 0x0, m_Used };
+	return Mark;
+}
+
+// Reset() frees chunks, marks from before it can't be used anymore
+void CHeap::Rewind(const CMark &Mark)
+{
+	// chunks started after the mark are kept for later
+	while(m_pCurrent && m_pCurrent != Mark.m_pChunk)
+	{
+		CChunk *pChunk = m_pCurrent;
+		m_pCurrent = pChunk->m_pNext;
+		pChunk->m_pNext = m_pSpare;
+		m_pSpare = pChunk;
+	}
+
+	if(m_pCurrent)
+		m_pCurrent->m_pCurrent = Mark.m_pCurrent;
+	m_Used = Mark.m_Used;
+}
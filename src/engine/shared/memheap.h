@@ -19,16 +19,56 @@ class CHeap
 	};
 
 	CChunk *m_pCurrent;
+	CChunk *m_pSpare; // chunks given back by Rewind(), used again before new ones get allocated
 
+	unsigned m_Used;
+	unsigned m_HighWater;
+	unsigned m_Size;
 
 	void Clear();
-	void NewChunk();
-	void *AllocateFromChunk(unsigned int Size);
+	void NewChunk(unsigned MinSize);
+	void *AllocateFromChunk(unsigned Size, unsigned Alignment);
 
 public:
+	// a position in the heap, everything allocated after it can be given back at once
+	struct CMark
+	{
+		CChunk *m_pChunk;
+		char *m_pCurrent;
+		unsigned m_Used;
+	};
+
 	CHeap();
 	~CHeap();
+
+	// gives back everything, keeps one chunk for the next allocations
 	void Reset();
-	void *Allocate(unsigned Size);
+
+	// alignment has to be a power of two and at most 16, allocations larger than a chunk get their own one
+	void *Allocate(unsigned Size, unsigned Alignment = sizeof(void *));
+
+	CMark Mark() const;
+	void Rewind(const CMark &Mark);
+
+	// bytes handed out right now, the most ever handed out and the size of all chunks
+	unsigned Used() const { return m_Used; }
+	unsigned HighWater() const { return m_HighWater; }
+	unsigned Size() const { return m_Size; }
+};
+
+// gives back everything allocated from a heap while it lives, for per tick or per frame temporaries
+class CHeapScope
+{
+	CHeap *m_pHeap;
+	CHeap::CMark m_Mark;
+
+public:
+	CHeapScope(CHeap *pHeap)
+	{
+		m_pHeap = pHeap;
+		m_Mark = pHeap->Mark();
+	}
+
+	~CHeapScope() { m_pHeap->Rewind(m_Mark); }
 };
 #endif
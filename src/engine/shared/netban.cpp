@@ -1,3 +1,5 @@
+#include <stdlib.h> // qsort
+
 #include <base/math.h>
 
 #include <engine/console.h>
@@ -117,6 +119,7 @@ typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData,
 
 	// update ban count
 	++m_CountUsed;
+	mem_track(MEMTAG_BANS, sizeof(CBan<T>));
 
 	return pBan;
 }
@@ -153,6 +156,7 @@ int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
 
 	// update ban count
 	--m_CountUsed;
+	mem_track(MEMTAG_BANS, -(int)sizeof(CBan<T>));
 
 	return 0;
 }
@@ -317,6 +321,7 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	pBan = pBanPool->Add(pData, &Info, &NetHash);
 	if(pBan)
 	{
+		m_IntervalsDirty = true;
 		char aBuf[128];
 		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
@@ -337,6 +342,7 @@ int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 		char aBuf[256];
 		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANREM);
 		pBanPool->Remove(pBan);
+		m_IntervalsDirty = true;
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 		return 0;
 	}
@@ -351,6 +357,8 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	m_pStorage = pStorage;
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
+	m_NumIntervals = 0;
+	m_IntervalsDirty = true;
 
 	net_host_lookup("localhost", &m_LocalhostIPV4, NETTYPE_IPV4);
 	net_host_lookup("localhost", &m_LocalhostIPV6, NETTYPE_IPV6);
@@ -375,12 +383,14 @@ void CNetBan::Update()
 		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanAddrPool.First()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 		m_BanAddrPool.Remove(m_BanAddrPool.First());
+		m_IntervalsDirty = true;
 	}
 	while(m_BanRangePool.First() && m_BanRangePool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanRangePool.First()->m_Info.m_Expires < Now)
 	{
 		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanRangePool.First()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 		m_BanRangePool.Remove(m_BanRangePool.First());
+		m_IntervalsDirty = true;
 	}
 }
 
@@ -437,6 +447,7 @@ int CNetBan::UnbanByIndex(int Index)
 		}
 	}
 
+	m_IntervalsDirty = true;
 	char aMsg[256];
 	str_format(aMsg, sizeof(aMsg), "unbanned index %i (%s)", Index, aBuf);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aMsg);
@@ -445,8 +456,13 @@ int CNetBan::UnbanByIndex(int Index)
 
 void CNetBan::UnbanAll()
 {
+	for(int i = 0; i < m_BanAddrPool.Num(); i++)
+		mem_track(MEMTAG_BANS, -(int)sizeof(CBanAddr));
+	for(int i = 0; i < m_BanRangePool.Num(); i++)
+		mem_track(MEMTAG_BANS, -(int)sizeof(CBanRange));
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
+	m_IntervalsDirty = true;
 }
 
 bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const
@@ -478,6 +494,68 @@ bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) co
 	return false;
 }
 
+int CNetBan::IntervalComp(const NETADDR *pAddr1, const NETADDR *pAddr2)
+{
+	if(pAddr1->type != pAddr2->type)
+		return pAddr1->type < pAddr2->type ? -1 : 1;
+	return mem_comp(pAddr1->ip, pAddr2->ip, pAddr1->type==NETTYPE_IPV4 ? 4 : 16);
+}
+
+int CNetBan::IntervalSortComp(const void *pInterval1, const void *pInterval2)
+{
+	return IntervalComp(&((const CInterval *)pInterval1)->m_LB, &((const CInterval *)pInterval2)->m_LB);
+}
+
+void CNetBan::BuildIntervals()
+{
+	m_NumIntervals = 0;
+	for(CBanAddr *pBan = m_BanAddrPool.First(); pBan && m_NumIntervals < MAX_INTERVALS; pBan = pBan->m_pNext, m_NumIntervals++)
+	{
+		m_aIntervals[m_NumIntervals].m_LB = pBan->m_Data;
+		m_aIntervals[m_NumIntervals].m_UB = pBan->m_Data;
+	}
+	for(CBanRange *pBan = m_BanRangePool.First(); pBan && m_NumIntervals < MAX_INTERVALS; pBan = pBan->m_pNext, m_NumIntervals++)
+	{
+		m_aIntervals[m_NumIntervals].m_LB = pBan->m_Data.m_LB;
+		m_aIntervals[m_NumIntervals].m_UB = pBan->m_Data.m_UB;
+	}
+	qsort(m_aIntervals, m_NumIntervals, sizeof(CInterval), IntervalSortComp);
+
+	// merge overlapping intervals, then they are sorted by their upper bound too
+	int Num = 0;
+	for(int i = 0; i < m_NumIntervals; i++)
+	{
+		CInterval *pLast = Num > 0 ? &m_aIntervals[Num-1] : 0;
+		if(pLast && pLast->m_LB.type == m_aIntervals[i].m_LB.type && IntervalComp(&m_aIntervals[i].m_LB, &pLast->m_UB) <= 0)
+		{
+			if(IntervalComp(&m_aIntervals[i].m_UB, &pLast->m_UB) > 0)
+				pLast->m_UB = m_aIntervals[i].m_UB;
+		}
+		else
+			m_aIntervals[Num++] = m_aIntervals[i];
+	}
+	m_NumIntervals = Num;
+	m_IntervalsDirty = false;
+}
+
+bool CNetBan::IsBannedQuick(const NETADDR *pAddr)
+{
+	if(m_IntervalsDirty)
+		BuildIntervals();
+
+	// find the last interval starting at or before the address
+	int Low = 0, High = m_NumIntervals;
+	while(Low < High)
+	{
+		int Mid = (Low+High)/2;
+		if(IntervalComp(&m_aIntervals[Mid].m_LB, pAddr) <= 0)
+			Low = Mid+1;
+		else
+			High = Mid;
+	}
+	return Low > 0 && m_aIntervals[Low-1].m_LB.type == pAddr->type && IntervalComp(pAddr, &m_aIntervals[Low-1].m_UB) <= 0;
+}
+
 void CNetBan::ConBan(IConsole::IResult *pResult, void *pUser)
 {
 	CNetBan *pThis = static_cast<CNetBan *>(pUser);
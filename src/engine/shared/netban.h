@@ -157,6 +157,27 @@ protected:
 	CBanRangePool m_BanRangePool;
 	NETADDR m_LocalhostIPV4, m_LocalhostIPV6;
 
+	// all bans as sorted, merged intervals so a packet can be checked
+	// with a binary search before it gets decoded
+	enum
+	{
+		MAX_INTERVALS=2048,
+	};
+
+	struct CInterval
+	{
+		NETADDR m_LB;
+		NETADDR m_UB;
+	};
+
+	CInterval m_aIntervals[MAX_INTERVALS];
+	int m_NumIntervals;
+	bool m_IntervalsDirty;
+
+	static int IntervalComp(const NETADDR *pAddr1, const NETADDR *pAddr2);
+	static int IntervalSortComp(const void *pInterval1, const void *pInterval2);
+	void BuildIntervals();
+
 public:
 	enum
 	{
@@ -180,6 +201,7 @@ public:
 	int UnbanByIndex(int Index);
 	void UnbanAll();
 	bool IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const;
+	bool IsBannedQuick(const NETADDR *pAddr);
 
 	static void ConBan(class IConsole::IResult *pResult, void *pUser);
 	static void ConBanRange(class IConsole::IResult *pResult, void *pUser);
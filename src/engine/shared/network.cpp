@@ -120,14 +120,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketCons
 	int FinalSize = -1;
 
 	// log the data
-	if(ms_DataLogSent)
-	{
-		int Type = 1;
-		io_write(ms_DataLogSent, &Type, sizeof(Type));
-		io_write(ms_DataLogSent, &pPacket->m_DataSize, sizeof(pPacket->m_DataSize));
-		io_write(ms_DataLogSent, &pPacket->m_aChunkData, pPacket->m_DataSize);
-		io_flush(ms_DataLogSent);
-	}
+	LogData(&ms_DataLogSent, 1, pPacket->m_aChunkData, pPacket->m_DataSize);
 
 	dbg_assert((pPacket->m_Token&~NET_TOKEN_MASK) == 0, "token out of range");
 
@@ -168,14 +161,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketCons
 		net_udp_send(Socket, pAddr, aBuffer, FinalSize);
 
 		// log raw socket data
-		if(ms_DataLogSent)
-		{
-			int Type = 0;
-			io_write(ms_DataLogSent, &Type, sizeof(Type));
-			io_write(ms_DataLogSent, &FinalSize, sizeof(FinalSize));
-			io_write(ms_DataLogSent, aBuffer, FinalSize);
-			io_flush(ms_DataLogSent);
-		}
+		LogData(&ms_DataLogSent, 0, aBuffer, FinalSize);
 	}
 }
 
@@ -183,14 +169,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketCons
 int CNetBase::UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct *pPacket)
 {
 	// log the data
-	if(ms_DataLogRecv)
-	{
-		int Type = 0;
-		io_write(ms_DataLogRecv, &Type, sizeof(Type));
-		io_write(ms_DataLogRecv, &Size, sizeof(Size));
-		io_write(ms_DataLogRecv, pBuffer, Size);
-		io_flush(ms_DataLogRecv);
-	}
+	LogData(&ms_DataLogRecv, 0, pBuffer, Size);
 
 	// check the size
 	if(Size < NET_PACKETHEADERSIZE || Size > NET_MAX_PACKETSIZE)
@@ -277,14 +256,7 @@ int CNetBase::UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct
 	}
 
 	// log the data
-	if(ms_DataLogRecv)
-	{
-		int Type = 1;
-		io_write(ms_DataLogRecv, &Type, sizeof(Type));
-		io_write(ms_DataLogRecv, &pPacket->m_DataSize, sizeof(pPacket->m_DataSize));
-		io_write(ms_DataLogRecv, pPacket->m_aChunkData, pPacket->m_DataSize);
-		io_flush(ms_DataLogRecv);
-	}
+	LogData(&ms_DataLogRecv, 1, pPacket->m_aChunkData, pPacket->m_DataSize);
 
 	// return success
 	return 0;
@@ -312,7 +284,7 @@ void CNetBase::SendControlMsgWithToken(NETSOCKET Socket, const NETADDR *pAddr, T
 	dbg_assert((Token&~NET_TOKEN_MASK) == 0, "token out of range");
 	dbg_assert((MyToken&~NET_TOKEN_MASK) == 0, "resp token out of range");
 
-	static unsigned char aBuf[NET_TOKENREQUEST_DATASIZE] = { 0 };
+	unsigned char aBuf[NET_TOKENREQUEST_DATASIZE] = { 0 };
 	aBuf[0] = (MyToken>>24)&0xff;
 	aBuf[1] = (MyToken>>16)&0xff;
 	aBuf[2] = (MyToken>>8)&0xff;
@@ -366,13 +338,32 @@ int CNetBase::IsSeqInBackroom(int Seq, int Ack)
 	return 0;
 }
 
+LOCK CNetBase::ms_DataLogLock = 0;
 IOHANDLE CNetBase::ms_DataLogSent = 0;
 IOHANDLE CNetBase::ms_DataLogRecv = 0;
 CHuffman CNetBase::ms_Huffman;
 
 
+void CNetBase::LogData(IOHANDLE *pLog, int Type, const void *pData, int Size)
+{
+	// checked again under the lock, the log can be closed in between
+	if(!*pLog)
+		return;
+
+	lock_wait(ms_DataLogLock);
+	if(*pLog)
+	{
+		io_write(*pLog, &Type, sizeof(Type));
+		io_write(*pLog, &Size, sizeof(Size));
+		io_write(*pLog, pData, Size);
+		io_flush(*pLog);
+	}
+	lock_unlock(ms_DataLogLock);
+}
+
 void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
 {
+	lock_wait(ms_DataLogLock);
 	if(DataLogSent)
 	{
 		ms_DataLogSent = DataLogSent;
@@ -388,10 +379,12 @@ void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
 	}
 	else
 		dbg_msg("network", "failed to start logging recv packages");
+	lock_unlock(ms_DataLogLock);
 }
 
 void CNetBase::CloseLog()
 {
+	lock_wait(ms_DataLogLock);
 	if(ms_DataLogSent)
 	{
 		dbg_msg("network", "stopped logging sent packages");
@@ -405,6 +398,7 @@ void CNetBase::CloseLog()
 		io_close(ms_DataLogRecv);
 		ms_DataLogRecv = 0;
 	}
+	lock_unlock(ms_DataLogLock);
 }
 
 int CNetBase::Compress(const void *pData, int DataSize, void *pOutput, int OutputSize)
@@ -435,5 +429,7 @@ static const unsigned gs_aFreqTable[256+1] = {
 
 void CNetBase::Init()
 {
+	if(!ms_DataLogLock)
+		ms_DataLogLock = lock_create();
 	ms_Huffman.Init(gs_aFreqTable);
 }
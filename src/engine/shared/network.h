@@ -3,6 +3,8 @@
 #ifndef ENGINE_SHARED_NETWORK_H
 #define ENGINE_SHARED_NETWORK_H
 
+#include <base/tl/threading.h>
+
 #include "ringbuffer.h"
 #include "huffman.h"
 
@@ -239,10 +241,10 @@ private:
 	class CConnlessPacketInfo
 	{
 	private:
-		static int m_UniqueID;
+		static volatile unsigned m_UniqueID; // shared by all servers of a process
 
 	public:
-		CConnlessPacketInfo() : m_TrackID(CConnlessPacketInfo::m_UniqueID++) {}
+		CConnlessPacketInfo() : m_TrackID(atomic_inc(&CConnlessPacketInfo::m_UniqueID)-1) {}
 
 		NETADDR m_Addr;
 		int m_DataSize;
@@ -305,11 +307,28 @@ private:
 	NETSOCKET m_Socket;
 	NETSTATS m_Stats;
 
+	// round trip estimation (rfc 6298), 0 until the first sample
+	int64 m_Srtt;
+	int64 m_RttVar;
+	int64 m_RttMin;
+	int64 m_Rto;
+
+	// vital chunk accounting
+	int m_NumVitalSent;
+	int m_NumResent;
+	int m_NumGaps;
+	int m_LossVitalSent;
+	int m_LossResent;
+	int64 m_LossUpdateTime;
+	float m_LossRate;
+
 	//
 	void Reset();
 	void ResetStats();
 	void SetError(const char *pString);
 	void AckChunks(int Ack);
+	void UpdateRtt(int64 Sample);
+	void UpdateLoss(int64 Now);
 
 	int QueueChunkEx(int Flags, int DataSize, const void *pData, int Sequence);
 	void SendControl(int ControlMsg, const void *pExtra, int ExtraSize);
@@ -350,6 +369,14 @@ public:
 	int64 ConnectTime() const { return m_LastUpdateTime; }
 
 	int AckSequence() const { return m_Ack; }
+
+	// link quality, times in milliseconds
+	int Rtt() const { return (int)(m_Srtt*1000/time_freq()); }
+	int RttVar() const { return (int)(m_RttVar*1000/time_freq()); }
+	int Rto() const { return (int)(m_Rto*1000/time_freq()); }
+	float LossRate() const { return m_LossRate; }
+	int NumResent() const { return m_NumResent; }
+	int NumGaps() const { return m_NumGaps; }
 };
 
 class CConsoleNetConnection
@@ -400,6 +427,92 @@ public:
 	int FetchChunk(CNetChunk *pChunk);
 };
 
+// open addressing hash table from addresses to small values. an empty
+// table is all zero
+class CNetAddrTable
+{
+	enum
+	{
+		SIZE=NET_MAX_CLIENTS*4, // power of two, at most a quarter full
+	};
+
+	struct CEntry
+	{
+		NETADDR m_Addr;
+		int m_Value;
+		bool m_Used;
+	};
+
+	CEntry m_aEntries[SIZE];
+
+	static unsigned Hash(const NETADDR *pAddr);
+	int Index(const NETADDR *pAddr) const;
+
+public:
+	void Clear() { mem_zero(m_aEntries, sizeof(m_aEntries)); }
+
+	// returns -1 if the address is not in the table
+	int Find(const NETADDR *pAddr) const;
+	// returns false if the table is full
+	bool Set(const NETADDR *pAddr, int Value);
+	void Remove(const NETADDR *pAddr);
+};
+
+// first look at every packet, before it gets decoded. limits the packets of
+// each address and network with token buckets and drops those of banned
+// addresses
+class CNetFilter
+{
+public:
+	enum
+	{
+		DROP_BANNED=0,
+		DROP_RATE_ADDR,
+		DROP_RATE_NET,
+		DROP_INVALID,
+		NUM_DROPS
+	};
+
+private:
+	enum
+	{
+		NUM_BUCKETS=1024, // power of two
+	};
+
+	struct CBucket
+	{
+		NETADDR m_Prefix;
+		int64 m_Time;
+		int64 m_BanReplyTime;
+		float m_Tokens;
+	};
+
+	CBucket m_aAddrBuckets[NUM_BUCKETS];
+	CBucket m_aNetBuckets[NUM_BUCKETS];
+	int64 m_aKey[2];
+	int m_AddrRate;
+	int m_NetRate;
+	int m_aDrops[NUM_DROPS];
+
+	class CNetBan *m_pNetBan;
+
+	CBucket *Bucket(CBucket *pBuckets, const NETADDR *pPrefix, int Rate, int64 Now);
+	static bool Take(CBucket *pBucket, int Rate, int64 Now);
+
+public:
+	void Init(class CNetBan *pNetBan, int AddrRate, int NetRate);
+	void SetRates(int AddrRate, int NetRate) { m_AddrRate = AddrRate; m_NetRate = NetRate; }
+
+	// returns -1 if the packet may pass, the drop reason otherwise. packets
+	// of banned addresses pass once a second to tell them about the ban.
+	// known addresses (connected clients) skip the rate limits
+	int Check(const NETADDR *pAddr, bool Known, bool *pBanned);
+	void CountDrop(int Reason) { m_aDrops[Reason]++; }
+
+	int Drops(int Reason) const { return m_aDrops[Reason]; }
+	static const char *DropName(int Reason);
+};
+
 // server side
 class CNetServer
 {
@@ -407,6 +520,7 @@ class CNetServer
 	{
 	public:
 		CNetConnection m_Connection;
+		NETADDR m_Addr; // address in the tables, zero when the slot is free
 	};
 
 	NETSOCKET m_Socket;
@@ -415,11 +529,20 @@ class CNetServer
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
 
+	// finds the slot of an address and counts the clients of each ip
+	CNetAddrTable m_SlotTable;
+	CNetAddrTable m_IPTable;
+
+	int FindSlot(const NETADDR *pAddr) const;
+	bool AddSlot(int ClientID, const NETADDR *pAddr);
+	void RemoveSlot(int ClientID);
+
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_DELCLIENT m_pfnDelClient;
 	void *m_UserPtr;
 
 	CNetRecvUnpacker m_RecvUnpacker;
+	CNetFilter m_Filter;
 
 	CNetTokenManager m_TokenManager;
 	CNetTokenCache m_TokenCache;
@@ -443,13 +566,16 @@ public:
 
 	// status requests
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
+	const CNetConnection *Connection(int ClientID) const { return &m_aSlots[ClientID].m_Connection; }
 	NETSOCKET Socket() const { return m_Socket; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
 	int NetType() const { return m_Socket.type; }
 	int MaxClients() const { return m_MaxClients; }
+	const CNetFilter *Filter() const { return &m_Filter; }
 
 	//
 	void SetMaxClientsPerIP(int Max);
+	void SetPacketRates(int AddrRate, int NetRate) { m_Filter.SetRates(AddrRate, NetRate); }
 };
 
 class CNetConsole
@@ -468,8 +594,16 @@ class CNetConsole
 	void *m_UserPtr;
 
 	CNetRecvUnpacker m_RecvUnpacker;
+	CNetFilter m_Filter;
 
 public:
+	enum
+	{
+		// connection attempts per second
+		ACCEPT_RATE_ADDR=4,
+		ACCEPT_RATE_NET=16,
+	};
+
 	void SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
 	//
@@ -488,6 +622,7 @@ public:
 	// status requests
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
 	class CNetBan *NetBan() const { return m_pNetBan; }
+	const CNetFilter *Filter() const { return &m_Filter; }
 };
 
 
@@ -528,6 +663,7 @@ public:
 	int State() const;
 	bool GotProblems() const;
 	const char *ErrorString() const;
+	const CNetConnection *Connection() const { return &m_Connection; }
 };
 
 
@@ -535,9 +671,13 @@ public:
 // TODO: both, fix these. This feels like a junk class for stuff that doesn't fit anywere
 class CNetBase
 {
+	// the logs are shared by all servers of a process, the lock keeps their records whole
+	static LOCK ms_DataLogLock;
 	static IOHANDLE ms_DataLogSent;
 	static IOHANDLE ms_DataLogRecv;
 	static CHuffman ms_Huffman;
+
+	static void LogData(IOHANDLE *pLog, int Type, const void *pData, int Size);
 public:
 	static void OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv);
 	static void CloseLog();
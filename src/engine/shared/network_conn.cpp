@@ -29,6 +29,18 @@ void CNetConnection::Reset()
 	m_Buffer.Init();
 
 	mem_zero(&m_Construct, sizeof(m_Construct));
+
+	m_Srtt = 0;
+	m_RttVar = 0;
+	m_RttMin = 0;
+	m_Rto = time_freq();
+	m_NumVitalSent = 0;
+	m_NumResent = 0;
+	m_NumGaps = 0;
+	m_LossVitalSent = 0;
+	m_LossResent = 0;
+	m_LossUpdateTime = time_get();
+	m_LossRate = 0.0f;
 }
 
 void CNetConnection::SetToken(TOKEN Token)
@@ -66,6 +78,8 @@ void CNetConnection::Init(NETSOCKET Socket, bool BlockCloseMsg)
 
 void CNetConnection::AckChunks(int Ack)
 {
+	int64 Now = time_get();
+	int64 Sample = -1;
 	while(1)
 	{
 		CNetChunkResend *pResend = m_Buffer.First();
@@ -73,14 +87,62 @@ void CNetConnection::AckChunks(int Ack)
 			break;
 
 		if(CNetBase::IsSeqInBackroom(pResend->m_Sequence, Ack))
+		{
+			// only chunks that were never resent give a clear sample (karn)
+			if(pResend->m_FirstSendTime == pResend->m_LastSendTime)
+				Sample = Now-pResend->m_FirstSendTime;
 			m_Buffer.PopFirst();
+		}
 		else
 			break;
 	}
+
+	if(Sample >= 0)
+		UpdateRtt(Sample);
+}
+
+void CNetConnection::UpdateRtt(int64 Sample)
+{
+	Sample = max(Sample, (int64)1);
+	if(!m_Srtt)
+	{
+		m_Srtt = Sample;
+		m_RttVar = Sample/2;
+		m_RttMin = Sample;
+	}
+	else
+	{
+		m_RttVar = (3*m_RttVar + absolute(m_Srtt-Sample))/4;
+		m_Srtt = (7*m_Srtt + Sample)/8;
+		m_RttMin = min(m_RttMin, Sample);
+	}
+
+	// the peer acks with its next tick, so a tick is our clock granularity.
+	// the upper bound is the old fixed resend time
+	m_Rto = clamp(m_Srtt + max(time_freq()/50, 4*m_RttVar), time_freq()/10, time_freq());
+}
+
+void CNetConnection::UpdateLoss(int64 Now)
+{
+	if(Now-m_LossUpdateTime < time_freq())
+		return;
+
+	// share of vital chunks that had to be resent, smoothed over a few seconds
+	int Sent = m_NumVitalSent-m_LossVitalSent;
+	int Resent = m_NumResent-m_LossResent;
+	float Loss = Sent ? min(Resent/(float)Sent, 1.0f) : 0.0f;
+	if(Sent || Resent)
+		m_LossRate = m_LossRate*0.75f + Loss*0.25f;
+
+	m_LossVitalSent = m_NumVitalSent;
+	m_LossResent = m_NumResent;
+	m_LossUpdateTime = Now;
 }
 
 void CNetConnection::SignalResend()
 {
+	if(!(m_Construct.m_Flags&NET_PACKETFLAG_RESEND))
+		m_NumGaps++;
 	m_Construct.m_Flags |= NET_PACKETFLAG_RESEND;
 }
 
@@ -140,6 +202,7 @@ int CNetConnection::QueueChunkEx(int Flags, int DataSize, const void *pData, int
 			pResend->m_FirstSendTime = time_get();
 			pResend->m_LastSendTime = pResend->m_FirstSendTime;
 			mem_copy(pResend->m_pData, pData, DataSize);
+			m_NumVitalSent++;
 		}
 		else
 		{
@@ -181,12 +244,20 @@ void CNetConnection::ResendChunk(CNetChunkResend *pResend)
 {
 	QueueChunkEx(pResend->m_Flags|NET_CHUNKFLAG_RESEND, pResend->m_DataSize, pResend->m_pData, pResend->m_Sequence);
 	pResend->m_LastSendTime = time_get();
+	m_NumResent++;
 }
 
 void CNetConnection::Resend()
 {
+	// the peer saw a gap. chunks sent less than a round trip ago can still
+	// be on their way, they get picked up by the next request or the resend
+	// timer. the minimum is used as the peer may hold back its acks
+	int64 Now = time_get();
 	for(CNetChunkResend *pResend = m_Buffer.First(); pResend; pResend = m_Buffer.Next(pResend))
-		ResendChunk(pResend);
+	{
+		if(Now-pResend->m_LastSendTime >= m_RttMin)
+			ResendChunk(pResend);
+	}
 }
 
 int CNetConnection::Connect(NETADDR *pAddr)
@@ -392,12 +463,17 @@ int CNetConnection::Update()
 		}
 		else
 		{
-			// resend packet if we havn't got it acked in 1 second
-			if(Now-pResend->m_LastSendTime > time_freq())
+			// resend packet if we havn't got it acked in time, back off until the next sample
+			if(Now-pResend->m_LastSendTime > m_Rto)
+			{
 				ResendChunk(pResend);
+				m_Rto = min(m_Rto*2, time_freq());
+			}
 		}
 	}
 
+	UpdateLoss(Now);
+
 	// send keep alives if nothing has happend for 250ms
 	if(State() == NET_CONNSTATE_ONLINE)
 	{
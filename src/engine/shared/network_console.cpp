@@ -16,6 +16,7 @@ bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, int Flags)
 	m_Socket.ipv4sock = -1;
 	m_Socket.ipv6sock = -1;
 	m_pNetBan = pNetBan;
+	m_Filter.Init(pNetBan, ACCEPT_RATE_ADDR, ACCEPT_RATE_NET);
 
 	// open socket
 	m_Socket = net_tcp_create(BindAddr);
@@ -104,11 +105,16 @@ int CNetConsole::Update()
 
 	if(net_tcp_accept(m_Socket, &Socket, &Addr) > 0)
 	{
-		// check if we just should drop the packet
+		// check if we just should drop the connection
 		char aBuf[128];
-		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+		bool Banned;
+		if(m_Filter.Check(&Addr, false, &Banned) >= 0)
+			net_tcp_close(Socket);
+		else if(Banned)
 		{
 			// banned, reply with a message and drop
+			if(!NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+				str_copy(aBuf, "You have been banned", sizeof(aBuf));
 			net_tcp_send(Socket, aBuf, str_length(aBuf));
 			net_tcp_close(Socket);
 		}
@@ -0,0 +1,103 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+
+#include "netban.h"
+#include "network.h"
+
+
+void CNetFilter::Init(CNetBan *pNetBan, int AddrRate, int NetRate)
+{
+	mem_zero(m_aAddrBuckets, sizeof(m_aAddrBuckets));
+	mem_zero(m_aNetBuckets, sizeof(m_aNetBuckets));
+	mem_zero(m_aDrops, sizeof(m_aDrops));
+	secure_random_fill(m_aKey, sizeof(m_aKey));
+	m_pNetBan = pNetBan;
+	SetRates(AddrRate, NetRate);
+}
+
+CNetFilter::CBucket *CNetFilter::Bucket(CBucket *pBuckets, const NETADDR *pPrefix, int Rate, int64 Now)
+{
+	// keyed hash so nobody can aim at the bucket of somebody else
+	CBucket *pBucket = &pBuckets[siphash24(pPrefix, sizeof(NETADDR), m_aKey[0], m_aKey[1])&(NUM_BUCKETS-1)];
+	bool Refilled = pBucket->m_Tokens + (Now-pBucket->m_Time)*Rate/(float)time_freq() >= Rate;
+	if(pBucket->m_Prefix.type == NETTYPE_INVALID || (net_addr_comp(&pBucket->m_Prefix, pPrefix) != 0 && Refilled))
+	{
+		// empty, or the other source has been quiet long enough to refill.
+		// a bucket in use is shared instead, so switching sources can't refill it
+		pBucket->m_Prefix = *pPrefix;
+		pBucket->m_Time = Now;
+		pBucket->m_BanReplyTime = 0;
+		pBucket->m_Tokens = Rate;
+	}
+	return pBucket;
+}
+
+bool CNetFilter::Take(CBucket *pBucket, int Rate, int64 Now)
+{
+	// refill, the burst is one second worth of packets
+	pBucket->m_Tokens = min((float)Rate, pBucket->m_Tokens + (Now-pBucket->m_Time)*Rate/(float)time_freq());
+	pBucket->m_Time = Now;
+	if(pBucket->m_Tokens < 1.0f)
+		return false;
+	pBucket->m_Tokens -= 1.0f;
+	return true;
+}
+
+int CNetFilter::Check(const NETADDR *pAddr, bool Known, bool *pBanned)
+{
+	*pBanned = false;
+	if(!m_pNetBan && (Known || (!m_AddrRate && !m_NetRate)))
+		return -1;
+
+	int64 Now = time_get();
+	NETADDR Prefix = *pAddr;
+	Prefix.port = 0;
+
+	if(m_pNetBan && m_pNetBan->IsBannedQuick(&Prefix))
+	{
+		CBucket *pBucket = Bucket(m_aAddrBuckets, &Prefix, m_AddrRate, Now);
+		if(pBucket->m_BanReplyTime && Now-pBucket->m_BanReplyTime < time_freq())
+		{
+			m_aDrops[DROP_BANNED]++;
+			return DROP_BANNED;
+		}
+		pBucket->m_BanReplyTime = Now;
+		*pBanned = true;
+		return -1;
+	}
+
+	if(Known)
+		return -1;
+
+	if(m_AddrRate && !Take(Bucket(m_aAddrBuckets, &Prefix, m_AddrRate, Now), m_AddrRate, Now))
+	{
+		m_aDrops[DROP_RATE_ADDR]++;
+		return DROP_RATE_ADDR;
+	}
+
+	if(m_NetRate)
+	{
+		// ipv4 /24, ipv6 /64
+		if(Prefix.type == NETTYPE_IPV4)
+			Prefix.ip[3] = 0;
+		else
+			mem_zero(&Prefix.ip[8], 8);
+		if(!Take(Bucket(m_aNetBuckets, &Prefix, m_NetRate, Now), m_NetRate, Now))
+		{
+			m_aDrops[DROP_RATE_NET]++;
+			return DROP_RATE_NET;
+		}
+	}
+
+	return -1;
+}
+
+const char *CNetFilter::DropName(int Reason)
+{
+	static const char *s_apNames[NUM_DROPS] = { "banned", "rate_addr", "rate_net", "invalid" };
+	return s_apNames[Reason];
+}
@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
 #include <engine/console.h>
@@ -8,6 +9,71 @@
 #include "network.h"
 
 
+unsigned CNetAddrTable::Hash(const NETADDR *pAddr)
+{
+	// fnv-1a
+	unsigned Hash = 2166136261u^pAddr->type;
+	for(int i = 0; i < 16; i++)
+		Hash = (Hash^pAddr->ip[i])*16777619u;
+	Hash = (Hash^(pAddr->port&0xff))*16777619u;
+	Hash = (Hash^(pAddr->port>>8))*16777619u;
+	return Hash;
+}
+
+int CNetAddrTable::Index(const NETADDR *pAddr) const
+{
+	int i = Hash(pAddr)&(SIZE-1);
+	for(int n = 0; n < SIZE && m_aEntries[i].m_Used; n++, i = (i+1)&(SIZE-1))
+	{
+		if(net_addr_comp(&m_aEntries[i].m_Addr, pAddr) == 0)
+			return i;
+	}
+	return -1;
+}
+
+int CNetAddrTable::Find(const NETADDR *pAddr) const
+{
+	int i = Index(pAddr);
+	return i < 0 ? -1 : m_aEntries[i].m_Value;
+}
+
+bool CNetAddrTable::Set(const NETADDR *pAddr, int Value)
+{
+	int i = Hash(pAddr)&(SIZE-1);
+	for(int n = 0; n < SIZE; n++, i = (i+1)&(SIZE-1))
+	{
+		if(!m_aEntries[i].m_Used || net_addr_comp(&m_aEntries[i].m_Addr, pAddr) == 0)
+		{
+			m_aEntries[i].m_Addr = *pAddr;
+			m_aEntries[i].m_Value = Value;
+			m_aEntries[i].m_Used = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+void CNetAddrTable::Remove(const NETADDR *pAddr)
+{
+	int i = Index(pAddr);
+	if(i < 0)
+		return;
+
+	// shift the following entries back instead of leaving a tombstone
+	m_aEntries[i].m_Used = false;
+	for(int j = (i+1)&(SIZE-1); m_aEntries[j].m_Used; j = (j+1)&(SIZE-1))
+	{
+		// an entry may only move back if its home is not between the hole and itself
+		int Home = Hash(&m_aEntries[j].m_Addr)&(SIZE-1);
+		if(i <= j ? (Home <= i || Home > j) : (Home <= i && Home > j))
+		{
+			m_aEntries[i] = m_aEntries[j];
+			m_aEntries[j].m_Used = false;
+			i = j;
+		}
+	}
+}
+
 bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags)
 {
 	// zero out the whole structure
@@ -22,6 +88,7 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	m_TokenCache.Init(m_Socket, &m_TokenManager);
 
 	m_pNetBan = pNetBan;
+	m_Filter.Init(pNetBan, 0, 0);
 
 	// clamp clients
 	m_MaxClients = MaxClients;
@@ -54,6 +121,50 @@ int CNetServer::Close()
 	return 0;
 }
 
+int CNetServer::FindSlot(const NETADDR *pAddr) const
+{
+	// the connection can reset itself before it gets dropped
+	int ClientID = m_SlotTable.Find(pAddr);
+	if(ClientID >= 0 && net_addr_comp(m_aSlots[ClientID].m_Connection.PeerAddress(), pAddr) == 0)
+		return ClientID;
+	return -1;
+}
+
+bool CNetServer::AddSlot(int ClientID, const NETADDR *pAddr)
+{
+	// the slot can still hold a connection that went offline without a drop
+	RemoveSlot(ClientID);
+
+	NETADDR IP = *pAddr;
+	IP.port = 0;
+	if(!m_SlotTable.Set(pAddr, ClientID))
+		return false;
+	if(!m_IPTable.Set(&IP, max(m_IPTable.Find(&IP), 0)+1))
+	{
+		m_SlotTable.Remove(pAddr);
+		return false;
+	}
+	m_aSlots[ClientID].m_Addr = *pAddr;
+	return true;
+}
+
+void CNetServer::RemoveSlot(int ClientID)
+{
+	NETADDR *pAddr = &m_aSlots[ClientID].m_Addr;
+	if(pAddr->type == NETTYPE_INVALID)
+		return;
+
+	NETADDR IP = *pAddr;
+	IP.port = 0;
+	int Count = m_IPTable.Find(&IP);
+	if(Count > 1)
+		m_IPTable.Set(&IP, Count-1);
+	else
+		m_IPTable.Remove(&IP);
+	m_SlotTable.Remove(pAddr);
+	mem_zero(pAddr, sizeof(*pAddr));
+}
+
 int CNetServer::Drop(int ClientID, const char *pReason)
 {
 	// TODO: insert lots of checks here
@@ -68,6 +179,7 @@ int CNetServer::Drop(int ClientID, const char *pReason)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
 	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
+	RemoveSlot(ClientID);
 
 	return 0;
 }
@@ -78,7 +190,9 @@ int CNetServer::Update()
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		m_aSlots[i].m_Connection.Update();
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
+		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+			RemoveSlot(i);
+		else if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
 		{
 			if(Now - m_aSlots[i].m_Connection.ConnectTime() < time_freq() && NetBan())
 			{
@@ -116,48 +230,49 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 		if(Bytes <= 0)
 			break;
 
+		// filter before spending any time on the packet
+		int i = FindSlot(&Addr);
+		bool Banned;
+		if(m_Filter.Check(&Addr, i >= 0, &Banned) >= 0)
+			continue;
+
 		if(CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data) == 0)
 		{
 			// check for bans
 			char aBuf[128];
-			if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+			if(Banned)
 			{
 				// banned, reply with a message
+				if(!NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+					str_copy(aBuf, "You have been banned", sizeof(aBuf));
 				CNetBase::SendControlMsg(m_Socket, &Addr, m_RecvUnpacker.m_Data.m_ResponseToken, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1);
 				continue;
 			}
 
-			bool Found = false;
 			// try to find matching slot
-			for(int i = 0; i < MaxClients(); i++)
+			if(i >= 0)
 			{
-				if(net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
+				if(m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
 				{
-					if(m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
+					if(m_RecvUnpacker.m_Data.m_DataSize)
 					{
-						if(m_RecvUnpacker.m_Data.m_DataSize)
+						if(!(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS))
+							m_RecvUnpacker.Start(&Addr, &m_aSlots[i].m_Connection, i);
+						else
 						{
-							if(!(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS))
-								m_RecvUnpacker.Start(&Addr, &m_aSlots[i].m_Connection, i);
-							else
-							{
-								pChunk->m_Flags = NETSENDFLAG_CONNLESS;
-								pChunk->m_Address = *m_aSlots[i].m_Connection.PeerAddress();
-								pChunk->m_ClientID = i;
-								pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
-								pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
-								if(pResponseToken)
-									*pResponseToken = NET_TOKEN_NONE;
-								return 1;
-							}
+							pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+							pChunk->m_Address = *m_aSlots[i].m_Connection.PeerAddress();
+							pChunk->m_ClientID = i;
+							pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
+							pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
+							if(pResponseToken)
+								*pResponseToken = NET_TOKEN_NONE;
+							return 1;
 						}
 					}
-					Found = true;
 				}
-			}
-
-			if(Found)
 				continue;
+			}
 
 			int Accept = m_TokenManager.ProcessMessage(&Addr, &m_RecvUnpacker.m_Data);
 			if(Accept <= 0)
@@ -170,32 +285,22 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 					bool Found = false;
 
 					// only allow a specific number of players with the same ip
-					NETADDR ThisAddr = Addr, OtherAddr;
-					int FoundAddr = 1;
+					NETADDR ThisAddr = Addr;
 					ThisAddr.port = 0;
-					for(int i = 0; i < MaxClients(); i++)
+					if(m_IPTable.Find(&ThisAddr) >= m_MaxClientsPerIP)
 					{
-						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
-							continue;
-
-						OtherAddr = *m_aSlots[i].m_Connection.PeerAddress();
-						OtherAddr.port = 0;
-						if(!net_addr_comp(&ThisAddr, &OtherAddr))
-						{
-							if(FoundAddr++ >= m_MaxClientsPerIP)
-							{
-								char aBuf[128];
-								str_format(aBuf, sizeof(aBuf), "Only %d players with the same IP are allowed", m_MaxClientsPerIP);
-								CNetBase::SendControlMsg(m_Socket, &Addr, m_RecvUnpacker.m_Data.m_ResponseToken, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1);
-								return 0;
-							}
-						}
+						char aBuf[128];
+						str_format(aBuf, sizeof(aBuf), "Only %d players with the same IP are allowed", m_MaxClientsPerIP);
+						CNetBase::SendControlMsg(m_Socket, &Addr, m_RecvUnpacker.m_Data.m_ResponseToken, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1);
+						return 0;
 					}
 
 					for(int i = 0; i < MaxClients(); i++)
 					{
 						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
 						{
+							if(!AddSlot(i, &Addr))
+								break;
 							Found = true;
 							m_aSlots[i].m_Connection.SetToken(m_RecvUnpacker.m_Data.m_Token);
 							m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr);
@@ -226,6 +331,8 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 				return 1;
 			}
 		}
+		else
+			m_Filter.CountDrop(CNetFilter::DROP_INVALID);
 	}
 	return 0;
 }
@@ -240,14 +347,9 @@ int CNetServer::Send(CNetChunk *pChunk, TOKEN Token)
 			return -1;
 		}
 
+		// upgrade the packet, now that we know its recipent
 		if(pChunk->m_ClientID == -1)
-			for(int i = 0; i < MaxClients(); i++)
-				if(net_addr_comp(&pChunk->m_Address, m_aSlots[i].m_Connection.PeerAddress()) == 0)
-				{
-					// upgrade the packet, now that we know its recipent
-					pChunk->m_ClientID = i;
-					break;
-				}
+			pChunk->m_ClientID = FindSlot(&pChunk->m_Address);
 
 		if(Token != NET_TOKEN_NONE)
 		{
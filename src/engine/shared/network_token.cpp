@@ -4,23 +4,9 @@
 #include <base/math.h>
 #include <base/system.h>
 
-#include <engine/external/md5/md5.h>
-
 #include "network.h"
 
-static unsigned int Hash(char *pData, int Size)
-{
-	md5_state_t State;
-	unsigned int aDigest[4]; // make sure this is 16 byte
-
-	md5_init(&State);
-	md5_append(&State, (const md5_byte_t *)pData, Size);
-	md5_finish(&State, (md5_byte_t *)aDigest);
-
-	return (aDigest[0] ^ aDigest[1] ^ aDigest[2] ^ aDigest[3]);
-}
-
-int CNetTokenCache::CConnlessPacketInfo::m_UniqueID = 0;
+volatile unsigned CNetTokenCache::CConnlessPacketInfo::m_UniqueID = 0;
 
 void CNetTokenManager::Init(NETSOCKET Socket, int SeedTime)
 {
@@ -98,18 +84,18 @@ TOKEN CNetTokenManager::GenerateToken(const NETADDR *pAddr, int64 Seed)
 {
 	static const NETADDR NullAddr = { 0 };
 	NETADDR Addr;
-	char aBuf[sizeof(NETADDR) + sizeof(int64)];
+	int64 Hash;
 	unsigned int Result;
 
 	if(pAddr->type & NETTYPE_LINK_BROADCAST)
 		return GenerateToken(&NullAddr, Seed);
 
+	// the seed is the key, this runs for every connless packet so it has to be cheap
 	Addr = *pAddr;
 	Addr.port = 0;
-	mem_copy(aBuf, &Addr, sizeof(NETADDR));
-	mem_copy(aBuf + sizeof(NETADDR), &Seed, sizeof(int64));
+	Hash = siphash24(&Addr, sizeof(Addr), Seed, ~Seed);
 
-	Result = Hash(aBuf, sizeof(aBuf)) & NET_TOKEN_MASK;
+	Result = (unsigned int)(Hash ^ (Hash >> 32)) & NET_TOKEN_MASK;
 	if(Result == NET_TOKEN_NONE)
 		Result--;
 
@@ -28,6 +28,23 @@ void CPacker::AddInt(int i)
 		m_pCurrent = CVariableInt::Pack(m_pCurrent, i);
 }
 
+void CPacker::AddInts(const int *pInts, int Num)
+{
+	if(m_Error)
+		return;
+
+	// one check for all of them, an int takes at most 5 bytes
+	if(m_pEnd - m_pCurrent < Num*5+1)
+	{
+		for(int i = 0; i < Num; i++)
+			AddInt(pInts[i]);
+		return;
+	}
+
+	for(int i = 0; i < Num; i++)
+		m_pCurrent = CVariableInt::Pack(m_pCurrent, pInts[i]);
+}
+
 void CPacker::AddString(const char *pStr, int Limit)
 {
 	if(m_Error)
@@ -76,12 +93,8 @@ void CPacker::AddRaw(const void *pData, int Size)
 		return;
 	}
 
-	const unsigned char *pSrc = (const unsigned char *)pData;
-	while(Size)
-	{
-		*m_pCurrent++ = *pSrc++;
-		Size--;
-	}
+	mem_copy(m_pCurrent, pData, Size);
+	m_pCurrent += Size;
 }
 
 
@@ -19,6 +19,7 @@ class CPacker
 public:
 	void Reset();
 	void AddInt(int i);
+	void AddInts(const int *pInts, int Num);
 	void AddString(const char *pStr, int Limit);
 	void AddRaw(const void *pData, int Size);
 
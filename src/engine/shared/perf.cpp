@@ -0,0 +1,93 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
+#include <engine/storage.h>
+
+#include "perf.h"
+
+CPerf::CPerf()
+{
+	m_NumZones = 0;
+	m_PeriodStart = perf_time();
+	m_pTrace = 0;
+	m_NumTraceEvents = 0;
+	m_TraceStart = 0;
+	m_TraceEnd = 0;
+}
+
+CPerf::~CPerf()
+{
+	mem_free(m_pTrace);
+}
+
+void CPerf::Init(const char * const *ppNames, int NumZones)
+{
+	m_NumZones = min(NumZones, (int)MAX_ZONES);
+	for(int i = 0; i < m_NumZones; i++)
+		perf_zone_init(&m_aZones[i], ppNames[i]);
+	m_PeriodStart = perf_time();
+}
+
+bool CPerf::Update()
+{
+	int64 Now = perf_time();
+	if(Now-m_PeriodStart < perf_freq())
+		return false;
+
+	m_PeriodStart = Now;
+	for(int i = 0; i < m_NumZones; i++)
+		perf_zone_next(&m_aZones[i]);
+	return true;
+}
+
+void CPerf::FormatZone(int Zone, char *pBuf, int BufSize) const
+{
+	const PERF_ZONE *pZone = &m_aZones[Zone];
+	double Scale = 1000.0/perf_freq();
+	str_format(pBuf, BufSize, "%-10s n=%-5d min=%.3fms avg=%.3fms p99=%.3fms max=%.3fms", pZone->name, (int)pZone->last_count,
+		pZone->last_min*Scale, pZone->last_avg*Scale, pZone->last_p99*Scale, pZone->last_max*Scale);
+}
+
+bool CPerf::StartTrace(int Seconds)
+{
+	if(m_pTrace)
+		return false;
+
+	m_pTrace = (CTraceEvent *)mem_alloc(MAX_TRACE_EVENTS*sizeof(CTraceEvent), 1);
+	m_NumTraceEvents = 0;
+	m_TraceStart = perf_time();
+	m_TraceEnd = m_TraceStart + perf_freq()*Seconds;
+	return true;
+}
+
+bool CPerf::SaveTrace(IStorage *pStorage, const char *pFilename, int ThreadID)
+{
+	if(!m_pTrace)
+		return false;
+
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(File)
+	{
+		// chrome trace event format, complete events with times in microseconds
+		char aBuf[256];
+		double Scale = 1000000.0/perf_freq();
+		str_copy(aBuf, "{\"traceEvents\":[\n", sizeof(aBuf));
+		io_write(File, aBuf, str_length(aBuf));
+		for(int i = 0; i < m_NumTraceEvents; i++)
+		{
+			const CTraceEvent *pEvent = &m_pTrace[i];
+			str_format(aBuf, sizeof(aBuf), "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}\n", i ? "," : "",
+				m_aZones[pEvent->m_Zone].name, (pEvent->m_Start-m_TraceStart)*Scale, pEvent->m_Duration*Scale, ThreadID);
+			io_write(File, aBuf, str_length(aBuf));
+		}
+		str_copy(aBuf, "],\"displayTimeUnit\":\"ms\"}\n", sizeof(aBuf));
+		io_write(File, aBuf, str_length(aBuf));
+		io_close(File);
+	}
+
+	mem_free(m_pTrace);
+	m_pTrace = 0;
+	m_NumTraceEvents = 0;
+	return File != 0;
+}
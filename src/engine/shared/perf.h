@@ -0,0 +1,86 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_PERF_H
+#define ENGINE_SHARED_PERF_H
+
+#include <base/system.h>
+
+// timings of hot code paths, summed up every second. for a closer look all
+// samples can be recorded for a while and saved as a chrome trace
+class CPerf
+{
+	enum
+	{
+		MAX_ZONES=16,
+		MAX_TRACE_EVENTS=1<<16,
+	};
+
+	struct CTraceEvent
+	{
+		int m_Zone;
+		int64 m_Start;
+		int64 m_Duration;
+	};
+
+	PERF_ZONE m_aZones[MAX_ZONES];
+	int m_NumZones;
+	int64 m_PeriodStart;
+
+	CTraceEvent *m_pTrace;
+	int m_NumTraceEvents;
+	int64 m_TraceStart;
+	int64 m_TraceEnd;
+
+public:
+	CPerf();
+	~CPerf();
+
+	void Init(const char * const *ppNames, int NumZones);
+
+	void Add(int Zone, int64 Start, int64 End)
+	{
+		perf_zone_add(&m_aZones[Zone], End-Start);
+		if(m_pTrace && m_NumTraceEvents < MAX_TRACE_EVENTS)
+		{
+			m_pTrace[m_NumTraceEvents].m_Zone = Zone;
+			m_pTrace[m_NumTraceEvents].m_Start = Start;
+			m_pTrace[m_NumTraceEvents].m_Duration = End-Start;
+			m_NumTraceEvents++;
+		}
+	}
+
+	// finishes the period of all zones once a second, returns true when it did
+	bool Update();
+
+	int NumZones() const { return m_NumZones; }
+	const PERF_ZONE *Zone(int Zone) const { return &m_aZones[Zone]; }
+	void FormatZone(int Zone, char *pBuf, int BufSize) const;
+
+	bool StartTrace(int Seconds);
+	bool Tracing() const { return m_pTrace != 0; }
+	bool TraceDone() const { return m_pTrace && (m_NumTraceEvents == MAX_TRACE_EVENTS || perf_time() > m_TraceEnd); }
+	int NumTraceEvents() const { return m_NumTraceEvents; }
+
+	// writes the trace as json and stops tracing
+	bool SaveTrace(class IStorage *pStorage, const char *pFilename, int ThreadID);
+};
+
+// times the scope it lives in
+class CPerfScope
+{
+	CPerf *m_pPerf;
+	int m_Zone;
+	int64 m_Start;
+
+public:
+	CPerfScope(CPerf *pPerf, int Zone)
+	{
+		m_pPerf = pPerf;
+		m_Zone = Zone;
+		m_Start = perf_time();
+	}
+
+	~CPerfScope() { m_pPerf->Add(m_Zone, m_Start, perf_time()); }
+};
+
+#endif
@@ -0,0 +1,22 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_PROTOCOL_EX_H
+#define ENGINE_SHARED_PROTOCOL_EX_H
+
+#include "protocol.h"
+
+/*
+	System messages added after the 0.7 release. protocol.h goes into the
+	net version hash, so these live here to keep old versions compatible.
+
+	A server only sends NETMSG_SNAPPARITY to clients that reported their
+	loss with NETMSG_SNAPLOSS, which older clients never do. Older servers
+	drop the unknown loss reports.
+*/
+enum
+{
+	NETMSG_SNAPPARITY=NETMSG_ERROR+1,	// sent by server, xor over a group of snapshot parts
+	NETMSG_SNAPLOSS,					// sent by client, how many snapshot parts got lost
+};
+
+#endif
@@ -1,5 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
 #include "snapshot.h"
 #include "compression.h"
 
@@ -436,7 +438,7 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 	if(CreateAlt)
 		TotalSize += DataSize;
 
-	CHolder *pHolder = (CHolder *)mem_alloc(TotalSize, 1);
+	CHolder *pHolder = (CHolder *)mem_alloc_tag(TotalSize, 1, MEMTAG_SNAPSHOT);
 
 	// set data
 	pHolder->m_Tick = Tick;
@@ -561,3 +563,133 @@ void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 
 	return pObj->Data();
 }
+
+// CSnapshotParts
+
+CSnapshotParts::CSnapshotParts()
+{
+	m_PartsExpected = 0;
+	m_PartsLost = 0;
+	m_PartsRecovered = 0;
+	m_NumParts = 0;
+	Reset(-1, 0, 1);
+}
+
+void CSnapshotParts::Reset(int Tick, int NumParts, int PartSize)
+{
+	// account the previous snapshot, single parts are never seen when lost
+	if(m_NumParts > 1)
+	{
+		int Expected = m_NumParts + (m_GroupSize ? NumGroups(m_NumParts, m_GroupSize) : 0);
+		m_PartsExpected += Expected;
+		m_PartsLost += max(Expected-m_NumReceived, 0);
+	}
+
+	m_Tick = Tick;
+	m_NumParts = NumParts;
+	m_PartSize = PartSize;
+	m_Size = -1;
+	m_GroupSize = 0;
+	m_NumHave = 0;
+	m_NumReceived = 0;
+	m_Done = false;
+	mem_zero(m_aHave, sizeof(m_aHave));
+	mem_zero(m_aHaveParity, sizeof(m_aHaveParity));
+}
+
+void CSnapshotParts::Repair(int Group)
+{
+	if(!m_GroupSize || !m_aHaveParity[Group] || m_Size < 0)
+		return;
+
+	// exactly one part of the group has to be missing
+	int First = Group*m_GroupSize;
+	int Last = min(First+m_GroupSize, m_NumParts);
+	int Missing = -1;
+	for(int i = First; i < Last; i++)
+	{
+		if(m_aHave[i])
+			continue;
+		if(Missing >= 0)
+			return;
+		Missing = i;
+	}
+	if(Missing < 0)
+		return;
+
+	int Length = PartLength(Missing);
+	unsigned char *pOut = (unsigned char *)&m_aData[Missing*m_PartSize];
+	mem_copy(pOut, &m_aParity[Group*m_PartSize], Length);
+	for(int i = First; i < Last; i++)
+	{
+		if(i == Missing)
+			continue;
+		const unsigned char *pPart = (const unsigned char *)&m_aData[i*m_PartSize];
+		for(int b = min(PartLength(i), Length)-1; b >= 0; b--)
+			pOut[b] ^= pPart[b];
+	}
+
+	m_aHave[Missing] = true;
+	m_NumHave++;
+	m_PartsRecovered++;
+}
+
+void CSnapshotParts::AddPart(int Part, const void *pData, int DataSize)
+{
+	m_NumReceived++;
+	if(m_Done || m_aHave[Part])
+		return;
+
+	mem_copy(&m_aData[Part*m_PartSize], pData, DataSize);
+	m_aHave[Part] = true;
+	m_NumHave++;
+	if(Part == m_NumParts-1)
+		m_Size = Part*m_PartSize + DataSize;
+
+	if(m_GroupSize)
+		Repair(Part/m_GroupSize);
+}
+
+void CSnapshotParts::AddParity(int Group, int GroupSize, int Size, const void *pData, int DataSize)
+{
+	m_NumReceived++;
+	if(m_Done || GroupSize < 1 || GroupSize > m_NumParts || (m_GroupSize && m_GroupSize != GroupSize) ||
+		Group < 0 || Group >= NumGroups(m_NumParts, GroupSize) || m_aHaveParity[Group] ||
+		Size <= (m_NumParts-1)*m_PartSize || Size > m_NumParts*m_PartSize || (m_Size >= 0 && m_Size != Size) ||
+		DataSize < 0 || DataSize > m_PartSize)
+		return;
+
+	m_GroupSize = GroupSize;
+	mem_copy(&m_aParity[Group*m_PartSize], pData, DataSize);
+	mem_zero(&m_aParity[Group*m_PartSize+DataSize], m_PartSize-DataSize);
+	m_aHaveParity[Group] = true;
+
+	// the total size is needed to know the length of the last part
+	if(m_Size < 0)
+	{
+		m_Size = Size;
+		for(int g = 0; g < NumGroups(m_NumParts, m_GroupSize); g++)
+			Repair(g);
+	}
+	else
+		Repair(Group);
+}
+
+int CSnapshotParts::CreateParity(const void *pData, int Size, int PartSize, int GroupSize, int Group, void *pParity)
+{
+	int NumParts = (Size+PartSize-1)/PartSize;
+	int First = Group*GroupSize;
+	int Last = min(First+GroupSize, NumParts);
+	int ParitySize = 0;
+	unsigned char *pOut = (unsigned char *)pParity;
+	mem_zero(pOut, PartSize);
+	for(int i = First; i < Last; i++)
+	{
+		const unsigned char *pPart = (const unsigned char *)pData + i*PartSize;
+		int Length = min(PartSize, Size-i*PartSize);
+		for(int b = 0; b < Length; b++)
+			pOut[b] ^= pPart[b];
+		ParitySize = max(ParitySize, Length);
+	}
+	return ParitySize;
+}
@@ -134,6 +134,56 @@ public:
 	int *GetItemData(int Key);
 
 	int Finish(void *pSnapdata);
+
+	// bytes Finish() would write for the items added so far
+	int DataSize() const { return sizeof(CSnapshot) + m_NumItems*sizeof(int) + m_DataSize; }
+};
+
+
+// CSnapshotParts
+
+// collects the parts of a snapshot. a parity part is the xor over a group
+// of parts and rebuilds a single lost part of that group
+class CSnapshotParts
+{
+	char m_aData[CSnapshot::MAX_SIZE];
+	char m_aParity[CSnapshot::MAX_SIZE];
+	bool m_aHave[CSnapshot::MAX_PARTS];
+	bool m_aHaveParity[CSnapshot::MAX_PARTS];
+
+	int m_Tick;
+	int m_NumParts;
+	int m_PartSize;
+	int m_Size;
+	int m_GroupSize;
+	int m_NumHave;
+	int m_NumReceived;
+	bool m_Done;
+
+	int PartLength(int Part) const { return Part < m_NumParts-1 ? m_PartSize : m_Size-Part*m_PartSize; }
+	void Repair(int Group);
+
+public:
+	// counters for the loss report
+	int m_PartsExpected;
+	int m_PartsLost;
+	int m_PartsRecovered;
+
+	CSnapshotParts();
+	void Reset(int Tick, int NumParts, int PartSize);
+	void AddPart(int Part, const void *pData, int DataSize);
+	void AddParity(int Group, int GroupSize, int Size, const void *pData, int DataSize);
+
+	int Tick() const { return m_Tick; }
+	int NumParts() const { return m_NumParts; }
+	bool Complete() const { return m_NumHave == m_NumParts && m_Size >= 0; }
+	bool Done() const { return m_Done; }
+	void SetDone() { m_Done = true; }
+	const char *Data() const { return m_aData; }
+	int Size() const { return m_Size; }
+
+	static int NumGroups(int NumParts, int GroupSize) { return (NumParts+GroupSize-1)/GroupSize; }
+	static int CreateParity(const void *pData, int Size, int PartSize, int GroupSize, int Group, void *pParity);
 };
 
 
@@ -64,6 +64,7 @@ class IEngineTextRender : public ITextRender
 	MACRO_INTERFACE("enginetextrender", 0)
 public:
 	virtual void Init() = 0;
+	virtual void Shutdown() = 0;
 };
 
 extern IEngineTextRender *CreateEngineTextRender();
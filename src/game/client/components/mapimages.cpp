@@ -1,17 +1,84 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/tl/threading.h>
+
 #include <engine/graphics.h>
 #include <engine/map.h>
 #include <engine/storage.h>
+#include <engine/shared/config.h>
 #include <game/client/component.h>
+#include <game/client/gameclient.h>
 #include <game/mapitems.h>
 
 #include "mapimages.h"
 
 CMapImages::CMapImages()
 {
-	m_Info[MAP_TYPE_GAME].m_Count = 0;
-	m_Info[MAP_TYPE_MENU].m_Count = 0;
+	for(int i = 0; i < NUM_MAP_TYPES; i++)
+	{
+		m_Info[i].m_pMapImages = this;
+		m_Info[i].m_Count = 0;
+		m_Info[i].m_NumLoads = 0;
+		m_Info[i].m_FirstLoad = 0;
+	}
+}
+
+int CMapImages::LoadImagesThread(void *pUser)
+{
+	CMapInfo *pInfo = (CMapInfo *)pUser;
+
+	for(int i = 0; i < pInfo->m_NumLoads; i++)
+	{
+		CImageLoad *pLoad = &pInfo->m_aLoads[i];
+		int State = pInfo->m_pMapImages->Graphics()->LoadPNG(&pLoad->m_Info, pLoad->m_aFilename, IStorage::TYPE_ALL) ? LOADSTATE_DECODED : LOADSTATE_FAILED;
+		sync_barrier(); // publish the image before the state
+		pLoad->m_State = State;
+	}
+
+	return 0;
+}
+
+void CMapImages::UploadImages(CMapInfo *pInfo, int *pBudget)
+{
+	for(int i = pInfo->m_FirstLoad; i < pInfo->m_NumLoads && (!pBudget || *pBudget > 0); i++)
+	{
+		CImageLoad *pLoad = &pInfo->m_aLoads[i];
+		if(pLoad->m_State == LOADSTATE_DECODED)
+		{
+			sync_barrier();
+			CImageInfo *pImg = &pLoad->m_Info;
+			Graphics()->ReloadTextureRaw(pInfo->m_aTextures[pLoad->m_Index], pImg->m_Width, pImg->m_Height, pImg->m_Format, pImg->m_pData, pImg->m_Format, pLoad->m_Flags);
+			mem_free(pImg->m_pData);
+			if(pBudget)
+				(*pBudget)--;
+			if(g_Config.m_Debug)
+				dbg_msg("mapimages", "loaded %s", pLoad->m_aFilename);
+			pLoad->m_State = LOADSTATE_DONE;
+		}
+		else if(pLoad->m_State == LOADSTATE_FAILED)
+		{
+			dbg_msg("mapimages", "failed to load %s", pLoad->m_aFilename);
+			pLoad->m_State = LOADSTATE_DONE;
+		}
+
+		if(i == pInfo->m_FirstLoad && pLoad->m_State == LOADSTATE_DONE)
+			pInfo->m_FirstLoad++;
+	}
+}
+
+void CMapImages::ClearLoads(CMapInfo *pInfo)
+{
+	// wait for the job, it still works on the loads
+	while(pInfo->m_LoadJob.Status() != CJob::STATE_DONE)
+		thread_sleep(1);
+
+	for(int i = pInfo->m_FirstLoad; i < pInfo->m_NumLoads; i++)
+	{
+		if(pInfo->m_aLoads[i].m_State == LOADSTATE_DECODED)
+			mem_free(pInfo->m_aLoads[i].m_Info.m_pData);
+	}
+	pInfo->m_NumLoads = 0;
+	pInfo->m_FirstLoad = 0;
 }
 
 void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
@@ -19,17 +86,31 @@ void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 	if(MapType < 0 || MapType >= NUM_MAP_TYPES)
 		return;
 
+	CMapInfo *pInfo = &m_Info[MapType];
+	ClearLoads(pInfo);
+
 	// unload all textures
-	for(int i = 0; i < m_Info[MapType].m_Count; i++)
-		Graphics()->UnloadTexture(&(m_Info[MapType].m_aTextures[i]));
-	m_Info[MapType].m_Count = 0;
+	for(int i = 0; i < pInfo->m_Count; i++)
+		Graphics()->UnloadTexture(&(pInfo->m_aTextures[i]));
+	pInfo->m_Count = 0;
 
 	int Start;
-	pMap->GetType(MAPITEMTYPE_IMAGE, &Start, &m_Info[MapType].m_Count);
-	m_Info[MapType].m_Count = clamp(m_Info[MapType].m_Count, 0, int(MAX_TEXTURES));
+	pMap->GetType(MAPITEMTYPE_IMAGE, &Start, &pInfo->m_Count);
+	pInfo->m_Count = clamp(pInfo->m_Count, 0, int(MAX_TEXTURES));
+
+	// inflate the embedded images at once
+	int aImageData[MAX_TEXTURES];
+	int NumImageData = 0;
+	for(int i = 0; i < pInfo->m_Count; i++)
+	{
+		CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start+i, 0, 0);
+		if(!pImg->m_External)
+			aImageData[NumImageData++] = pImg->m_ImageData;
+	}
+	pMap->LoadData(aImageData, NumImageData);
 
 	// load new textures
-	for(int i = 0; i < m_Info[MapType].m_Count; i++)
+	for(int i = 0; i < pInfo->m_Count; i++)
 	{
 		int TextureFlags = 0;
 		bool FoundQuadLayer = false;
@@ -48,18 +129,35 @@ void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 		CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start+i, 0, 0);
 		if(pImg->m_External || (pImg->m_Version > 1 && pImg->m_Format != CImageInfo::FORMAT_RGB && pImg->m_Format != CImageInfo::FORMAT_RGBA))
 		{
-			char Buf[256];
-			char *pName = (char *)pMap->GetData(pImg->m_ImageName);
-			str_format(Buf, sizeof(Buf), "mapres/%s.png", pName);
-			m_Info[MapType].m_aTextures[i] = Graphics()->LoadTexture(Buf, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, TextureFlags);
+			// use a placeholder until the image is decoded
+			static const unsigned char s_aPlaceholder[16*16*4] = {0};
+			pInfo->m_aTextures[i] = Graphics()->LoadTextureRaw(16, 16, CImageInfo::FORMAT_RGBA, s_aPlaceholder, CImageInfo::FORMAT_RGBA, TextureFlags);
+
+			CImageLoad *pLoad = &pInfo->m_aLoads[pInfo->m_NumLoads++];
+			pLoad->m_Index = i;
+			str_format(pLoad->m_aFilename, sizeof(pLoad->m_aFilename), "mapres/%s.png", (char *)pMap->GetData(pImg->m_ImageName));
+			pLoad->m_Flags = TextureFlags;
+			pLoad->m_State = LOADSTATE_PENDING;
 		}
 		else
 		{
 			void *pData = pMap->GetData(pImg->m_ImageData);
-			m_Info[MapType].m_aTextures[i] = Graphics()->LoadTextureRaw(pImg->m_Width, pImg->m_Height, pImg->m_Version == 1 ? CImageInfo::FORMAT_RGBA : pImg->m_Format, pData, CImageInfo::FORMAT_RGBA, TextureFlags);
+			pInfo->m_aTextures[i] = Graphics()->LoadTextureRaw(pImg->m_Width, pImg->m_Height, pImg->m_Version == 1 ? CImageInfo::FORMAT_RGBA : pImg->m_Format, pData, CImageInfo::FORMAT_RGBA, TextureFlags);
 			pMap->UnloadData(pImg->m_ImageData);
 		}
 	}
+
+	// decode the external images
+	if(pInfo->m_NumLoads)
+	{
+		if(g_Config.m_ClThreadimageloading)
+			m_pClient->Engine()->AddJob(&pInfo->m_LoadJob, LoadImagesThread, pInfo);
+		else
+		{
+			LoadImagesThread(pInfo);
+			UploadImages(pInfo, 0);
+		}
+	}
 }
 
 void CMapImages::OnMapLoad()
@@ -74,6 +172,21 @@ void CMapImages::OnMenuMapLoad(IMap *pMap)
 	LoadMapImages(pMap, &MenuLayers, MAP_TYPE_MENU);
 }
 
+void CMapImages::OnShutdown()
+{
+	for(int i = 0; i < NUM_MAP_TYPES; i++)
+		ClearLoads(&m_Info[i]);
+}
+
+void CMapImages::OnRender()
+{
+	for(int i = 0; i < NUM_MAP_TYPES; i++)
+	{
+		if(m_Info[i].m_FirstLoad < m_Info[i].m_NumLoads)
+			UploadImages(&m_Info[i], &m_pClient->m_TextureUploadBudget);
+	}
+}
+
 IGraphics::CTextureHandle CMapImages::Get(int Index) const
 {
 	if(Client()->State() == IClient::STATE_ONLINE || Client()->State() == IClient::STATE_DEMOPLAYBACK)
@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef GAME_CLIENT_COMPONENTS_MAPIMAGES_H
 #define GAME_CLIENT_COMPONENTS_MAPIMAGES_H
+#include <engine/engine.h>
 #include <game/client/component.h>
 
 class CMapImages : public CComponent
@@ -12,15 +13,42 @@ class CMapImages : public CComponent
 
 		MAP_TYPE_GAME=0,
 		MAP_TYPE_MENU,
-		NUM_MAP_TYPES
+		NUM_MAP_TYPES,
+
+		LOADSTATE_PENDING=0,
+		LOADSTATE_DECODED,
+		LOADSTATE_FAILED,
+		LOADSTATE_DONE,
 	};
-	struct
+
+	// an external image that is decoded on the job pool, its texture is a
+	// placeholder until the decoded image is uploaded
+	struct CImageLoad
 	{
+		int m_Index;
+		char m_aFilename[128];
+		int m_Flags;
+		CImageInfo m_Info;
+		volatile int m_State;
+	};
+
+	struct CMapInfo
+	{
+		CMapImages *m_pMapImages;
 		IGraphics::CTextureHandle m_aTextures[MAX_TEXTURES];
 		int m_Count;
+
+		CImageLoad m_aLoads[MAX_TEXTURES];
+		int m_NumLoads;
+		int m_FirstLoad;
+		CJob m_LoadJob;
 	} m_Info[NUM_MAP_TYPES];
 
 	void LoadMapImages(class IMap *pMap, class CLayers *pLayers, int MapType);
+	void UploadImages(CMapInfo *pInfo, int *pBudget);
+	void ClearLoads(CMapInfo *pInfo);
+
+	static int LoadImagesThread(void *pUser);
 
 public:
 	CMapImages();
@@ -29,6 +57,8 @@ public:
 	int Num() const;
 
 	virtual void OnMapLoad();
+	virtual void OnShutdown();
+	virtual void OnRender();
 	void OnMenuMapLoad(class IMap *pMap);
 };
 
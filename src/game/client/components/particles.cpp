@@ -21,18 +21,7 @@ CParticles::CParticles()
 void CParticles::OnReset()
 {
 	// reset particles
-	for(int i = 0; i < MAX_PARTICLES; i++)
-	{
-		m_aParticles[i].m_PrevPart = i-1;
-		m_aParticles[i].m_NextPart = i+1;
-	}
-
-	m_aParticles[0].m_PrevPart = 0;
-	m_aParticles[MAX_PARTICLES-1].m_NextPart = -1;
-	m_FirstFree = 0;
-
-	for(int i = 0; i < NUM_GROUPS; i++)
-		m_aFirstPart[i] = -1;
+	m_Pool.Reset();
 }
 
 void CParticles::Add(int Group, CParticle *pPart)
@@ -49,27 +38,12 @@ void CParticles::Add(int Group, CParticle *pPart)
 			return;
 	}
 
-	if (m_FirstFree == -1)
-		return;
-
-	// remove from the free list
-	int Id = m_FirstFree;
-	m_FirstFree = m_aParticles[Id].m_NextPart;
-	if(m_FirstFree != -1)
-		m_aParticles[m_FirstFree].m_PrevPart = -1;
-
-	// copy data
-	m_aParticles[Id] = *pPart;
-
-	// insert to the group list
-	m_aParticles[Id].m_PrevPart = -1;
-	m_aParticles[Id].m_NextPart = m_aFirstPart[Group];
-	if(m_aFirstPart[Group] != -1)
-		m_aParticles[m_aFirstPart[Group]].m_PrevPart = Id;
-	m_aFirstPart[Group] = Id;
+	m_Pool.Add(Group, pPart);
+}
 
-	// set some parameters
-	m_aParticles[Id].m_Life = 0;
+void CParticles::CMover::MovePoint(vec2 *pPos, vec2 *pVel)
+{
+	m_pCollision->MovePoint(pPos, pVel, 0.1f+0.9f*frandom(), NULL);
 }
 
 void CParticles::Update(float TimePassed)
@@ -87,49 +61,9 @@ void CParticles::Update(float TimePassed)
 		FrictionFraction -= 0.05f;
 	}
 
-	for(int g = 0; g < NUM_GROUPS; g++)
-	{
-		int i = m_aFirstPart[g];
-		while(i != -1)
-		{
-			int Next = m_aParticles[i].m_NextPart;
-			//m_aParticles[i].vel += flow_get(m_aParticles[i].pos)*time_passed * m_aParticles[i].flow_affected;
-			m_aParticles[i].m_Vel.y += m_aParticles[i].m_Gravity*TimePassed;
-
-			for(int f = 0; f < FrictionCount; f++) // apply friction
-				m_aParticles[i].m_Vel *= m_aParticles[i].m_Friction;
-
-			// move the point
-			vec2 Vel = m_aParticles[i].m_Vel*TimePassed;
-			Collision()->MovePoint(&m_aParticles[i].m_Pos, &Vel, 0.1f+0.9f*frandom(), NULL);
-			m_aParticles[i].m_Vel = Vel* (1.0f/TimePassed);
-
-			m_aParticles[i].m_Life += TimePassed;
-			m_aParticles[i].m_Rot += TimePassed * m_aParticles[i].m_Rotspeed;
-
-			// check particle death
-			if(m_aParticles[i].m_Life > m_aParticles[i].m_LifeSpan)
-			{
-				// remove it from the group list
-				if(m_aParticles[i].m_PrevPart != -1)
-					m_aParticles[m_aParticles[i].m_PrevPart].m_NextPart = m_aParticles[i].m_NextPart;
-				else
-					m_aFirstPart[g] = m_aParticles[i].m_NextPart;
-
-				if(m_aParticles[i].m_NextPart != -1)
-					m_aParticles[m_aParticles[i].m_NextPart].m_PrevPart = m_aParticles[i].m_PrevPart;
-
-				// insert to the free list
-				if(m_FirstFree != -1)
-					m_aParticles[m_FirstFree].m_PrevPart = i;
-				m_aParticles[i].m_PrevPart = -1;
-				m_aParticles[i].m_NextPart = m_FirstFree;
-				m_FirstFree = i;
-			}
-
-			i = Next;
-		}
-	}
+	CMover Mover;
+	Mover.m_pCollision = Collision();
+	m_Pool.Update(TimePassed, FrictionCount, &Mover);
 }
 
 void CParticles::OnRender()
@@ -162,26 +96,24 @@ void CParticles::RenderGroup(int Group)
 	Graphics()->TextureSet(g_pData->m_aImages[IMAGE_PARTICLES].m_Id);
 	Graphics()->QuadsBegin();
 
-	int i = m_aFirstPart[Group];
-	while(i != -1)
+	// newest particles are drawn first
+	const CParticlePool<MAX_PARTICLES, NUM_GROUPS> *pPool = &m_Pool;
+	for(int i = pPool->m_aStart[Group]+pPool->m_aNum[Group]-1; i >= pPool->m_aStart[Group]; i--)
 	{
-		RenderTools()->SelectSprite(m_aParticles[i].m_Spr);
-		float a = m_aParticles[i].m_Life / m_aParticles[i].m_LifeSpan;
-		vec2 p = m_aParticles[i].m_Pos;
-		float Size = mix(m_aParticles[i].m_StartSize, m_aParticles[i].m_EndSize, a);
+		RenderTools()->SelectSprite(pPool->m_aSpr[i]);
+		float a = pPool->m_aLife[i] / pPool->m_aLifeSpan[i];
+		float Size = mix(pPool->m_aStartSize[i], pPool->m_aEndSize[i], a);
 
-		Graphics()->QuadsSetRotation(m_aParticles[i].m_Rot);
+		Graphics()->QuadsSetRotation(pPool->m_aRot[i]);
 
 		Graphics()->SetColor(
-			m_aParticles[i].m_Color.r,
-			m_aParticles[i].m_Color.g,
-			m_aParticles[i].m_Color.b,
-			m_aParticles[i].m_Color.a); // pow(a, 0.75f) *
+			pPool->m_aColor[i].r,
+			pPool->m_aColor[i].g,
+			pPool->m_aColor[i].b,
+			pPool->m_aColor[i].a); // pow(a, 0.75f) *
 
-		IGraphics::CQuadItem QuadItem(p.x, p.y, Size, Size);
+		IGraphics::CQuadItem QuadItem(pPool->m_aPosX[i], pPool->m_aPosY[i], Size, Size);
 		Graphics()->QuadsDraw(&QuadItem, 1);
-
-		i = m_aParticles[i].m_NextPart;
 	}
 	Graphics()->QuadsEnd();
 	Graphics()->BlendNormal();
@@ -5,12 +5,15 @@
 #include <base/color.h>
 #include <base/system.h>
 #include <base/math.h>
+#include <base/tl/threading.h>
 
 #include <engine/graphics.h>
 #include <engine/storage.h>
 #include <engine/external/json-parser/json.h>
 #include <engine/shared/config.h>
 
+#include <game/client/gameclient.h>
+
 #include "skins.h"
 
 
@@ -32,30 +35,57 @@ int CSkins::SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser)
 	if(l < 4 || IsDir || str_comp(pName+l-4, ".png") != 0)
 		return 0;
 
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf), "skins/%s/%s", CSkins::ms_apSkinPartNames[pSelf->m_ScanningPart], pName);
-	CImageInfo Info;
-	if(!pSelf->Graphics()->LoadPNG(&Info, aBuf, DirType))
+	// the image itself is decoded later on, start with placeholder textures
+	static const unsigned char s_aPlaceholder[4] = {0};
+	CSkinPart Part;
+	Part.m_OrgTexture = pSelf->Graphics()->LoadTextureRaw(1, 1, CImageInfo::FORMAT_RGBA, s_aPlaceholder, CImageInfo::FORMAT_RGBA, IGraphics::TEXLOAD_NOMIPMAPS);
+	Part.m_ColorTexture = pSelf->Graphics()->LoadTextureRaw(1, 1, CImageInfo::FORMAT_RGBA, s_aPlaceholder, CImageInfo::FORMAT_RGBA, IGraphics::TEXLOAD_NOMIPMAPS);
+	Part.m_BloodColor = vec3(1.0f, 1.0f, 1.0f);
+
+	// set skin part data
+	Part.m_Flags = 0;
+	if(pName[0] == 'x' && pName[1] == '_')
+		Part.m_Flags |= SKINFLAG_SPECIAL;
+	if(DirType != IStorage::TYPE_SAVE)
+		Part.m_Flags |= SKINFLAG_STANDARD;
+	str_copy(Part.m_aName, pName, min((int)sizeof(Part.m_aName),l-3));
+	pSelf->m_aaSkinParts[pSelf->m_ScanningPart].add(Part);
+
+	CPartLoad Load;
+	mem_zero(&Load, sizeof(Load));
+	Load.m_Part = pSelf->m_ScanningPart;
+	str_format(Load.m_aFilename, sizeof(Load.m_aFilename), "skins/%s/%s", CSkins::ms_apSkinPartNames[pSelf->m_ScanningPart], pName);
+	Load.m_StorageType = DirType;
+	Load.m_OrgTexture = Part.m_OrgTexture;
+	Load.m_ColorTexture = Part.m_ColorTexture;
+	Load.m_State = LOADSTATE_PENDING;
+	pSelf->m_aPartLoads.add(Load);
+
+	return 0;
+}
+
+void CSkins::DecodePart(CPartLoad *pLoad)
+{
+	CImageInfo *pInfo = &pLoad->m_Info;
+	if(!Graphics()->LoadPNG(pInfo, pLoad->m_aFilename, pLoad->m_StorageType))
 	{
-		str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s'", pName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
-		return 0;
+		sync_barrier();
+		pLoad->m_State = LOADSTATE_FAILED;
+		return;
 	}
 
-	CSkinPart Part;
-	Part.m_OrgTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
-	Part.m_BloodColor = vec3(1.0f, 1.0f, 1.0f);
+	pLoad->m_BloodColor = vec3(1.0f, 1.0f, 1.0f);
 
-	unsigned char *d = (unsigned char *)Info.m_pData;
-	int Pitch = Info.m_Width*4;
+	unsigned char *d = (unsigned char *)pInfo->m_pData;
+	int Pitch = pInfo->m_Width*4;
 
 	// dig out blood color
-	if(pSelf->m_ScanningPart == SKINPART_BODY)
+	if(pLoad->m_Part == SKINPART_BODY)
 	{
-		int PartX = Info.m_Width/2;
+		int PartX = pInfo->m_Width/2;
 		int PartY = 0;
-		int PartWidth = Info.m_Width/2;
-		int PartHeight = Info.m_Height/2;
+		int PartWidth = pInfo->m_Width/2;
+		int PartHeight = pInfo->m_Height/2;
 
 		int aColors[3] = {0};
 		for(int y = PartY; y < PartY+PartHeight; y++)
@@ -69,14 +99,18 @@ int CSkins::SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser)
 				}
 			}
 
-		Part.m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
+		pLoad->m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
 	}
 
 	// create colorless version
-	int Step = Info.m_Format == CImageInfo::FORMAT_RGBA ? 4 : 3;
+	int Step = pInfo->m_Format == CImageInfo::FORMAT_RGBA ? 4 : 3;
+	int Size = pInfo->m_Width*pInfo->m_Height*Step;
+	pLoad->m_pColorData = (unsigned char *)mem_alloc(Size, 1);
+	mem_copy(pLoad->m_pColorData, d, Size);
+	d = pLoad->m_pColorData;
 
 	// make the texture gray scale
-	for(int i = 0; i < Info.m_Width*Info.m_Height; i++)
+	for(int i = 0; i < pInfo->m_Width*pInfo->m_Height; i++)
 	{
 		int v = (d[i*Step]+d[i*Step+1]+d[i*Step+2])/3;
 		d[i*Step] = v;
@@ -84,24 +118,75 @@ int CSkins::SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser)
 		d[i*Step+2] = v;
 	}
 
-	Part.m_ColorTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
-	mem_free(Info.m_pData);
+	sync_barrier(); // publish the data before the state
+	pLoad->m_State = LOADSTATE_DECODED;
+}
 
-	// set skin part data
-	Part.m_Flags = 0;
-	if(pName[0] == 'x' && pName[1] == '_')
-		Part.m_Flags |= SKINFLAG_SPECIAL;
-	if(DirType != IStorage::TYPE_SAVE)
-		Part.m_Flags |= SKINFLAG_STANDARD;
-	str_copy(Part.m_aName, pName, min((int)sizeof(Part.m_aName),l-3));
-	if(g_Config.m_Debug)
+int CSkins::LoadPartsThread(void *pUser)
+{
+	CLoadJob *pJob = (CLoadJob *)pUser;
+	CSkins *pSelf = pJob->m_pSkins;
+
+	for(int i = pJob->m_Index; i < pSelf->m_aPartLoads.size(); i += NUM_LOAD_JOBS)
+		pSelf->DecodePart(&pSelf->m_aPartLoads[i]);
+
+	return 0;
+}
+
+bool CSkins::LoadJobsDone() const
+{
+	for(int i = 0; i < NUM_LOAD_JOBS; i++)
 	{
-		str_format(aBuf, sizeof(aBuf), "load skin part %s", Part.m_aName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+		if(m_aLoadJobs[i].m_Job.Status() != CJob::STATE_DONE)
+			return false;
 	}
-	pSelf->m_aaSkinParts[pSelf->m_ScanningPart].add(Part);
+	return true;
+}
 
-	return 0;
+void CSkins::UploadParts(int *pBudget)
+{
+	char aBuf[256];
+	for(int i = m_FirstPartLoad; i < m_aPartLoads.size() && (!pBudget || *pBudget > 0); i++)
+	{
+		CPartLoad *pLoad = &m_aPartLoads[i];
+		if(pLoad->m_State == LOADSTATE_DECODED)
+		{
+			sync_barrier();
+			CImageInfo *pInfo = &pLoad->m_Info;
+			Graphics()->ReloadTextureRaw(pLoad->m_OrgTexture, pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pInfo->m_pData, pInfo->m_Format, 0);
+			Graphics()->ReloadTextureRaw(pLoad->m_ColorTexture, pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pLoad->m_pColorData, pInfo->m_Format, 0);
+			mem_free(pInfo->m_pData);
+			mem_free(pLoad->m_pColorData);
+			if(pLoad->m_pSkinPart)
+				pLoad->m_pSkinPart->m_BloodColor = pLoad->m_BloodColor;
+			if(pBudget)
+				*pBudget -= 2;
+
+			if(g_Config.m_Debug)
+			{
+				str_format(aBuf, sizeof(aBuf), "load skin part %s", pLoad->m_aFilename);
+				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+			}
+			pLoad->m_State = LOADSTATE_DONE;
+		}
+		else if(pLoad->m_State == LOADSTATE_FAILED)
+		{
+			str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s'", pLoad->m_aFilename);
+			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+			pLoad->m_State = LOADSTATE_DONE;
+		}
+
+		if(i == m_FirstPartLoad && pLoad->m_State == LOADSTATE_DONE)
+			m_FirstPartLoad++;
+	}
+
+	if(m_FirstPartLoad == m_aPartLoads.size() && LoadJobsDone())
+	{
+		str_format(aBuf, sizeof(aBuf), "loaded %d skin parts after %.2fms", m_aPartLoads.size(), ((time_get()-m_LoadStartTime)*1000)/(float)time_freq());
+		Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "skins", aBuf);
+		m_aPartLoads.clear();
+		m_FirstPartLoad = 0;
+	}
 }
 
 int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
@@ -215,6 +300,10 @@ int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
 
 void CSkins::OnInit()
 {
+	m_LoadStartTime = time_get();
+	m_aPartLoads.clear();
+	m_FirstPartLoad = 0;
+
 	for(int p = 0; p < NUM_SKINPARTS; p++)
 	{
 		m_aaSkinParts[p].clear();
@@ -246,6 +335,37 @@ void CSkins::OnInit()
 		}
 	}
 
+	// the skin part lists are final now, connect the loads with their parts
+	for(int i = 0; i < m_aPartLoads.size(); i++)
+	{
+		CPartLoad *pLoad = &m_aPartLoads[i];
+		for(int j = 0; j < m_aaSkinParts[pLoad->m_Part].size(); j++)
+		{
+			if(m_aaSkinParts[pLoad->m_Part][j].m_OrgTexture.Id() == pLoad->m_OrgTexture.Id())
+			{
+				pLoad->m_pSkinPart = &m_aaSkinParts[pLoad->m_Part][j];
+				break;
+			}
+		}
+	}
+
+	// decode the images on the job pool
+	if(g_Config.m_ClThreadimageloading)
+	{
+		for(int i = 0; i < NUM_LOAD_JOBS; i++)
+		{
+			m_aLoadJobs[i].m_pSkins = this;
+			m_aLoadJobs[i].m_Index = i;
+			m_pClient->Engine()->AddJob(&m_aLoadJobs[i].m_Job, LoadPartsThread, &m_aLoadJobs[i]);
+		}
+	}
+	else
+	{
+		for(int i = 0; i < m_aPartLoads.size(); i++)
+			DecodePart(&m_aPartLoads[i]);
+		UploadParts(0);
+	}
+
 	// create dummy skin
 	m_DummySkin.m_Flags = SKINFLAG_STANDARD;
 	str_copy(m_DummySkin.m_aName, "dummy", sizeof(m_DummySkin.m_aName));
@@ -289,6 +409,30 @@ void CSkins::OnInit()
 	}
 }
 
+void CSkins::OnShutdown()
+{
+	// wait for the decoding to finish before freeing its results
+	while(!LoadJobsDone())
+		thread_sleep(1);
+
+	for(int i = m_FirstPartLoad; i < m_aPartLoads.size(); i++)
+	{
+		if(m_aPartLoads[i].m_State == LOADSTATE_DECODED)
+		{
+			mem_free(m_aPartLoads[i].m_Info.m_pData);
+			mem_free(m_aPartLoads[i].m_pColorData);
+		}
+	}
+	m_aPartLoads.clear();
+	m_FirstPartLoad = 0;
+}
+
+void CSkins::OnRender()
+{
+	if(m_aPartLoads.size())
+		UploadParts(&m_pClient->m_TextureUploadBudget);
+}
+
 void CSkins::AddSkin(const char *pSkinName)
 {
 	CSkin Skin = m_DummySkin;
@@ -3,7 +3,9 @@
 #ifndef GAME_CLIENT_COMPONENTS_SKINS_H
 #define GAME_CLIENT_COMPONENTS_SKINS_H
 #include <base/vmath.h>
+#include <base/tl/array.h>
 #include <base/tl/sorted_array.h>
+#include <engine/engine.h>
 #include <game/client/component.h>
 
 // todo: fix duplicate skins (different paths)
@@ -56,6 +58,8 @@ public:
 
 	//
 	void OnInit();
+	void OnShutdown();
+	void OnRender();
 
 	void AddSkin(const char *pSkinName);
 	void RemoveSkin(const CSkin *pSkin);
@@ -72,11 +76,53 @@ public:
 	int GetTeamColor(int UseCustomColors, int PartColor, int Team, int Part) const;
 
 private:
+	enum
+	{
+		NUM_LOAD_JOBS=4,
+
+		LOADSTATE_PENDING=0,
+		LOADSTATE_DECODED,
+		LOADSTATE_FAILED,
+		LOADSTATE_DONE,
+	};
+
+	// a skin part image that is decoded on the job pool. the part gets
+	// transparent placeholder textures that are replaced once it's decoded
+	struct CPartLoad
+	{
+		int m_Part;
+		char m_aFilename[128];
+		int m_StorageType;
+		CSkinPart *m_pSkinPart;
+		IGraphics::CTextureHandle m_OrgTexture;
+		IGraphics::CTextureHandle m_ColorTexture;
+		CImageInfo m_Info;
+		unsigned char *m_pColorData;
+		vec3 m_BloodColor;
+		volatile int m_State;
+	};
+
+	struct CLoadJob
+	{
+		CSkins *m_pSkins;
+		int m_Index;
+		CJob m_Job;
+	} m_aLoadJobs[NUM_LOAD_JOBS];
+
+	array<CPartLoad> m_aPartLoads;
+	int m_FirstPartLoad;
+	int64 m_LoadStartTime;
+
 	int m_ScanningPart;
 	sorted_array<CSkinPart> m_aaSkinParts[NUM_SKINPARTS];
 	sorted_array<CSkin> m_aSkins;
 	CSkin m_DummySkin;
 
+	void DecodePart(CPartLoad *pLoad);
+	void UploadParts(int *pBudget);
+	bool LoadJobsDone() const;
+
+	static int LoadPartsThread(void *pUser);
 	static int SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser);
 	static int SkinScan(const char *pName, int IsDir, int DirType, void *pUser);
 };
@@ -253,6 +253,7 @@ void CGameClient::OnConsoleInit()
 
 	//
 	m_SuppressEvents = false;
+	m_TextureUploadBudget = 0;
 }
 
 void CGameClient::OnInit()
@@ -459,6 +460,8 @@ void CGameClient::OnRender()
 	// update the local character and spectate position
 	UpdatePositions();
 
+	m_TextureUploadBudget = g_Config.m_ClTextureUploadBudget;
+
 	// render all systems
 	for(int i = 0; i < m_All.m_Num; i++)
 		m_All.m_paComponents[i]->OnRender();
@@ -90,6 +90,9 @@ public:
 
 	bool m_SuppressEvents;
 
+	// number of streamed textures that may still be uploaded this frame
+	int m_TextureUploadBudget;
+
 	// TODO: move this
 	CTuningParams m_Tuning;
 
@@ -0,0 +1,192 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_CLIENT_PARTICLEPOOL_H
+#define GAME_CLIENT_PARTICLEPOOL_H
+#include <base/vmath.h>
+
+// particles
+struct CParticle
+{
+	void SetDefault()
+	{
+		m_Vel = vec2(0,0);
+		m_LifeSpan = 0;
+		m_StartSize = 32;
+		m_EndSize = 32;
+		m_Rot = 0;
+		m_Rotspeed = 0;
+		m_Gravity = 0;
+		m_Friction = 0;
+		m_FlowAffected = 1.0f;
+		m_Color = vec4(1,1,1,1);
+	}
+
+	vec2 m_Pos;
+	vec2 m_Vel;
+
+	int m_Spr;
+
+	float m_FlowAffected;
+
+	float m_LifeSpan;
+
+	float m_StartSize;
+	float m_EndSize;
+
+	float m_Rot;
+	float m_Rotspeed;
+
+	float m_Gravity;
+	float m_Friction;
+
+	vec4 m_Color;
+};
+
+// particles are stored as structure of arrays, so the update loops
+// run over tightly packed floats and can be vectorized by the compiler.
+// all groups share the arrays, each one owns a range that follows the
+// previous one. dead particles are removed by compacting the arrays.
+template<int TMAX, int TNUMGROUPS>
+struct CParticlePool
+{
+	int m_NumParticles;
+	int m_aStart[TNUMGROUPS];
+	int m_aNum[TNUMGROUPS];
+
+	float m_aPosX[TMAX];
+	float m_aPosY[TMAX];
+	float m_aVelX[TMAX];
+	float m_aVelY[TMAX];
+	float m_aLife[TMAX];
+	float m_aLifeSpan[TMAX];
+	float m_aStartSize[TMAX];
+	float m_aEndSize[TMAX];
+	float m_aRot[TMAX];
+	float m_aRotspeed[TMAX];
+	float m_aGravity[TMAX];
+	float m_aFriction[TMAX];
+	vec4 m_aColor[TMAX];
+	int m_aSpr[TMAX];
+
+	void Reset()
+	{
+		m_NumParticles = 0;
+		for(int g = 0; g < TNUMGROUPS; g++)
+		{
+			m_aStart[g] = 0;
+			m_aNum[g] = 0;
+		}
+	}
+
+	void Copy(int To, int From)
+	{
+		m_aPosX[To] = m_aPosX[From];
+		m_aPosY[To] = m_aPosY[From];
+		m_aVelX[To] = m_aVelX[From];
+		m_aVelY[To] = m_aVelY[From];
+		m_aLife[To] = m_aLife[From];
+		m_aLifeSpan[To] = m_aLifeSpan[From];
+		m_aStartSize[To] = m_aStartSize[From];
+		m_aEndSize[To] = m_aEndSize[From];
+		m_aRot[To] = m_aRot[From];
+		m_aRotspeed[To] = m_aRotspeed[From];
+		m_aGravity[To] = m_aGravity[From];
+		m_aFriction[To] = m_aFriction[From];
+		m_aColor[To] = m_aColor[From];
+		m_aSpr[To] = m_aSpr[From];
+	}
+
+	// returns false when the pool is full
+	bool Add(int Group, const CParticle *pPart)
+	{
+		if(m_NumParticles >= TMAX)
+			return false;
+
+		// make room at the end of the group, the first particle of each
+		// following group moves to the end of its range
+		for(int g = TNUMGROUPS-1; g > Group; g--)
+		{
+			if(m_aNum[g])
+				Copy(m_aStart[g]+m_aNum[g], m_aStart[g]);
+			m_aStart[g]++;
+		}
+
+		int Id = m_aStart[Group]+m_aNum[Group];
+		m_aNum[Group]++;
+		m_NumParticles++;
+
+		m_aPosX[Id] = pPart->m_Pos.x;
+		m_aPosY[Id] = pPart->m_Pos.y;
+		m_aVelX[Id] = pPart->m_Vel.x;
+		m_aVelY[Id] = pPart->m_Vel.y;
+		m_aLife[Id] = 0;
+		m_aLifeSpan[Id] = pPart->m_LifeSpan;
+		m_aStartSize[Id] = pPart->m_StartSize;
+		m_aEndSize[Id] = pPart->m_EndSize;
+		m_aRot[Id] = pPart->m_Rot;
+		m_aRotspeed[Id] = pPart->m_Rotspeed;
+		m_aGravity[Id] = pPart->m_Gravity;
+		m_aFriction[Id] = pPart->m_Friction;
+		m_aColor[Id] = pPart->m_Color;
+		m_aSpr[Id] = pPart->m_Spr;
+		return true;
+	}
+
+	// pMover->MovePoint(vec2 *pPos, vec2 *pVel) does the collision of one particle
+	template<class TMOVER>
+	void Update(float TimePassed, int FrictionCount, TMOVER *pMover)
+	{
+		const int Num = m_NumParticles;
+
+		// integrate velocity, rotation and age. these loops are branch free
+		// over plain float arrays so they compile to simd code
+		for(int i = 0; i < Num; i++)
+			m_aVelY[i] += m_aGravity[i]*TimePassed;
+
+		for(int f = 0; f < FrictionCount; f++) // apply friction
+		{
+			for(int i = 0; i < Num; i++)
+			{
+				m_aVelX[i] *= m_aFriction[i];
+				m_aVelY[i] *= m_aFriction[i];
+			}
+		}
+
+		for(int i = 0; i < Num; i++)
+		{
+			m_aLife[i] += TimePassed;
+			m_aRot[i] += TimePassed*m_aRotspeed[i];
+		}
+
+		// move the surviving points and compact away the dead ones
+		int NumAlive = 0;
+		int i = 0;
+		for(int g = 0; g < TNUMGROUPS; g++)
+		{
+			int End = i+m_aNum[g];
+			m_aStart[g] = NumAlive;
+			for(; i < End; i++)
+			{
+				// check particle death
+				if(m_aLife[i] > m_aLifeSpan[i])
+					continue;
+
+				vec2 Pos = vec2(m_aPosX[i], m_aPosY[i]);
+				vec2 Vel = vec2(m_aVelX[i], m_aVelY[i])*TimePassed;
+				pMover->MovePoint(&Pos, &Vel);
+				Vel *= 1.0f/TimePassed;
+
+				if(NumAlive != i)
+					Copy(NumAlive, i);
+				m_aPosX[NumAlive] = Pos.x;
+				m_aPosY[NumAlive] = Pos.y;
+				m_aVelX[NumAlive] = Vel.x;
+				m_aVelY[NumAlive] = Vel.y;
+				NumAlive++;
+			}
+			m_aNum[g] = NumAlive-m_aStart[g];
+		}
+		m_NumParticles = NumAlive;
+	}
+};
+#endif
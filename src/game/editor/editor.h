@@ -382,7 +382,7 @@ public:
 	void CreateDefault();
 
 	// io
-	int Save(class IStorage *pStorage, const char *pFilename);
+	int Save(class IStorage *pStorage, class IEngine *pEngine, const char *pFilename);
 	int Load(class IStorage *pStorage, const char *pFilename, int StorageType);
 };
 
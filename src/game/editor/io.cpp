@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <engine/client.h>
 #include <engine/console.h>
+#include <engine/engine.h>
 #include <engine/serverbrowser.h>
 #include <engine/storage.h>
 #include <game/gamecore.h> // StrToInts, IntsToStr
@@ -13,16 +14,16 @@ static int MakeVersion(int i, const T &v)
 
 int CEditor::Save(const char *pFilename)
 {
-	return m_Map.Save(Kernel()->RequestInterface<IStorage>(), pFilename);
+	return m_Map.Save(Kernel()->RequestInterface<IStorage>(), Kernel()->RequestInterface<IEngine>(), pFilename);
 }
 
-int CEditorMap::Save(class IStorage *pStorage, const char *pFileName)
+int CEditorMap::Save(class IStorage *pStorage, class IEngine *pEngine, const char *pFileName)
 {
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "saving to '%s'...", pFileName);
 	m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
 	CDataFileWriter df;
-	if(!df.Open(pStorage, pFileName))
+	if(!df.Open(pStorage, pFileName, pEngine, g_Config.m_EdCompressionLevel))
 	{
 		str_format(aBuf, sizeof(aBuf), "failed to open file '%s'...", pFileName);
 		m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
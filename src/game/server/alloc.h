@@ -6,12 +6,13 @@
 #include <new>
 
 #include <base/system.h>
+#include <engine/shared/config.h>
 
 #define MACRO_ALLOC_HEAP() \
 	public: \
 	void *operator new(size_t Size) \
 	{ \
-		void *p = mem_alloc(Size, 1); \
+		void *p = mem_alloc_tag(Size, 1, MEMTAG_ENTITIES); \
 		/*dbg_msg("", "++ %p %d", p, size);*/ \
 		mem_zero(p, Size); \
 		return p; \
@@ -29,15 +30,18 @@
 	void operator delete(void *p); \
 	private:
 
+// every server instance gets its own range of the pool
 #define MACRO_ALLOC_POOL_ID_IMPL(POOLTYPE, PoolSize) \
-	static char ms_PoolData##POOLTYPE[PoolSize][sizeof(POOLTYPE)] = {{0}}; \
-	static int ms_PoolUsed##POOLTYPE[PoolSize] = {0}; \
+	static char ms_PoolData##POOLTYPE[MAX_INSTANCES*PoolSize][sizeof(POOLTYPE)] = {{0}}; \
+	static int ms_PoolUsed##POOLTYPE[MAX_INSTANCES*PoolSize] = {0}; \
 	void *POOLTYPE::operator new(size_t Size, int id) \
 	{ \
 		dbg_assert(sizeof(POOLTYPE) == Size, "size error"); \
+		id += g_InstanceID*PoolSize; \
 		dbg_assert(!ms_PoolUsed##POOLTYPE[id], "already used"); \
 		/*dbg_msg("pool", "++ %s %d", #POOLTYPE, id);*/ \
 		ms_PoolUsed##POOLTYPE[id] = 1; \
+		mem_track(MEMTAG_ENTITIES, sizeof(POOLTYPE)); \
 		mem_zero(ms_PoolData##POOLTYPE[id], Size); \
 		return ms_PoolData##POOLTYPE[id]; \
 	} \
@@ -47,6 +51,7 @@
 		dbg_assert(ms_PoolUsed##POOLTYPE[id], "not used"); \
 		/*dbg_msg("pool", "-- %s %d", #POOLTYPE, id);*/ \
 		ms_PoolUsed##POOLTYPE[id] = 0; \
+		mem_track(MEMTAG_ENTITIES, -(int)sizeof(POOLTYPE)); \
 		mem_zero(ms_PoolData##POOLTYPE[id], sizeof(POOLTYPE)); \
 	}
 
@@ -8,6 +8,7 @@
 #include <game/server/player.h>
 
 #include "character.h"
+#include "flag.h"
 #include "laser.h"
 #include "projectile.h"
 
@@ -821,6 +822,37 @@ void CCharacter::Snap(int SnappingClient)
 	}
 }
 
+float CCharacter::SnapInterest(int SnappingClient)
+{
+	if(NetworkClipped(SnappingClient))
+		return -1.0f;
+
+	// the own and the spectated character are always needed
+	CPlayer *pSnapPlayer = GameServer()->m_apPlayers[SnappingClient];
+	if(m_pPlayer->GetCID() == SnappingClient || m_pPlayer->GetCID() == pSnapPlayer->GetSpectatorID())
+		return SNAPINTEREST_ALWAYS;
+
+	float Interest = DistanceInterest(SnappingClient, m_Pos);
+
+	// hooking each other
+	CCharacter *pSnapChar = GameServer()->GetPlayerChar(SnappingClient);
+	if(m_Core.m_HookedPlayer == SnappingClient || (pSnapChar && pSnapChar->m_Core.m_HookedPlayer == m_pPlayer->GetCID()))
+		Interest += 1.0f;
+
+	// flag carrier
+	for(CFlag *pFlag = (CFlag *)GameWorld()->FindFirst(CGameWorld::ENTTYPE_FLAG); pFlag; pFlag = (CFlag *)pFlag->TypeNext())
+	{
+		if(pFlag->GetCarrier() == this)
+			Interest += 1.0f;
+	}
+
+	// team mates
+	if(GameServer()->m_pController->IsTeamplay() && m_pPlayer->GetTeam() == pSnapPlayer->GetTeam())
+		Interest += 0.5f;
+
+	return Interest;
+}
+
 void CCharacter::PostSnap()
 {
 	m_TriggeredEvents = 0;
@@ -26,6 +26,7 @@ public:
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
 	virtual void PostSnap();
+	virtual float SnapInterest(int SnappingClient);
 
 	bool IsGrounded();
 
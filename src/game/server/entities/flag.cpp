@@ -81,6 +81,13 @@ void CFlag::TickPaused()
 		m_GrabTick++;
 }
 
+float CFlag::SnapInterest(int SnappingClient)
+{
+	if(NetworkClipped(SnappingClient))
+		return -1.0f;
+	return SNAPINTEREST_ALWAYS;
+}
+
 void CFlag::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
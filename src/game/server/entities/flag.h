@@ -38,6 +38,7 @@ public:
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
 	virtual void TickDefered();
+	virtual float SnapInterest(int SnappingClient);
 
 	/* Functions */
 	void Grab(class CCharacter *pChar);
@@ -97,6 +97,15 @@ void CLaser::TickPaused()
 	++m_EvalTick;
 }
 
+float CLaser::SnapInterest(int SnappingClient)
+{
+	if(NetworkClipped(SnappingClient) && NetworkClipped(SnappingClient, m_From))
+		return -1.0f;
+
+	// a bounce is visible for a few ticks only, a skipped snap can hide it entirely
+	return 0.5f + max(DistanceInterest(SnappingClient, m_Pos), DistanceInterest(SnappingClient, m_From));
+}
+
 void CLaser::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient) && NetworkClipped(SnappingClient, m_From))
@@ -134,6 +134,15 @@ void CPickup::TickPaused()
 		++m_SpawnTick;
 }
 
+float CPickup::SnapInterest(int SnappingClient)
+{
+	if(m_SpawnTick != -1 || NetworkClipped(SnappingClient))
+		return -1.0f;
+
+	// doesn't move or change, matters the least
+	return 0.5f*DistanceInterest(SnappingClient, m_Pos);
+}
+
 void CPickup::Snap(int SnappingClient)
 {
 	if(m_SpawnTick != -1 || NetworkClipped(SnappingClient))
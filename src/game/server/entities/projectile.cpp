@@ -97,6 +97,18 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 	pProj->m_Type = m_Type;
 }
 
+float CProjectile::SnapInterest(int SnappingClient)
+{
+	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
+	vec2 Pos = GetPos(Ct);
+
+	if(NetworkClipped(SnappingClient, Pos))
+		return -1.0f;
+
+	// flies for a second at most, a skipped snap shows it too late to dodge
+	return 0.5f + DistanceInterest(SnappingClient, Pos);
+}
+
 void CProjectile::Snap(int SnappingClient)
 {
 	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
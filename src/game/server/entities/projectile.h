@@ -16,6 +16,7 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual float SnapInterest(int SnappingClient);
 
 private:
 	vec2 m_Direction;
@@ -19,6 +19,9 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_MarkedForDestroy = false;
 	m_Pos = Pos;
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		m_aLastSnapTick[i] = -1;
 }
 
 CEntity::~CEntity()
@@ -48,6 +51,19 @@ int CEntity::NetworkClipped(int SnappingClient, vec2 CheckPos)
 	return 0;
 }
 
+float CEntity::DistanceInterest(int SnappingClient, vec2 CheckPos)
+{
+	// 1 at the view position down to 0 at the clipping distance
+	return max(0.0f, 1.0f - distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos)/1100.0f);
+}
+
+float CEntity::SnapInterest(int SnappingClient)
+{
+	if(NetworkClipped(SnappingClient))
+		return -1.0f;
+	return DistanceInterest(SnappingClient, m_Pos);
+}
+
 bool CEntity::GameLayerClipped(vec2 CheckPos)
 {
 	int rx = round_to_int(CheckPos.x) / 32;
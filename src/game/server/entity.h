@@ -38,6 +38,13 @@ private:
 	/* State */
 	bool m_MarkedForDestroy;
 
+	/*
+		Variable: m_aLastSnapTick
+			The tick the entity was last put into the snapshot of
+			each client, used to rate deferred entities higher.
+	*/
+	int m_aLastSnapTick[MAX_CLIENTS];
+
 protected:
 	/* State */
 
@@ -50,7 +57,16 @@ protected:
 	/* Getters */
 	int GetID() const					{ return m_ID; }
 
+	/* Interest */
+	float DistanceInterest(int SnappingClient, vec2 CheckPos);
+
 public:
+	/* Constants */
+	enum
+	{
+		SNAPINTEREST_ALWAYS=1000,
+	};
+
 	/* Constructor */
 	CEntity(CGameWorld *pGameWorld, int Objtype, vec2 Pos, int ProximityRadius=0);
 
@@ -121,6 +137,23 @@ public:
 
 	virtual void PostSnap() {}
 
+	/*
+		Function: SnapInterest
+			Rates how much a client wants to see the entity. Used to
+			pick the entities that fit into the snapshot when
+			sv_snap_budget limits its size.
+
+		Arguments:
+			SnappingClient - ID of the client which snapshot is
+				being generated.
+
+		Returns:
+			Negative if the entity doesn't have to be in the snapshot,
+			SNAPINTEREST_ALWAYS if it has to be in there regardless of
+			the budget. Otherwise higher values are more important.
+	*/
+	virtual float SnapInterest(int SnappingClient);
+
 	/*
 		Function: networkclipped(int snapping_client)
 			Performs a series of test to see if a client can see the
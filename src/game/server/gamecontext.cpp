@@ -1074,6 +1074,23 @@ void CGameContext::ConTuneDump(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CGameContext::ConSnapInterest(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	char aBuf[256];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CPlayer *pPlayer = pSelf->m_apPlayers[i];
+		if(!pPlayer)
+			continue;
+
+		int Total = max(pPlayer->m_SnapSent+pPlayer->m_SnapDeferred, 1);
+		str_format(aBuf, sizeof(aBuf), "id=%d name='%s' sent=%d deferred=%d (%d%%) culled=%d", i, pSelf->Server()->ClientName(i),
+			pPlayer->m_SnapSent, pPlayer->m_SnapDeferred, pPlayer->m_SnapDeferred*100/Total, pPlayer->m_SnapCulled);
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "snap", aBuf);
+	}
+}
+
 void CGameContext::ConPause(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
@@ -1395,6 +1412,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("tune", "si", CFGFLAG_SERVER, ConTuneParam, this, "Tune variable to value");
 	Console()->Register("tune_reset", "", CFGFLAG_SERVER, ConTuneReset, this, "Reset tuning");
 	Console()->Register("tune_dump", "", CFGFLAG_SERVER, ConTuneDump, this, "Dump tuning");
+	Console()->Register("snap_interest", "", CFGFLAG_SERVER, ConSnapInterest, this, "Show how many entities were sent, deferred and culled per player");
 
 	Console()->Register("pause", "?i", CFGFLAG_SERVER|CFGFLAG_STORE, ConPause, this, "Pause/unpause game");
 	Console()->Register("change_map", "?r", CFGFLAG_SERVER|CFGFLAG_STORE, ConChangeMap, this, "Change map");
@@ -1,11 +1,14 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 
+#include <engine/shared/config.h>
+
 #include "entities/character.h"
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
 #include "gameworld.h"
+#include "player.h"
 
 
 //////////////////////////////////////////////////
@@ -107,13 +110,71 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	// demos get everything, without a budget every client gets all it can see
+	if(SnappingClient == -1 || !g_Config.m_SvSnapBudget)
+	{
+		for(int i = 0; i < NUM_ENTTYPES; i++)
+			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+			{
+				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				pEnt->Snap(SnappingClient);
+				pEnt = m_pNextTraverseEntity;
+			}
+		return;
+	}
+
+	// rate the entities, highest interest first
+	CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+	CEntity *apEnts[MAX_SNAP_ENTITIES];
+	float aInterest[MAX_SNAP_ENTITIES];
+	int NumEnts = 0;
+	int Tick = Server()->Tick();
 	for(int i = 0; i < NUM_ENTTYPES; i++)
-		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
 		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
-			pEnt = m_pNextTraverseEntity;
+			float Interest = pEnt->SnapInterest(SnappingClient);
+			if(Interest < 0.0f)
+			{
+				pPlayer->m_SnapCulled++;
+				continue;
+			}
+			if(NumEnts == MAX_SNAP_ENTITIES)
+			{
+				pPlayer->m_SnapDeferred++;
+				continue;
+			}
+
+			// entities that were left out gain up to 2 within 2 seconds
+			if(Interest < CEntity::SNAPINTEREST_ALWAYS)
+			{
+				int Waited = pEnt->m_aLastSnapTick[SnappingClient] < 0 ? 2*Server()->TickSpeed() : Tick-pEnt->m_aLastSnapTick[SnappingClient];
+				Interest += min(Waited/(float)Server()->TickSpeed(), 2.0f);
+			}
+
+			int Index = NumEnts++;
+			for(; Index > 0 && aInterest[Index-1] < Interest; Index--)
+			{
+				apEnts[Index] = apEnts[Index-1];
+				aInterest[Index] = aInterest[Index-1];
+			}
+			apEnts[Index] = pEnt;
+			aInterest[Index] = Interest;
 		}
+
+	// snap until the budget is used up, the rest waits for a later snapshot
+	int StartSize = Server()->SnapSize();
+	for(int i = 0; i < NumEnts; i++)
+	{
+		if(aInterest[i] < CEntity::SNAPINTEREST_ALWAYS && Server()->SnapSize()-StartSize >= g_Config.m_SvSnapBudget)
+		{
+			pPlayer->m_SnapDeferred += NumEnts-i;
+			break;
+		}
+
+		apEnts[i]->Snap(SnappingClient);
+		apEnts[i]->m_aLastSnapTick[SnappingClient] = Tick;
+		pPlayer->m_SnapSent++;
+	}
 }
 
 void CGameWorld::PostSnap()
@@ -18,6 +18,8 @@ class CGameWorld
 public:
 	enum
 	{
+		MAX_SNAP_ENTITIES = 512,
+
 		ENTTYPE_PROJECTILE = 0,
 		ENTTYPE_LASER,
 		ENTTYPE_PICKUP,
@@ -134,6 +136,11 @@ public:
 		Arguments:
 			snapping_client - ID of the client which snapshot
 			is being created.
+
+		Remarks:
+			With sv_snap_budget set, the entities are snapped by
+			their interest until the budget is used up. The others
+			gain interest the longer they wait.
 	*/
 	void Snap(int SnappingClient);
 	
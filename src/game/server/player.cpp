@@ -33,6 +33,9 @@ CPlayer::CPlayer(CGameContext *pGameServer, int ClientID, bool Dummy)
 	m_RespawnDisabled = GameServer()->m_pController->GetStartRespawnState();
 	m_DeadSpecMode = false;
 	m_Spawning = 0;
+	m_SnapSent = 0;
+	m_SnapCulled = 0;
+	m_SnapDeferred = 0;
 }
 
 CPlayer::~CPlayer()
@@ -430,6 +433,7 @@ void CPlayer::SetTeam(int Team, bool DoChatMsg)
 	KillCharacter();
 
 	m_Team = Team;
+	Server()->ExpireServerInfo();
 	m_LastActionTick = Server()->Tick();
 	m_SpecMode = SPEC_FREEVIEW;
 	m_SpectatorID = -1;
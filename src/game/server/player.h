@@ -64,6 +64,11 @@ public:
 
 	bool m_RespawnDisabled;
 
+	// entities in view that went into the snapshot, were out of view or left out by sv_snap_budget
+	int m_SnapSent;
+	int m_SnapCulled;
+	int m_SnapDeferred;
+
 	//
 	int m_Vote;
 	int m_VotePos;
@@ -0,0 +1,159 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stddef.h> // size_t
+
+#include <base/system.h>
+
+#include <engine/shared/memheap.h>
+
+// checks alignment, oversized chunks, nested scopes and Reset() of CHeap
+// and measures per tick temporaries against mem_alloc/mem_free
+
+enum
+{
+	NUM_SMALL=100,
+	SMALL_SIZE=5000,
+	BIG_SIZE=200*1024,
+};
+
+static unsigned s_Seed = 1;
+static unsigned Rand()
+{
+	s_Seed = s_Seed*1103515245+12345;
+	return s_Seed>>8;
+}
+
+static bool Fail(const char *pWhat)
+{
+	dbg_msg("heap_bench", "failed: %s", pWhat);
+	return false;
+}
+
+static bool CheckAlignment(CHeap *pHeap)
+{
+	for(int i = 0; i < 10000; i++)
+	{
+		unsigned Alignment = 1<<(Rand()%5);
+		unsigned Size = 1+Rand()%300;
+		char *pMem = (char *)pHeap->Allocate(Size, Alignment);
+		if(!pMem)
+			return Fail("allocation");
+		if((size_t)pMem&(Alignment-1))
+			return Fail("alignment");
+		mem_zero(pMem, Size);
+	}
+	return true;
+}
+
+static bool CheckScopes(CHeap *pHeap)
+{
+	char *pFirst = (char *)pHeap->Allocate(16, 16);
+	unsigned Used = pHeap->Used();
+	unsigned Size;
+	{
+		CHeapScope Outer(pHeap);
+		for(int i = 0; i < NUM_SMALL; i++)
+			mem_zero(pHeap->Allocate(SMALL_SIZE), SMALL_SIZE);
+
+		// larger than a chunk, gets one of its own
+		char *pBig = (char *)pHeap->Allocate(BIG_SIZE);
+		if(!pBig)
+			return Fail("oversized allocation");
+		mem_zero(pBig, BIG_SIZE);
+
+		unsigned OuterUsed = pHeap->Used();
+		{
+			CHeapScope Inner(pHeap);
+			mem_zero(pHeap->Allocate(BIG_SIZE), BIG_SIZE);
+		}
+		if(pHeap->Used() != OuterUsed)
+			return Fail("inner scope");
+		Size = pHeap->Size();
+	}
+	if(pHeap->Used() != Used)
+		return Fail("outer scope");
+
+	// the same work again has to get along with the chunks already there
+	for(int r = 0; r < 1000; r++)
+	{
+		CHeapScope Scope(pHeap);
+		for(int i = 0; i < NUM_SMALL; i++)
+			pHeap->Allocate(SMALL_SIZE);
+		pHeap->Allocate(BIG_SIZE);
+		CHeapScope Inner(pHeap);
+		pHeap->Allocate(BIG_SIZE);
+	}
+	if(pHeap->Size() != Size)
+		return Fail("heap grew over repeated scopes");
+	if((char *)pHeap->Allocate(1, 1) != pFirst+16)
+		return Fail("rewind position");
+	return true;
+}
+
+static bool CheckReset(CHeap *pHeap)
+{
+	// rewinds left chunks in the spare list, Reset() has to free them
+	{
+		CHeapScope Scope(pHeap);
+		for(int i = 0; i < 4; i++)
+			pHeap->Allocate(BIG_SIZE);
+	}
+	pHeap->Reset();
+	if(pHeap->Used() != 0)
+		return Fail("used after reset");
+	if(pHeap->Size() != 64*1024)
+		return Fail("size after reset");
+	char *pMem = (char *)pHeap->Allocate(1, 1);
+	pHeap->Reset();
+	if(pHeap->Allocate(1, 1) != pMem)
+		return Fail("first chunk after reset");
+	pHeap->Reset();
+	return true;
+}
+
+// returns the time of one tick in ns
+static double RunTicks(CHeap *pHeap, int Num)
+{
+	void *apMem[NUM_SMALL];
+	int64 Start = time_get();
+	for(int r = 0; r < Num; r++)
+	{
+		if(pHeap)
+		{
+			CHeapScope Scope(pHeap);
+			for(int i = 0; i < NUM_SMALL; i++)
+				apMem[i] = pHeap->Allocate(8+i*8);
+			for(int i = 0; i < NUM_SMALL; i++)
+				*(char *)apMem[i] = i;
+		}
+		else
+		{
+			for(int i = 0; i < NUM_SMALL; i++)
+				apMem[i] = mem_alloc(8+i*8, 1);
+			for(int i = 0; i < NUM_SMALL; i++)
+				*(char *)apMem[i] = i;
+			for(int i = 0; i < NUM_SMALL; i++)
+				mem_free(apMem[i]);
+		}
+	}
+	return (time_get()-Start)*1000000000.0/time_freq()/Num;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int Num = argc > 1 ? str_toint(argv[1]) : 100000;
+	if(Num < 1)
+		Num = 1;
+
+	CHeap Heap;
+	if(!CheckAlignment(&Heap) || !CheckScopes(&Heap) || !CheckReset(&Heap))
+		return 1;
+	dbg_msg("heap_bench", "checks passed");
+
+	double HeapTime = RunTicks(&Heap, Num);
+	dbg_msg("heap_bench", "%d allocations per tick: heap %.0fns, mem_alloc %.0fns, high water %u bytes",
+		NUM_SMALL, HeapTime, RunTicks(0, Num), Heap.HighWater());
+	return 0;
+}
@@ -0,0 +1,199 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#if defined(CONF_FAMILY_UNIX) && !defined(CONF_PLATFORM_MACOSX)
+	#include <pthread.h>
+	#include <semaphore.h>
+	#define LOCK_BENCH_POSIX 1
+#endif
+
+// contended lock throughput and semaphore wake latency of base/system,
+// against plain pthread mutexes and posix semaphores where there are some
+
+enum
+{
+	MAX_THREADS=16,
+};
+
+struct CLockRun
+{
+	LOCK m_Lock;
+#if defined(LOCK_BENCH_POSIX)
+	pthread_mutex_t m_Mutex;
+#endif
+	bool m_Posix;
+	int m_Num;
+	volatile unsigned m_Counter;
+};
+
+static void LockThread(void *pUser)
+{
+	CLockRun *pRun = (CLockRun *)pUser;
+	for(int i = 0; i < pRun->m_Num; i++)
+	{
+#if defined(LOCK_BENCH_POSIX)
+		if(pRun->m_Posix)
+		{
+			pthread_mutex_lock(&pRun->m_Mutex);
+			pRun->m_Counter++;
+			pthread_mutex_unlock(&pRun->m_Mutex);
+			continue;
+		}
+#endif
+		lock_wait(pRun->m_Lock);
+		pRun->m_Counter++;
+		lock_unlock(pRun->m_Lock);
+	}
+}
+
+// returns the lock and unlock pairs per second, -1 when counts got lost
+static double RunLocks(bool Posix, int NumThreads, int Num)
+{
+	CLockRun Run;
+	Run.m_Lock = lock_create();
+#if defined(LOCK_BENCH_POSIX)
+	pthread_mutex_init(&Run.m_Mutex, 0);
+#endif
+	Run.m_Posix = Posix;
+	Run.m_Num = Num;
+	Run.m_Counter = 0;
+
+	void *apThreads[MAX_THREADS];
+	int64 Start = time_get();
+	for(int i = 0; i < NumThreads; i++)
+		apThreads[i] = thread_init(LockThread, &Run);
+	for(int i = 0; i < NumThreads; i++)
+	{
+		thread_wait(apThreads[i]);
+		thread_destroy(apThreads[i]);
+	}
+	int64 Time = time_get()-Start;
+
+	lock_destroy(Run.m_Lock);
+#if defined(LOCK_BENCH_POSIX)
+	pthread_mutex_destroy(&Run.m_Mutex);
+#endif
+	if(Run.m_Counter != (unsigned)(NumThreads*Num))
+		return -1.0;
+	return (double)NumThreads*Num*time_freq()/Time;
+}
+
+#if !defined(CONF_PLATFORM_MACOSX)
+struct CPingRun
+{
+	SEMAPHORE m_aSem[2];
+#if defined(LOCK_BENCH_POSIX)
+	sem_t m_aPosixSem[2];
+#endif
+	bool m_Posix;
+	int m_Num;
+};
+
+static void Wait(CPingRun *pRun, int Index)
+{
+#if defined(LOCK_BENCH_POSIX)
+	if(pRun->m_Posix)
+	{
+		sem_wait(&pRun->m_aPosixSem[Index]);
+		return;
+	}
+#endif
+	semaphore_wait(&pRun->m_aSem[Index]);
+}
+
+static void Signal(CPingRun *pRun, int Index)
+{
+#if defined(LOCK_BENCH_POSIX)
+	if(pRun->m_Posix)
+	{
+		sem_post(&pRun->m_aPosixSem[Index]);
+		return;
+	}
+#endif
+	semaphore_signal(&pRun->m_aSem[Index]);
+}
+
+static void PongThread(void *pUser)
+{
+	CPingRun *pRun = (CPingRun *)pUser;
+	for(int i = 0; i < pRun->m_Num; i++)
+	{
+		Wait(pRun, 0);
+		Signal(pRun, 1);
+	}
+}
+
+// two threads wake each other in turn, returns the time of one wake up in ns
+static double RunPingPong(bool Posix, int Num)
+{
+	CPingRun Run;
+	for(int i = 0; i < 2; i++)
+	{
+		semaphore_init(&Run.m_aSem[i]);
+#if defined(LOCK_BENCH_POSIX)
+		sem_init(&Run.m_aPosixSem[i], 0, 0);
+#endif
+	}
+	Run.m_Posix = Posix;
+	Run.m_Num = Num;
+
+	void *pThread = thread_init(PongThread, &Run);
+	int64 Start = time_get();
+	for(int i = 0; i < Num; i++)
+	{
+		Signal(&Run, 0);
+		Wait(&Run, 1);
+	}
+	int64 Time = time_get()-Start;
+	thread_wait(pThread);
+	thread_destroy(pThread);
+
+	for(int i = 0; i < 2; i++)
+	{
+		semaphore_destroy(&Run.m_aSem[i]);
+#if defined(LOCK_BENCH_POSIX)
+		sem_destroy(&Run.m_aPosixSem[i]);
+#endif
+	}
+	return Time*1000000000.0/time_freq()/(2.0*Num);
+}
+#endif
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int Num = argc > 1 ? str_toint(argv[1]) : 1000000;
+	int MaxThreads = argc > 2 ? str_toint(argv[2]) : 4;
+	if(Num < 1)
+		Num = 1;
+	if(MaxThreads < 1 || MaxThreads > MAX_THREADS)
+		MaxThreads = 4;
+
+	for(int Threads = 1; Threads <= MaxThreads; Threads *= 2)
+	{
+		double Ops = RunLocks(false, Threads, Num/Threads);
+		if(Ops < 0)
+		{
+			dbg_msg("lock_bench", "lock lost counts with %d threads", Threads);
+			return 1;
+		}
+#if defined(LOCK_BENCH_POSIX)
+		dbg_msg("lock_bench", "%d threads: lock %.1fM/s, pthread mutex %.1fM/s", Threads, Ops/1000000.0, RunLocks(true, Threads, Num/Threads)/1000000.0);
+#else
+		dbg_msg("lock_bench", "%d threads: lock %.1fM/s", Threads, Ops/1000000.0);
+#endif
+	}
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	int NumPings = Num/10 > 0 ? Num/10 : 1;
+#if defined(LOCK_BENCH_POSIX)
+	dbg_msg("lock_bench", "wake up: semaphore %.0fns, posix semaphore %.0fns", RunPingPong(false, NumPings), RunPingPong(true, NumPings));
+#else
+	dbg_msg("lock_bench", "wake up: semaphore %.0fns", RunPingPong(false, NumPings));
+#endif
+#endif
+	return 0;
+}
@@ -1,6 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/system.h>
+#include <engine/engine.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 
@@ -13,15 +14,23 @@ int main(int argc, const char **argv)
 	CDataFileReader DataFile;
 	CDataFileWriter df;
 
-	if(!pStorage || argc != 3)
+	if(!pStorage || (argc != 3 && argc != 4))
+	{
+		dbg_msg("map_resave", "usage: map_resave <in> <out> [compression level]");
 		return -1;
+	}
 
 	str_format(aFileName, sizeof(aFileName), "%s", argv[2]);
 
 	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ALL))
 		return -1;
-	if(!df.Open(pStorage, aFileName))
+	IEngine *pEngine = CreateEngine("Teeworlds", 4);
+	int CompressionLevel = argc == 4 ? str_toint(argv[3]) : CDataFileWriter::COMPRESSION_DEFAULT;
+	if(!df.Open(pStorage, aFileName, pEngine, CompressionLevel))
+	{
+		delete pEngine;
 		return -1;
+	}
 
 	// add all items
 	for(Index = 0; Index < DataFile.NumItems(); Index++)
@@ -41,5 +50,6 @@ int main(int argc, const char **argv)
 
 	DataFile.Close();
 	df.Finish();
+	delete pEngine;
 	return 0;
 }
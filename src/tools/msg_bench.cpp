@@ -0,0 +1,143 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/message.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+
+#include <generated/protocol.h>
+
+// times packing and unpacking of the most frequent messages. the input
+// message is packed field by field against the int run the client uses
+
+enum
+{
+	NUM_LOOPS=1000000,
+	INPUT_INTS=10,
+};
+
+static int s_aInput[INPUT_INTS] = { 1, 0, 0, 320, -64, 0, 0, 1, 1, 0 };
+static volatile int s_Sink; // keeps the unpacked values alive
+
+static double Nanoseconds(int64 Time)
+{
+	return Time*1000000000.0/time_freq()/NUM_LOOPS;
+}
+
+// unpacks a message the way the generated code does, without the range checks
+static int64 TimeUnpack(const CMsgPacker *pRef, int NumInts, bool String)
+{
+	int Sum = 0;
+	int64 Start = time_get();
+	for(int l = 0; l < NUM_LOOPS; l++)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(pRef->Data(), pRef->Size());
+		Unpacker.GetInt();
+		for(int i = 0; i < NumInts; i++)
+			Sum += Unpacker.GetInt();
+		if(String)
+			Sum += Unpacker.GetString(CUnpacker::SANITIZE_CC|CUnpacker::SKIP_START_WHITESPACES)[0];
+	}
+	int64 Time = time_get()-Start;
+	s_Sink = Sum;
+	return Time;
+}
+
+static void BenchChat()
+{
+	CNetMsg_Sv_Chat Msg;
+	Msg.m_Mode = CHAT_ALL;
+	Msg.m_ClientID = 3;
+	Msg.m_TargetID = -1;
+	Msg.m_pMessage = "gg";
+	int Size = 0;
+
+	int64 Start = time_get();
+	for(int l = 0; l < NUM_LOOPS; l++)
+	{
+		CMsgPacker Packer(Msg.MsgID());
+		Msg.Pack(&Packer);
+		Size += Packer.Size();
+	}
+	int64 PackTime = time_get()-Start;
+
+	CMsgPacker Ref(Msg.MsgID());
+	Msg.Pack(&Ref);
+	dbg_msg("msg_bench", "%-10s %2d bytes, pack %6.1fns, unpack %6.1fns", "Sv_Chat", Size/NUM_LOOPS,
+		Nanoseconds(PackTime), Nanoseconds(TimeUnpack(&Ref, 3, true)));
+}
+
+static void BenchKillMsg()
+{
+	CNetMsg_Sv_KillMsg Msg;
+	Msg.m_Killer = 1;
+	Msg.m_Victim = 7;
+	Msg.m_Weapon = WEAPON_GRENADE;
+	Msg.m_ModeSpecial = 0;
+	int Size = 0;
+
+	int64 Start = time_get();
+	for(int l = 0; l < NUM_LOOPS; l++)
+	{
+		CMsgPacker Packer(Msg.MsgID());
+		Msg.Pack(&Packer);
+		Size += Packer.Size();
+	}
+	int64 PackTime = time_get()-Start;
+
+	CMsgPacker Ref(Msg.MsgID());
+	Msg.Pack(&Ref);
+	dbg_msg("msg_bench", "%-10s %2d bytes, pack %6.1fns, unpack %6.1fns", "Sv_KillMsg", Size/NUM_LOOPS,
+		Nanoseconds(PackTime), Nanoseconds(TimeUnpack(&Ref, 4, false)));
+}
+
+static void BenchInput()
+{
+	int Size = 0, RefSize = 0;
+	int64 Start = time_get();
+	for(int l = 0; l < NUM_LOOPS; l++)
+	{
+		CMsgPacker Packer(NETMSG_INPUT, true);
+		Packer.AddInt(l);
+		Packer.AddInt(l+2);
+		Packer.AddInt(INPUT_INTS*4);
+		for(int i = 0; i < INPUT_INTS; i++)
+			Packer.AddInt(s_aInput[i]);
+		Packer.AddInt(12);
+		RefSize = Packer.Size();
+	}
+	int64 FieldTime = time_get()-Start;
+	Start = time_get();
+	for(int l = 0; l < NUM_LOOPS; l++)
+	{
+		CMsgPacker Packer(NETMSG_INPUT, true);
+		Packer.AddInt(l);
+		Packer.AddInt(l+2);
+		Packer.AddInt(INPUT_INTS*4);
+		Packer.AddInts(s_aInput, INPUT_INTS);
+		Packer.AddInt(12);
+		Size = Packer.Size();
+	}
+	int64 RunTime = time_get()-Start;
+
+	CMsgPacker Ref(NETMSG_INPUT, true);
+	Ref.AddInt(1000);
+	Ref.AddInt(1002);
+	Ref.AddInt(INPUT_INTS*4);
+	Ref.AddInts(s_aInput, INPUT_INTS);
+	Ref.AddInt(12);
+	dbg_msg("msg_bench", "%-10s %2d bytes, pack %6.1fns, pack as run %6.1fns, unpack %6.1fns%s", "input", RefSize,
+		Nanoseconds(FieldTime), Nanoseconds(RunTime), Nanoseconds(TimeUnpack(&Ref, 3+INPUT_INTS+1, false)),
+		Size == RefSize ? "" : " SIZE MISMATCH");
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+	BenchChat();
+	BenchKillMsg();
+	BenchInput();
+	return 0;
+}
@@ -0,0 +1,201 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <game/client/particlepool.h>
+
+// updates 100k particles with the particle pool of the client and with the
+// linked lists it used before, both with the same floor bounce as collision
+
+enum
+{
+	MAX_PARTICLES=100000,
+	NUM_GROUPS=3,
+	NUM_FRAMES=600,
+};
+
+static unsigned s_Seed = 1;
+static float Rand()
+{
+	s_Seed = s_Seed*1103515245+12345;
+	return (s_Seed>>8)/(float)(1<<24);
+}
+
+struct CMover
+{
+	void MovePoint(vec2 *pPos, vec2 *pVel)
+	{
+		if(pPos->y+pVel->y > 1000.0f)
+			pVel->y *= -0.5f;
+		*pPos += *pVel;
+	}
+};
+
+// the particle list of the client before the pool
+struct CListParticle : public CParticle
+{
+	float m_Life;
+	int m_PrevPart;
+	int m_NextPart;
+};
+
+class CListParticles
+{
+public:
+	CListParticle m_aParticles[MAX_PARTICLES];
+	int m_FirstFree;
+	int m_aFirstPart[NUM_GROUPS];
+
+	void Reset()
+	{
+		for(int i = 0; i < MAX_PARTICLES; i++)
+		{
+			m_aParticles[i].m_PrevPart = i-1;
+			m_aParticles[i].m_NextPart = i+1;
+		}
+		m_aParticles[0].m_PrevPart = 0;
+		m_aParticles[MAX_PARTICLES-1].m_NextPart = -1;
+		m_FirstFree = 0;
+		for(int i = 0; i < NUM_GROUPS; i++)
+			m_aFirstPart[i] = -1;
+	}
+
+	bool Add(int Group, const CParticle *pPart)
+	{
+		if(m_FirstFree == -1)
+			return false;
+		int Id = m_FirstFree;
+		m_FirstFree = m_aParticles[Id].m_NextPart;
+		if(m_FirstFree != -1)
+			m_aParticles[m_FirstFree].m_PrevPart = -1;
+		*(CParticle *)&m_aParticles[Id] = *pPart;
+		m_aParticles[Id].m_PrevPart = -1;
+		m_aParticles[Id].m_NextPart = m_aFirstPart[Group];
+		if(m_aFirstPart[Group] != -1)
+			m_aParticles[m_aFirstPart[Group]].m_PrevPart = Id;
+		m_aFirstPart[Group] = Id;
+		m_aParticles[Id].m_Life = 0;
+		return true;
+	}
+
+	void Update(float TimePassed, int FrictionCount, CMover *pMover)
+	{
+		for(int g = 0; g < NUM_GROUPS; g++)
+		{
+			int i = m_aFirstPart[g];
+			while(i != -1)
+			{
+				CListParticle *p = &m_aParticles[i];
+				int Next = p->m_NextPart;
+				p->m_Vel.y += p->m_Gravity*TimePassed;
+				for(int f = 0; f < FrictionCount; f++)
+					p->m_Vel *= p->m_Friction;
+				vec2 Vel = p->m_Vel*TimePassed;
+				pMover->MovePoint(&p->m_Pos, &Vel);
+				p->m_Vel = Vel*(1.0f/TimePassed);
+				p->m_Life += TimePassed;
+				p->m_Rot += TimePassed*p->m_Rotspeed;
+
+				if(p->m_Life > p->m_LifeSpan)
+				{
+					if(p->m_PrevPart != -1)
+						m_aParticles[p->m_PrevPart].m_NextPart = p->m_NextPart;
+					else
+						m_aFirstPart[g] = p->m_NextPart;
+					if(p->m_NextPart != -1)
+						m_aParticles[p->m_NextPart].m_PrevPart = p->m_PrevPart;
+					if(m_FirstFree != -1)
+						m_aParticles[m_FirstFree].m_PrevPart = i;
+					p->m_PrevPart = -1;
+					p->m_NextPart = m_FirstFree;
+					m_FirstFree = i;
+				}
+				i = Next;
+			}
+		}
+	}
+};
+
+static void RandomParticle(CParticle *pPart)
+{
+	pPart->SetDefault();
+	pPart->m_Pos = vec2(Rand()*2000.0f, Rand()*1000.0f);
+	pPart->m_Vel = vec2(Rand()*200.0f-100.0f, Rand()*200.0f-100.0f);
+	pPart->m_LifeSpan = 0.5f+Rand();
+	pPart->m_Rotspeed = Rand()*10.0f;
+	pPart->m_Gravity = Rand()*1000.0f;
+	pPart->m_Friction = 0.7f+Rand()*0.3f;
+	pPart->m_Spr = 0;
+}
+
+// refills the pool before each frame at 60 fps, returns the ns per particle update
+template<class T>
+static double Run(T *pParticles)
+{
+	CMover Mover;
+	CParticle Part;
+	int64 Time = 0;
+	float FrictionFraction = 0;
+	s_Seed = 1;
+
+	pParticles->Reset();
+	for(int f = 0; f < NUM_FRAMES; f++)
+	{
+		for(int n = 0; n < MAX_PARTICLES; n++)
+		{
+			RandomParticle(&Part);
+			if(!pParticles->Add(n%NUM_GROUPS, &Part))
+				break;
+		}
+
+		FrictionFraction += 1.0f/60.0f;
+		int FrictionCount = 0;
+		while(FrictionFraction > 0.05f)
+		{
+			FrictionCount++;
+			FrictionFraction -= 0.05f;
+		}
+
+		int64 Start = time_get();
+		pParticles->Update(1.0f/60.0f, FrictionCount, &Mover);
+		Time += time_get()-Start;
+	}
+	return Time*1000000000.0/time_freq()/((double)NUM_FRAMES*MAX_PARTICLES);
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	// too large for the stack
+	CParticlePool<MAX_PARTICLES, NUM_GROUPS> *pPool = new CParticlePool<MAX_PARTICLES, NUM_GROUPS>;
+	CListParticles *pList = new CListParticles;
+
+	double PoolTime = Run(pPool);
+	double ListTime = Run(pList);
+
+	// the pool keeps the ranges of the groups intact
+	int Next = 0;
+	for(int g = 0; g < NUM_GROUPS; g++)
+	{
+		if(pPool->m_aStart[g] != Next)
+		{
+			dbg_msg("particle_bench", "group %d starts at %d instead of %d", g, pPool->m_aStart[g], Next);
+			return 1;
+		}
+		Next += pPool->m_aNum[g];
+	}
+	if(Next != pPool->m_NumParticles)
+	{
+		dbg_msg("particle_bench", "groups hold %d particles, the pool %d", Next, pPool->m_NumParticles);
+		return 1;
+	}
+
+	dbg_msg("particle_bench", "%d particles, %d frames: pool %.2fns per particle, linked lists %.2fns per particle",
+		MAX_PARTICLES, NUM_FRAMES, PoolTime, ListTime);
+	dbg_msg("particle_bench", "pool %d bytes, linked lists %d bytes", (int)sizeof(*pPool), (int)sizeof(*pList));
+
+	delete pPool;
+	delete pList;
+	return 0;
+}
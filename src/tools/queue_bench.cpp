@@ -0,0 +1,146 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+// stress test and throughput of the lock-free queues in base/tl/threading.h,
+// against a ring buffer behind a lock
+
+enum
+{
+	QUEUE_SIZE=1024,
+	MAX_PRODUCERS=8,
+};
+
+// a ring buffer with a lock as baseline
+class CLockedRing
+{
+	lock m_Lock;
+	unsigned m_aItems[QUEUE_SIZE];
+	unsigned m_Head;
+	unsigned m_Tail;
+
+public:
+	CLockedRing() { m_Head = m_Tail = 0; }
+
+	bool push(unsigned Item)
+	{
+		scope_lock Lock(&m_Lock);
+		if(m_Tail-m_Head == QUEUE_SIZE)
+			return false;
+		m_aItems[m_Tail++&(QUEUE_SIZE-1)] = Item;
+		return true;
+	}
+
+	bool pop(unsigned *pItem)
+	{
+		scope_lock Lock(&m_Lock);
+		if(m_Head == m_Tail)
+			return false;
+		*pItem = m_aItems[m_Head++&(QUEUE_SIZE-1)];
+		return true;
+	}
+
+	void pop_wait(unsigned *pItem)
+	{
+		while(!pop(pItem))
+			thread_yield();
+	}
+
+	void signal() {}
+};
+
+template<class QUEUE>
+struct CRun
+{
+	QUEUE *m_pQueue;
+	int m_Producer;
+	int m_Num;
+};
+
+template<class QUEUE>
+static void ProducerThread(void *pUser)
+{
+	CRun<QUEUE> *pRun = (CRun<QUEUE> *)pUser;
+	for(int i = 0; i < pRun->m_Num; i++)
+	{
+		// producer in the top bits, its sequence below
+		unsigned Item = (pRun->m_Producer<<24)|i;
+		while(!pRun->m_pQueue->push(Item))
+		{
+			// full, make sure the consumer isn't asleep
+			pRun->m_pQueue->signal();
+			thread_yield();
+		}
+		if((i&63) == 63 || i == pRun->m_Num-1)
+			pRun->m_pQueue->signal();
+	}
+}
+
+// returns false when an item got lost, doubled or out of order
+template<class QUEUE>
+static bool Run(const char *pName, int NumProducers, int NumPerProducer)
+{
+	QUEUE *pQueue = new QUEUE;
+	CRun<QUEUE> aRuns[MAX_PRODUCERS];
+	void *apThreads[MAX_PRODUCERS];
+	int aNext[MAX_PRODUCERS] = {0};
+
+	int64 Start = time_get();
+	for(int p = 0; p < NumProducers; p++)
+	{
+		aRuns[p].m_pQueue = pQueue;
+		aRuns[p].m_Producer = p;
+		aRuns[p].m_Num = NumPerProducer;
+		apThreads[p] = thread_init(ProducerThread<QUEUE>, &aRuns[p]);
+	}
+
+	bool Ok = true;
+	for(int i = 0; i < NumProducers*NumPerProducer; i++)
+	{
+		unsigned Item;
+		pQueue->pop_wait(&Item);
+		int Producer = Item>>24;
+		if(Producer >= NumProducers || (int)(Item&0xffffff) != aNext[Producer])
+		{
+			dbg_msg("queue_bench", "%s: unexpected item %x", pName, Item);
+			Ok = false;
+			break;
+		}
+		aNext[Producer]++;
+	}
+	int64 Time = time_get()-Start;
+
+	for(int p = 0; p < NumProducers; p++)
+		thread_wait(apThreads[p]);
+	unsigned Extra;
+	if(Ok && pQueue->pop(&Extra))
+	{
+		dbg_msg("queue_bench", "%s: item left over", pName);
+		Ok = false;
+	}
+	delete pQueue;
+
+	dbg_msg("queue_bench", "%-12s producers=%d %6.1f M items/s %s", pName, NumProducers,
+		NumProducers*(double)NumPerProducer/Time*time_freq()/1000000.0, Ok ? "ok" : "FAILED");
+	return Ok;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int Num = argc > 1 ? str_toint(argv[1]) : 2000000;
+	if(Num < 1 || Num > 0xffffff)
+		Num = 0xffffff;
+
+	bool Ok = true;
+	Ok &= Run<spsc_ring<unsigned, QUEUE_SIZE> >("spsc_ring", 1, Num);
+	Ok &= Run<CLockedRing>("locked ring", 1, Num);
+	for(int Producers = 2; Producers <= 4; Producers *= 2)
+	{
+		Ok &= Run<mpsc_queue<unsigned, QUEUE_SIZE> >("mpsc_queue", Producers, Num/Producers);
+		Ok &= Run<CLockedRing>("locked ring", Producers, Num/Producers);
+	}
+	return Ok ? 0 : 1;
+}
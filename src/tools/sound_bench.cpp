@@ -0,0 +1,183 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/client/soundmix.h>
+
+// mixes 64 voices offline with the kernels of the sound system and with the
+// scalar loop the mixer used before, and checks the resampling of loud
+// transients
+
+enum
+{
+	NUM_VOICES=64,
+	VOICE_FRAMES=48000*2,
+	BUFFER_FRAMES=512,
+	NUM_BUFFERS=2000,
+	MASTER_VOL=100,
+};
+
+static unsigned s_Seed = 1;
+static int Rand()
+{
+	s_Seed = s_Seed*1103515245+12345;
+	return s_Seed>>8;
+}
+
+struct CVoice
+{
+	short *m_pData;
+	int m_Channels;
+	int m_Tick;
+	int m_Lvol;
+	int m_Rvol;
+};
+
+static CVoice s_aVoices[NUM_VOICES];
+static int s_aMixBuffer[BUFFER_FRAMES*2];
+
+static short Int2Short(int64 i)
+{
+	if(i > 0x7fff)
+		return 0x7fff;
+	else if(i < -0x7fff)
+		return -0x7fff;
+	return i;
+}
+
+// the mixer before the kernels, one frame at a time with stepped pointers.
+// the master volume is applied in 64 bit like the kernels do
+static void MixScalar(short *pFinalOut, unsigned Frames)
+{
+	mem_zero(s_aMixBuffer, sizeof(s_aMixBuffer));
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		CVoice *v = &s_aVoices[i];
+		int *pOut = s_aMixBuffer;
+		int Step = v->m_Channels;
+		short *pInL = &v->m_pData[v->m_Tick*Step];
+		short *pInR = v->m_Channels == 1 ? pInL : pInL+1;
+		unsigned End = min((unsigned)(VOICE_FRAMES-v->m_Tick), Frames);
+		for(unsigned s = 0; s < End; s++)
+		{
+			*pOut++ += (*pInL)*v->m_Lvol;
+			*pOut++ += (*pInR)*v->m_Rvol;
+			pInL += Step;
+			pInR += Step;
+			v->m_Tick++;
+		}
+		if(v->m_Tick == VOICE_FRAMES)
+			v->m_Tick = 0;
+	}
+
+	for(unsigned i = 0; i < Frames; i++)
+	{
+		int j = i<<1;
+		pFinalOut[j] = Int2Short((((int64)s_aMixBuffer[j]*MASTER_VOL)/101)>>8);
+		pFinalOut[j+1] = Int2Short((((int64)s_aMixBuffer[j+1]*MASTER_VOL)/101)>>8);
+	}
+}
+
+static void MixKernels(short *pFinalOut, unsigned Frames)
+{
+	mem_zero(s_aMixBuffer, sizeof(s_aMixBuffer));
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		CVoice *v = &s_aVoices[i];
+		unsigned End = min((unsigned)(VOICE_FRAMES-v->m_Tick), Frames);
+		SoundMixVoice(s_aMixBuffer, &v->m_pData[v->m_Tick*v->m_Channels], v->m_Channels, End, v->m_Lvol, v->m_Rvol);
+		v->m_Tick += End;
+		if(v->m_Tick == VOICE_FRAMES)
+			v->m_Tick = 0;
+	}
+	SoundMixClamp(pFinalOut, s_aMixBuffer, Frames*2, MASTER_VOL);
+}
+
+// returns the time per output frame in ns, the output of the last buffer stays in pOut
+static double RunMix(void (*pfnMix)(short *, unsigned), short *pOut)
+{
+	for(int i = 0; i < NUM_VOICES; i++)
+		s_aVoices[i].m_Tick = (i*997)%VOICE_FRAMES;
+
+	int64 Start = time_get();
+	for(int b = 0; b < NUM_BUFFERS; b++)
+		pfnMix(pOut, BUFFER_FRAMES);
+	return (time_get()-Start)*1000000000.0/time_freq()/((double)NUM_BUFFERS*BUFFER_FRAMES);
+}
+
+// full scale steps from 44.1 to 48 khz, every output sample has to match
+// the exact interpolation between its two input samples
+static bool CheckResample(double *pTime)
+{
+	const int InFrames = 44100;
+	const int OutFrames = 48000;
+	short *pIn = (short *)mem_alloc(InFrames*2*sizeof(short), 1);
+	short *pOut = (short *)mem_alloc(OutFrames*2*sizeof(short), 1);
+	for(int i = 0; i < InFrames*2; i++)
+		pIn[i] = (i/2/3)&1 ? 32767 : -32768;
+
+	int64 Start = time_get();
+	for(int r = 0; r < 10; r++)
+		SoundResample(pOut, OutFrames, pIn, InFrames, 2);
+	*pTime = (time_get()-Start)*1000000000.0/time_freq()/(10.0*OutFrames);
+
+	bool Ok = true;
+	int64 Step = ((int64)InFrames<<16)/OutFrames;
+	for(int i = 0; i < OutFrames*2 && Ok; i++)
+	{
+		int64 Pos = (i/2)*Step;
+		int f = (int)(Pos>>16);
+		int a = pIn[f*2+i%2];
+		int b = pIn[min(f+1, InFrames-1)*2+i%2];
+		double Exact = a+(b-a)*((Pos&0xffff)/65536.0);
+		if(pOut[i] < Exact-1.0 || pOut[i] > Exact+1.0)
+		{
+			dbg_msg("sound_bench", "resampled frame %d is %d instead of %.1f", i/2, pOut[i], Exact);
+			Ok = false;
+		}
+	}
+
+	mem_free(pIn);
+	mem_free(pOut);
+	return Ok;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	// loud noise, half of the voices mono, at different volumes and pans
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		CVoice *v = &s_aVoices[i];
+		v->m_Channels = 1+i%2;
+		v->m_pData = (short *)mem_alloc(VOICE_FRAMES*v->m_Channels*sizeof(short), 1);
+		for(int s = 0; s < VOICE_FRAMES*v->m_Channels; s++)
+			v->m_pData[s] = (Rand()&0xffff)-0x8000;
+		v->m_Lvol = Rand()%256;
+		v->m_Rvol = i%8 ? Rand()%256 : 0;
+	}
+
+	short aScalar[BUFFER_FRAMES*2];
+	short aKernels[BUFFER_FRAMES*2];
+	double ScalarTime = RunMix(MixScalar, aScalar);
+	double KernelTime = RunMix(MixKernels, aKernels);
+	if(mem_comp(aScalar, aKernels, sizeof(aScalar)) != 0)
+	{
+		dbg_msg("sound_bench", "the kernels mix differently than the scalar loop");
+		return 1;
+	}
+
+	double ResampleTime;
+	if(!CheckResample(&ResampleTime))
+		return 1;
+
+	dbg_msg("sound_bench", "%d voices, %d buffers of %d frames: scalar %.1fns per frame, kernels %.1fns per frame",
+		NUM_VOICES, NUM_BUFFERS, BUFFER_FRAMES, ScalarTime, KernelTime);
+	dbg_msg("sound_bench", "resampling full scale steps: %.1fns per stereo frame", ResampleTime);
+
+	for(int i = 0; i < NUM_VOICES; i++)
+		mem_free(s_aVoices[i].m_pData);
+	return 0;
+}
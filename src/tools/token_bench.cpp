@@ -0,0 +1,58 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/external/md5/md5.h>
+#include <engine/shared/network.h>
+
+// measures what a connless packet token costs, the old md5 one against the current one
+
+static TOKEN Md5Token(const NETADDR *pAddr, int64 Seed)
+{
+	NETADDR Addr = *pAddr;
+	char aBuf[sizeof(NETADDR) + sizeof(int64)];
+	md5_state_t State;
+	unsigned int aDigest[4];
+
+	Addr.port = 0;
+	mem_copy(aBuf, &Addr, sizeof(NETADDR));
+	mem_copy(aBuf + sizeof(NETADDR), &Seed, sizeof(int64));
+	md5_init(&State);
+	md5_append(&State, (const md5_byte_t *)aBuf, sizeof(aBuf));
+	md5_finish(&State, (md5_byte_t *)aDigest);
+	return (aDigest[0] ^ aDigest[1] ^ aDigest[2] ^ aDigest[3]) & NET_TOKEN_MASK;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int Num = argc > 1 ? str_toint(argv[1]) : 1000000;
+	if(Num < 1)
+		Num = 1;
+	int64 Seed = time_get();
+	NETADDR Addr = {NETTYPE_IPV4, {10, 0, 0, 0}, 8303};
+	unsigned Sum = 0;
+
+	int64 Start = time_get();
+	for(int i = 0; i < Num; i++)
+	{
+		Addr.ip[2] = i>>8;
+		Addr.ip[3] = i;
+		Sum += Md5Token(&Addr, Seed);
+	}
+	int64 Md5Time = time_get()-Start;
+
+	Start = time_get();
+	for(int i = 0; i < Num; i++)
+	{
+		Addr.ip[2] = i>>8;
+		Addr.ip[3] = i;
+		Sum += CNetTokenManager::GenerateToken(&Addr, Seed);
+	}
+	int64 TokenTime = time_get()-Start;
+
+	dbg_msg("token_bench", "%d tokens, md5 %.1fns, current %.1fns per token (%x)", Num,
+		Md5Time*1000000000.0/time_freq()/Num, TokenTime*1000000000.0/time_freq()/Num, Sum);
+	return 0;
+}
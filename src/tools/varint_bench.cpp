@@ -0,0 +1,184 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/shared/compression.h>
+
+// checks CVariableInt::Compress/Decompress against a plain implementation of
+// the format on random data and measures both
+
+enum
+{
+	MAX_INTS=4096,
+};
+
+// Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
+static unsigned char *RefPack(unsigned char *pDst, int i)
+{
+	*pDst = (i>>25)&0x40;
+	i = i^(i>>31);
+	*pDst |= i&0x3F;
+	i >>= 6;
+	while(i)
+	{
+		*pDst++ |= 0x80;
+		*pDst = i&0x7F;
+		i >>= 7;
+	}
+	return pDst+1;
+}
+
+static const unsigned char *RefUnpack(const unsigned char *pSrc, int *pOut)
+{
+	int Sign = (*pSrc>>6)&1;
+	int Value = *pSrc&0x3F;
+	for(int Shift = 6; Shift < 6+4*7 && (*pSrc&0x80); Shift += 7)
+	{
+		pSrc++;
+		Value |= (*pSrc&0x7F)<<Shift;
+	}
+	*pOut = Value^-Sign;
+	return pSrc+1;
+}
+
+static long RefCompress(const int *pSrc, int Num, unsigned char *pDst, int DstSize)
+{
+	unsigned char *pStart = pDst;
+	unsigned char *pDstEnd = pDst + DstSize;
+	for(int i = 0; i < Num; i++)
+	{
+		if(pDstEnd - pDst < 6)
+			return -1;
+		pDst = RefPack(pDst, pSrc[i]);
+	}
+	return (long)(pDst-pStart);
+}
+
+static long RefDecompress(const unsigned char *pSrc, int SrcSize, int *pDst, int DstSize)
+{
+	const unsigned char *pEnd = pSrc + SrcSize;
+	int *pStart = pDst;
+	int *pDstEnd = pDst + DstSize/4;
+	while(pSrc < pEnd)
+	{
+		if(pDst >= pDstEnd)
+			return -1;
+		pSrc = RefUnpack(pSrc, pDst);
+		pDst++;
+	}
+	return (long)((unsigned char *)pDst-(unsigned char *)pStart);
+}
+
+static unsigned s_Seed = 1;
+static unsigned Rand()
+{
+	s_Seed = s_Seed*1103515245+12345;
+	return s_Seed>>8;
+}
+
+// values around the one byte range and the ends of int, where the range check could overflow
+static const int s_aEdgeInts[] = { -65, -64, 63, 64, 0x7fffffff-64, 0x7fffffff-63, 0x7fffffff, -0x7fffffff-1, -0x7fffffff-1+63, -0x7fffffff-1+64 };
+
+// any size
+static int RandInt()
+{
+	switch(Rand()%9)
+	{
+	case 0: return (int)(Rand()<<8 ^ Rand());
+	case 8: return s_aEdgeInts[Rand()%(sizeof(s_aEdgeInts)/sizeof(s_aEdgeInts[0]))];
+	case 1: return (int)(Rand()%20000)-10000;
+	case 2: return (int)(Rand()%256)-128;
+	default: return (int)(Rand()%128)-64;
+	}
+}
+
+// like a snapshot delta: mostly unchanged fields, some small and few large changes
+static int RandDeltaInt()
+{
+	switch(Rand()%16)
+	{
+	case 0: return (int)(Rand()%20000)-10000;
+	case 1: case 2: return (int)(Rand()%128)-64;
+	default: return 0;
+	}
+}
+
+static void Measure(const char *pName, const int *pInts, int Num)
+{
+	static int s_aOut[MAX_INTS];
+	static unsigned char s_aPacked[MAX_INTS*6];
+	int Loops = 20000;
+	long Size = 0;
+
+	int64 Start = time_get();
+	for(int l = 0; l < Loops; l++)
+		Size = RefCompress(pInts, Num, s_aPacked, sizeof(s_aPacked));
+	int64 RefPack = time_get()-Start;
+	Start = time_get();
+	for(int l = 0; l < Loops; l++)
+		Size = CVariableInt::Compress(pInts, Num*4, s_aPacked, sizeof(s_aPacked));
+	int64 Pack = time_get()-Start;
+	Start = time_get();
+	for(int l = 0; l < Loops; l++)
+		RefDecompress(s_aPacked, Size, s_aOut, sizeof(s_aOut));
+	int64 RefUnpack = time_get()-Start;
+	Start = time_get();
+	for(int l = 0; l < Loops; l++)
+		CVariableInt::Decompress(s_aPacked, Size, s_aOut, sizeof(s_aOut));
+	int64 Unpack = time_get()-Start;
+
+	double Scale = 1000000000.0/time_freq()/Loops/Num;
+	dbg_msg("varint_bench", "%s per int: pack %.2fns (plain %.2fns), unpack %.2fns (plain %.2fns)",
+		pName, Pack*Scale, RefPack*Scale, Unpack*Scale, RefUnpack*Scale);
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int Rounds = argc > 1 ? str_toint(argv[1]) : 100000;
+	static int s_aInts[MAX_INTS], s_aOut[MAX_INTS], s_aRefOut[MAX_INTS];
+	static unsigned char s_aPacked[MAX_INTS*6], s_aRefPacked[MAX_INTS*6];
+
+	// equivalence, including too small buffers and truncated input
+	for(int r = 0; r < Rounds; r++)
+	{
+		int Num = Rand()%256;
+		for(int i = 0; i < Num; i++)
+			s_aInts[i] = r%2 ? RandInt() : RandDeltaInt();
+		int DstSize = Rand()%2 ? sizeof(s_aPacked) : Rand()%(Num*6+1);
+
+		long Size = CVariableInt::Compress(s_aInts, Num*4, s_aPacked, DstSize);
+		long RefSize = RefCompress(s_aInts, Num, s_aRefPacked, DstSize);
+		if(Size != RefSize || (Size > 0 && mem_comp(s_aPacked, s_aRefPacked, Size) != 0))
+		{
+			dbg_msg("varint_bench", "compress mismatch in round %d: %ld %ld", r, Size, RefSize);
+			return 1;
+		}
+		if(Size < 0)
+			continue;
+
+		// the decoders may read up to 4 bytes past a truncated int
+		int SrcSize = Rand()%4 ? Size : Rand()%(Size+1);
+		mem_zero(s_aPacked+SrcSize, 8);
+		int OutSize = Rand()%2 ? sizeof(s_aOut) : Rand()%(Num*4+1);
+		long Out = CVariableInt::Decompress(s_aPacked, SrcSize, s_aOut, OutSize);
+		long RefOut = RefDecompress(s_aPacked, SrcSize, s_aRefOut, OutSize);
+		if(Out != RefOut || (Out > 0 && mem_comp(s_aOut, s_aRefOut, Out) != 0))
+		{
+			dbg_msg("varint_bench", "decompress mismatch in round %d: %ld %ld", r, Out, RefOut);
+			return 1;
+		}
+	}
+	dbg_msg("varint_bench", "%d rounds equal", Rounds);
+
+	// speed on delta sized buffers
+	int Num = 1024;
+	for(int i = 0; i < Num; i++)
+		s_aInts[i] = RandDeltaInt();
+	Measure("delta", s_aInts, Num);
+	for(int i = 0; i < Num; i++)
+		s_aInts[i] = RandInt();
+	Measure("mixed", s_aInts, Num);
+	return 0;
+}